@@ -0,0 +1,379 @@
+#!/usr/bin/python3
+"""A local OpenAI-compatible server for benchmarking open_prompt without a model.
+
+Serves /v1/chat/completions (plain and SSE streaming), /v1/completions with a prompt array, /v1/embeddings and
+the Batch API (/v1/files, /v1/batches and the file content download) with configurable latency, jitter,
+error rate and response size. Gzip and zstd request bodies are accepted and responses are compressed for clients
+that ask for it; zstd needs Python 3.14 or the zstandard package. GET /stats returns the connections and requests
+seen so far, POST /stats/reset clears them. Requests with a response_format schema get a JSON object matching it.
+"""
+
+import argparse
+import gzip
+import itertools
+import json
+import random
+import re
+import threading
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+try:
+    from compression import zstd
+except ImportError:
+    try:
+        import zstandard as zstd
+    except ImportError:
+        zstd = None
+
+
+class Stats:
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.reset()
+
+    def reset(self):
+        with self.lock:
+            self.connections = 0
+            self.requests = 0
+            self.errors = 0
+            self.bytes_received = 0
+            self.bytes_sent = 0
+
+    def add(self, **counters):
+        with self.lock:
+            for name, value in counters.items():
+                setattr(self, name, getattr(self, name) + value)
+
+    def to_dict(self):
+        with self.lock:
+            return {
+                "connections": self.connections,
+                "requests": self.requests,
+                "errors": self.errors,
+                "bytes_received": self.bytes_received,
+                "bytes_sent": self.bytes_sent,
+            }
+
+
+class BatchStore:
+    """Uploaded files and batches of the Batch API, kept in memory."""
+
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.ids = itertools.count(1)
+        self.files = {}
+        self.batches = {}
+
+    def add_file(self, content):
+        with self.lock:
+            file_id = f"file-{next(self.ids)}"
+            self.files[file_id] = content
+            return file_id
+
+    def add_batch(self, batch):
+        with self.lock:
+            batch["id"] = f"batch-{next(self.ids)}"
+            self.batches[batch["id"]] = batch
+            return batch
+
+
+def parse_multipart(content_type, body):
+    """The fields of a multipart/form-data body, by name."""
+    match = re.search(r'boundary="?([^";]+)"?', content_type)
+    if not match:
+        return {}
+    fields = {}
+    for part in body.split(b"--" + match.group(1).encode()):
+        headers, _, value = part.partition(b"\r\n\r\n")
+        name = re.search(rb'name="([^"]*)"', headers)
+        if name:
+            fields[name.group(1).decode()] = value[:-2] if value.endswith(b"\r\n") else value
+    return fields
+
+
+def sample_json(schema):
+    """A value that matches a JSON schema, for requests with a response_format."""
+    if "schema" in schema and "properties" not in schema:
+        schema = schema["schema"]
+    kind = schema.get("type")
+    if kind == "object":
+        return {name: sample_json(child) for name, child in schema.get("properties", {}).items()}
+    if kind == "array":
+        items = schema.get("items", {"type": "string"})
+        return [sample_json(items) for _ in range(max(schema.get("minItems", 1), 1))]
+    return {"integer": 1, "number": 1.5, "boolean": True}.get(kind, "mock")
+
+
+def decode_body(encoding, raw):
+    if encoding == "gzip":
+        return gzip.decompress(raw)
+    if encoding == "zstd":
+        if zstd is None:
+            raise ValueError("zstd request bodies need Python 3.14 or the zstandard package")
+        if zstd.__name__ == "zstandard":
+            # Frames without a content size are only accepted by the streaming API of zstandard
+            return zstd.ZstdDecompressor().decompressobj().decompress(raw)
+        return zstd.decompress(raw)
+    return raw
+
+
+class MockHandler(BaseHTTPRequestHandler):
+    # Keep-alive, so that connection reuse of the extension shows up in the stats
+    protocol_version = "HTTP/1.1"
+
+    def setup(self):
+        super().setup()
+        self.server.stats.add(connections=1)
+
+    def log_message(self, format, *args):
+        pass
+
+    def send_json(self, status, payload, headers=None):
+        self.send_body(status, json.dumps(payload).encode(), "application/json", headers)
+
+    def send_body(self, status, body, content_type, headers=None):
+        self.send_response(status)
+        self.send_header("Content-Type", content_type)
+        accepted = self.headers.get("Accept-Encoding", "")
+        if "zstd" in accepted and zstd is not None:
+            body = zstd.compress(body)
+            self.send_header("Content-Encoding", "zstd")
+        elif "gzip" in accepted:
+            body = gzip.compress(body)
+            self.send_header("Content-Encoding", "gzip")
+        self.send_header("Content-Length", str(len(body)))
+        for name, value in (headers or {}).items():
+            self.send_header(name, value)
+        self.end_headers()
+        self.wfile.write(body)
+        self.server.stats.add(bytes_sent=len(body))
+
+    def do_GET(self):
+        batch = re.fullmatch(r".*/batches/([^/]+)", self.path)
+        content = re.fullmatch(r".*/files/([^/]+)/content", self.path)
+        if self.path == "/stats":
+            self.send_json(200, self.server.stats.to_dict())
+        elif batch:
+            self.handle_batch_status(batch.group(1))
+        elif content and content.group(1) in self.server.batch_store.files:
+            self.send_body(200, self.server.batch_store.files[content.group(1)], "application/jsonl")
+        else:
+            self.send_json(404, {"error": {"message": "not found"}})
+
+    def do_POST(self):
+        length = int(self.headers.get("Content-Length", 0))
+        raw = self.rfile.read(length)
+        if self.path == "/stats/reset":
+            self.server.stats.reset()
+            self.send_json(200, {})
+            return
+        self.server.stats.add(requests=1, bytes_received=len(raw))
+        try:
+            raw = decode_body(self.headers.get("Content-Encoding"), raw)
+        except ValueError as error:
+            self.send_json(415, {"error": {"message": str(error)}})
+            return
+        # Batch API calls only manage files and batches, latency and failures are injected into the inference calls
+        if self.path.endswith("/files"):
+            self.handle_file_upload(raw)
+            return
+        if self.path.endswith("/batches"):
+            self.handle_batch_create(json.loads(raw))
+            return
+        cancel = re.fullmatch(r".*/batches/([^/]+)/cancel", self.path)
+        if cancel:
+            self.handle_batch_cancel(cancel.group(1))
+            return
+        options = self.server.options
+
+        delay = options.latency_ms + random.uniform(-options.jitter_ms, options.jitter_ms)
+        time.sleep(max(delay, 0) / 1000)
+        if random.random() < options.error_rate:
+            self.server.stats.add(errors=1)
+            status = random.choice([429, 500, 503])
+            headers = {"Retry-After": "1"} if status == 429 else None
+            self.send_json(status, {"error": {"message": "injected failure"}}, headers)
+            return
+
+        try:
+            request = json.loads(raw)
+        except ValueError:
+            self.send_json(400, {"error": {"message": "invalid JSON body"}})
+            return
+        if self.path.endswith("/embeddings"):
+            self.handle_embeddings(request)
+        elif self.path.endswith("/chat/completions"):
+            self.handle_completion(request)
+        elif self.path.endswith("/completions"):
+            self.handle_text_completion(request)
+        else:
+            self.send_json(404, {"error": {"message": "not found"}})
+
+    def make_content(self, prompt):
+        size = self.server.options.response_bytes
+        content = ("echo: " + prompt)[:size]
+        return content + "x" * (size - len(content))
+
+    def completion_payload(self, request):
+        prompt = ""
+        for message in request.get("messages", []):
+            if message.get("role") == "user":
+                prompt = message.get("content", "")
+        schema = request.get("response_format", {}).get("schema")
+        content = json.dumps(sample_json(schema)) if schema else self.make_content(prompt)
+        prompt_tokens = len(json.dumps(request.get("messages", []))) // 4 + 1
+        return {
+            "id": "chatcmpl-mock",
+            "object": "chat.completion",
+            "model": request.get("model", "mock"),
+            "choices": [{"index": 0, "message": {"role": "assistant", "content": content}, "finish_reason": "stop"}],
+            "usage": {
+                "prompt_tokens": prompt_tokens,
+                "completion_tokens": len(content) // 4 + 1,
+                "total_tokens": prompt_tokens + len(content) // 4 + 1,
+            },
+        }
+
+    def handle_completion(self, request):
+        payload = self.completion_payload(request)
+        if not request.get("stream"):
+            self.send_json(200, payload)
+            return
+
+        content = payload["choices"][0]["message"]["content"]
+        model = payload["model"]
+        usage = payload["usage"]
+        self.send_response(200)
+        self.send_header("Content-Type", "text/event-stream")
+        self.send_header("Transfer-Encoding", "chunked")
+        self.end_headers()
+        chunk_size = self.server.options.stream_chunk_chars
+        events = []
+        for i in range(0, len(content), chunk_size):
+            events.append({"id": "chatcmpl-mock", "object": "chat.completion.chunk", "model": model,
+                           "choices": [{"index": 0, "delta": {"content": content[i:i + chunk_size]}}]})
+        events.append({"id": "chatcmpl-mock", "object": "chat.completion.chunk", "model": model,
+                       "choices": [{"index": 0, "delta": {}, "finish_reason": "stop"}], "usage": usage})
+        for event in events:
+            self.write_chunk(("data: " + json.dumps(event) + "\n\n").encode())
+            if self.server.options.stream_interval_ms > 0:
+                time.sleep(self.server.options.stream_interval_ms / 1000)
+        self.write_chunk(b"data: [DONE]\n\n")
+        self.wfile.write(b"0\r\n\r\n")
+
+    def write_chunk(self, data):
+        self.wfile.write(b"%x\r\n" % len(data) + data + b"\r\n")
+        self.server.stats.add(bytes_sent=len(data))
+
+    def handle_text_completion(self, request):
+        prompts = request.get("prompt", [])
+        if isinstance(prompts, str):
+            prompts = [prompts]
+        choices = [{"index": index, "text": self.make_content(prompt), "finish_reason": "stop"}
+                   for index, prompt in enumerate(prompts)]
+        prompt_tokens = sum(len(prompt) // 4 + 1 for prompt in prompts)
+        self.send_json(200, {"id": "cmpl-mock", "object": "text_completion", "model": request.get("model", "mock"),
+                             "choices": choices, "usage": {"prompt_tokens": prompt_tokens}})
+
+    def handle_file_upload(self, raw):
+        fields = parse_multipart(self.headers.get("Content-Type", ""), raw)
+        if "file" not in fields:
+            self.send_json(400, {"error": {"message": "missing file field"}})
+            return
+        file_id = self.server.batch_store.add_file(fields["file"])
+        self.send_json(200, {"id": file_id, "object": "file", "bytes": len(fields["file"]),
+                             "purpose": fields.get("purpose", b"").decode()})
+
+    def handle_batch_create(self, request):
+        store = self.server.batch_store
+        lines = store.files.get(request.get("input_file_id"))
+        if lines is None:
+            self.send_json(404, {"error": {"message": "unknown input_file_id"}})
+            return
+        # Batches are answered up front and reported as in progress until --batch-latency-ms passed
+        output = []
+        for line in lines.splitlines():
+            if not line.strip():
+                continue
+            entry = json.loads(line)
+            output.append(json.dumps({"id": "batch_req-mock", "custom_id": entry["custom_id"],
+                                      "response": {"status_code": 200,
+                                                   "body": self.completion_payload(entry["body"])}}))
+        batch = store.add_batch({"object": "batch", "endpoint": request.get("endpoint"),
+                                 "input_file_id": request.get("input_file_id"), "status": "in_progress",
+                                 "output_file_id": None, "error_file_id": None,
+                                 "completes_at": time.time() + self.server.options.batch_latency_ms / 1000})
+        batch["pending_output"] = "\n".join(output).encode() + b"\n"
+        self.send_json(200, self.public_batch(batch))
+
+    def handle_batch_status(self, batch_id):
+        store = self.server.batch_store
+        with store.lock:
+            batch = store.batches.get(batch_id)
+            if batch and batch["status"] == "in_progress" and time.time() >= batch["completes_at"]:
+                batch["status"] = "completed"
+                batch["output_file_id"] = f"file-{next(store.ids)}"
+                store.files[batch["output_file_id"]] = batch.pop("pending_output")
+        if batch is None:
+            self.send_json(404, {"error": {"message": "unknown batch"}})
+        else:
+            self.send_json(200, self.public_batch(batch))
+
+    def handle_batch_cancel(self, batch_id):
+        store = self.server.batch_store
+        with store.lock:
+            batch = store.batches.get(batch_id)
+            if batch and batch["status"] == "in_progress":
+                batch["status"] = "cancelled"
+        if batch is None:
+            self.send_json(404, {"error": {"message": "unknown batch"}})
+        else:
+            self.send_json(200, self.public_batch(batch))
+
+    @staticmethod
+    def public_batch(batch):
+        return {name: value for name, value in batch.items() if name not in ("pending_output", "completes_at")}
+
+    def handle_embeddings(self, request):
+        inputs = request.get("input", [])
+        if isinstance(inputs, str):
+            inputs = [inputs]
+        dimensions = request.get("dimensions") or self.server.options.embedding_dimensions
+        data = []
+        for index, text in enumerate(inputs):
+            rng = random.Random(text)
+            data.append({"object": "embedding", "index": index,
+                         "embedding": [round(rng.uniform(-1, 1), 6) for _ in range(dimensions)]})
+        self.send_json(200, {"object": "list", "data": data, "model": request.get("model", "mock"),
+                             "usage": {"prompt_tokens": sum(len(t) // 4 + 1 for t in inputs)}})
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("--host", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=8089)
+    parser.add_argument("--latency-ms", type=float, default=20, help="mean response latency")
+    parser.add_argument("--jitter-ms", type=float, default=5, help="uniform jitter around the latency")
+    parser.add_argument("--error-rate", type=float, default=0, help="fraction of requests answered with 429/5xx")
+    parser.add_argument("--response-bytes", type=int, default=64, help="size of each completion")
+    parser.add_argument("--stream-chunk-chars", type=int, default=8, help="content characters per SSE event")
+    parser.add_argument("--stream-interval-ms", type=float, default=0, help="delay between SSE events")
+    parser.add_argument("--embedding-dimensions", type=int, default=16)
+    parser.add_argument("--batch-latency-ms", type=float, default=0, help="time until a batch completes")
+    options = parser.parse_args()
+
+    server = ThreadingHTTPServer((options.host, options.port), MockHandler)
+    server.daemon_threads = True
+    server.options = options
+    server.stats = Stats()
+    server.batch_store = BatchStore()
+    print(f"mock server listening on http://{options.host}:{server.server_address[1]}", flush=True)
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,140 @@
+#!/usr/bin/python3
+"""Runs open_prompt against the local mock server and reports throughput, latency and resource usage.
+
+Every scenario runs the DuckDB shell twice with the same setup, once with and once without the open_prompt query,
+so that wall time and CPU time of loading the extension and building the input table are not counted.
+"""
+
+import argparse
+import json
+import os
+import resource
+import socket
+import subprocess
+import sys
+import time
+import urllib.request
+
+BENCHMARK_DIR = os.path.dirname(os.path.abspath(__file__))
+DEFAULT_DUCKDB = os.path.join(BENCHMARK_DIR, "..", "build", "release", "duckdb")
+
+# name, rows, extension settings, mock server arguments
+SCENARIOS = [
+    ("completions_1k", 1000, {}, []),
+    ("completions_100k", 100000, {}, []),
+    ("streaming_1k", 1000, {"openprompt_stream": "true"}, ["--stream-chunk-chars", "4"]),
+    ("errors_1k", 1000, {}, ["--error-rate", "0.05"]),
+    ("duplicates_100k", 100000, {}, []),
+]
+
+
+def free_port():
+    with socket.socket() as sock:
+        sock.bind(("127.0.0.1", 0))
+        return sock.getsockname()[1]
+
+
+def start_mock_server(port, server_args):
+    process = subprocess.Popen([sys.executable, os.path.join(BENCHMARK_DIR, "mock_server.py"), "--port",
+                                str(port)] + server_args, stdout=subprocess.PIPE, text=True)
+    process.stdout.readline()
+    return process
+
+
+def mock_stats(port):
+    with urllib.request.urlopen(f"http://127.0.0.1:{port}/stats") as response:
+        return json.loads(response.read())
+
+
+def build_script(port, rows, settings, duplicates, with_query):
+    lines = [
+        f"SET VARIABLE openprompt_api_url = 'http://127.0.0.1:{port}/v1/chat/completions';",
+        "SET VARIABLE openprompt_model_name = 'mock';",
+    ]
+    lines += [f"SET {name} = {value};" for name, value in settings.items()]
+    # Duplicate prompts exercise deduplication and the request cache, one distinct prompt per 10 rows
+    expression = "i % (" + str(max(rows // 10, 1)) + ")" if duplicates else "i"
+    lines.append(f"CREATE TABLE prompts AS SELECT 'Prompt number ' || {expression} AS prompt FROM range({rows}) t(i);")
+    if with_query:
+        lines.append("CREATE TABLE results AS SELECT open_prompt(prompt) AS response FROM prompts;")
+        lines.append("SELECT count(*) FILTER (WHERE response LIKE 'Error:%') AS error_rows, s.* "
+                     "FROM results, open_prompt_stats() s GROUP BY ALL;")
+    return "\n".join(lines) + "\n"
+
+
+def run_shell(duckdb, script):
+    usage_before = resource.getrusage(resource.RUSAGE_CHILDREN)
+    start = time.perf_counter()
+    result = subprocess.run([duckdb, "-unsigned", "-json", "-c", script], capture_output=True, text=True)
+    wall = time.perf_counter() - start
+    usage_after = resource.getrusage(resource.RUSAGE_CHILDREN)
+    if result.returncode != 0:
+        raise RuntimeError(f"duckdb failed: {result.stderr.strip()}")
+    cpu = (usage_after.ru_utime + usage_after.ru_stime) - (usage_before.ru_utime + usage_before.ru_stime)
+    return result.stdout, wall, cpu, usage_after.ru_maxrss
+
+
+def run_scenario(duckdb, name, rows, settings, server_args):
+    port = free_port()
+    server = start_mock_server(port, server_args)
+    try:
+        duplicates = name.startswith("duplicates")
+        _, base_wall, base_cpu, _ = run_shell(duckdb, build_script(port, rows, settings, duplicates, False))
+        output, wall, cpu, max_rss = run_shell(duckdb, build_script(port, rows, settings, duplicates, True))
+        server_stats = mock_stats(port)
+    finally:
+        server.terminate()
+        server.wait()
+    stats = json.loads(output)[-1]
+    query_wall = max(wall - base_wall, 1e-9)
+    return {
+        "scenario": name,
+        "rows": rows,
+        "rows_per_sec": rows / query_wall,
+        "wall_s": query_wall,
+        "latency_p50_ms": stats["latency_p50_ms"],
+        "latency_p99_ms": stats["latency_p99_ms"],
+        "requests": stats["requests"],
+        "error_rows": stats["error_rows"],
+        "retries": stats["retries"],
+        "connections_opened": stats["connections_opened"],
+        "server_connections": server_stats["connections"],
+        "cpu_us_per_row": max(cpu - base_cpu, 0) * 1e6 / rows,
+        # Peak resident set of the largest child so far, a proxy for allocations since the shell is not instrumented
+        "peak_rss_mb": max_rss / 1024,
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("--duckdb", default=os.environ.get("DUCKDB", DEFAULT_DUCKDB),
+                        help="DuckDB shell with the open_prompt extension linked in")
+    parser.add_argument("--scenario", action="append", help="only run the named scenario(s)")
+    parser.add_argument("--max-rows", type=int, default=None, help="cap the rows of every scenario")
+    parser.add_argument("--json", help="also write the results to this file")
+    options = parser.parse_args()
+
+    if not os.path.exists(options.duckdb):
+        sys.exit(f"DuckDB shell not found at {options.duckdb}, build it with 'make release' first")
+
+    results = []
+    for name, rows, settings, server_args in SCENARIOS:
+        if options.scenario and name not in options.scenario:
+            continue
+        if options.max_rows:
+            rows = min(rows, options.max_rows)
+        print(f"running {name} ({rows} rows)...", file=sys.stderr, flush=True)
+        results.append(run_scenario(options.duckdb, name, rows, settings, server_args))
+
+    columns = ["scenario", "rows", "rows_per_sec", "latency_p50_ms", "latency_p99_ms", "requests", "error_rows",
+               "retries", "connections_opened", "server_connections", "cpu_us_per_row", "peak_rss_mb"]
+    print(" | ".join(columns))
+    for result in results:
+        print(" | ".join(f"{result[c]:.1f}" if isinstance(result[c], float) else str(result[c]) for c in columns))
+    if options.json:
+        with open(options.json, "w") as file:
+            json.dump(results, file, indent=2)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,219 @@
+#include "http_client_pool.hpp"
+
+namespace duckdb {
+
+HTTPEndpoint HTTPEndpoint::Parse(const string &url) {
+    HTTPEndpoint endpoint;
+    string scheme = "http";
+    string mod_url = url;
+    auto pos = mod_url.find("://");
+    if (pos != string::npos) {
+        scheme = mod_url.substr(0, pos);
+        mod_url.erase(0, pos + 3);
+    }
+
+    string domain;
+    pos = mod_url.find('/');
+    if (pos != string::npos) {
+        domain = mod_url.substr(0, pos);
+        endpoint.path = mod_url.substr(pos);
+    } else {
+        domain = mod_url;
+        endpoint.path = "/";
+    }
+    endpoint.scheme_host_port = scheme + "://" + domain;
+    return endpoint;
+}
+
+PooledHTTPClient::PooledHTTPClient(shared_ptr<HTTPClientPool> pool_p, string key_p,
+                                   unique_ptr<duckdb_httplib_openssl::Client> client_p, bool reused_p)
+    : pool(std::move(pool_p)), key(std::move(key_p)), client(std::move(client_p)), reused(reused_p) {
+}
+
+PooledHTTPClient::~PooledHTTPClient() {
+    // A moved-from client has no pool
+    if (pool) {
+        pool->Release(key, std::move(client));
+    }
+}
+
+shared_ptr<HTTPClientPool> HTTPClientPool::Get(ClientContext &context) {
+    auto &cache = ObjectCache::GetObjectCache(context);
+    return cache.GetOrCreate<HTTPClientPool>(HTTPClientPool::ObjectType());
+}
+
+void HTTPClientPool::Configure(idx_t max_per_host_p, idx_t idle_timeout_seconds_p) {
+    max_per_host = MaxValue<idx_t>(max_per_host_p, 1);
+    idle_timeout_seconds = idle_timeout_seconds_p;
+    // A raised limit may let waiting requests through
+    client_released.notify_all();
+}
+
+unique_ptr<duckdb_httplib_openssl::Client> HTTPClientPool::CreateClient(const string &scheme_host_port) {
+    auto client = make_uniq<duckdb_httplib_openssl::Client>(scheme_host_port);
+    client->set_read_timeout(10, 0);  // 10 seconds
+    client->set_follow_location(true); // Follow redirects
+    client->set_keep_alive(true);
+    // Compressed responses are decoded by the caller, httplib would reject them without zlib support
+    client->set_decompress(false);
+    return client;
+}
+
+void HTTPClientPool::EvictExpired(HostEntry &entry, steady_clock::time_point now) {
+    auto timeout = std::chrono::seconds(idle_timeout_seconds.load());
+    // Clients are returned to the back, so the oldest idle clients sit at the front
+    while (!entry.idle.empty() && now - entry.idle.front().last_used > timeout) {
+        entry.idle.pop_front();
+        entry.evictions++;
+    }
+}
+
+PooledHTTPClient HTTPClientPool::Acquire(const HTTPEndpoint &endpoint) {
+    auto &key = endpoint.scheme_host_port;
+    {
+        std::unique_lock<mutex> guard(lock);
+        // References into the map stay valid while other hosts are added
+        auto &entry = hosts[key];
+        while (true) {
+            EvictExpired(entry, steady_clock::now());
+            if (!entry.idle.empty()) {
+                // Take the most recently used client, it is the least likely to have been closed by the server
+                auto client = std::move(entry.idle.back().client);
+                entry.idle.pop_back();
+                entry.hits++;
+                entry.checked_out++;
+                return PooledHTTPClient(shared_from_this(), key, std::move(client), true);
+            }
+            if (entry.checked_out < max_per_host) {
+                break;
+            }
+            client_released.wait(guard);
+        }
+        entry.misses++;
+        entry.checked_out++;
+    }
+    // Connecting happens lazily on the first request, outside of the lock
+    unique_ptr<duckdb_httplib_openssl::Client> client;
+    try {
+        client = CreateClient(key);
+    } catch (...) {
+        Release(key, nullptr);
+        throw;
+    }
+    return PooledHTTPClient(shared_from_this(), key, std::move(client), false);
+}
+
+void HTTPClientPool::Release(const string &key, unique_ptr<duckdb_httplib_openssl::Client> client) {
+    auto now = steady_clock::now();
+    {
+        lock_guard<mutex> guard(lock);
+        auto &entry = hosts[key];
+        entry.checked_out--;
+        EvictExpired(entry, now);
+        if (client) {
+            // Only reached when the limit was lowered while the client was borrowed
+            if (entry.checked_out + entry.idle.size() >= max_per_host) {
+                entry.evictions++;
+            } else {
+                entry.idle.push_back(IdleClient {std::move(client), now});
+            }
+        }
+    }
+    client_released.notify_all();
+}
+
+vector<HTTPClientPoolHostStats> HTTPClientPool::GetStats() {
+    vector<HTTPClientPoolHostStats> result;
+    lock_guard<mutex> guard(lock);
+    for (auto &host : hosts) {
+        EvictExpired(host.second, steady_clock::now());
+        result.push_back({host.first, host.second.idle.size(), host.second.hits, host.second.misses,
+                          host.second.evictions});
+    }
+    return result;
+}
+
+void HandleHttpError(const duckdb_httplib_openssl::Result &res, const std::string &request_type) {
+    std::string err_message = "HTTP " + request_type + " request failed. ";
+    bool transient = false;
+
+    switch (res.error()) {
+        case duckdb_httplib_openssl::Error::Connection:
+            transient = true;
+            err_message += "Connection error.";
+            break;
+        case duckdb_httplib_openssl::Error::BindIPAddress:
+            err_message += "Failed to bind IP address.";
+            break;
+        case duckdb_httplib_openssl::Error::Read:
+            transient = true;
+            err_message += "Error reading response.";
+            break;
+        case duckdb_httplib_openssl::Error::Write:
+            transient = true;
+            err_message += "Error writing request.";
+            break;
+        case duckdb_httplib_openssl::Error::ExceedRedirectCount:
+            err_message += "Too many redirects.";
+            break;
+        case duckdb_httplib_openssl::Error::Canceled:
+            err_message += "Request was canceled.";
+            break;
+        case duckdb_httplib_openssl::Error::SSLConnection:
+            err_message += "SSL connection failed.";
+            break;
+        case duckdb_httplib_openssl::Error::SSLLoadingCerts:
+            err_message += "Failed to load SSL certificates.";
+            break;
+        case duckdb_httplib_openssl::Error::SSLServerVerification:
+            err_message += "SSL server verification failed.";
+            break;
+        case duckdb_httplib_openssl::Error::UnsupportedMultipartBoundaryChars:
+            err_message += "Unsupported characters in multipart boundary.";
+            break;
+        case duckdb_httplib_openssl::Error::Compression:
+            err_message += "Error during compression.";
+            break;
+        default:
+            err_message += "Unknown error.";
+            break;
+    }
+    throw OpenPromptHTTPError(err_message, 0, transient);
+}
+
+void SetRequestBody(duckdb_httplib_openssl::Request &req, const string &body) {
+    req.content_length_ = body.size();
+    req.content_provider_ = [&body](size_t offset, size_t length, duckdb_httplib_openssl::DataSink &sink) {
+        return sink.write(body.data() + offset, length);
+    };
+}
+
+void HandleHttpStatus(const duckdb_httplib_openssl::Response &res) {
+    bool transient = false;
+    switch (res.status) {
+        case 408: // Request Timeout
+        case 429: // Too Many Requests
+        case 500: // Internal Server Error
+        case 502: // Bad Gateway
+        case 503: // Service Unavailable
+        case 504: // Gateway Timeout
+            transient = true;
+            break;
+        default:
+            break;
+    }
+    // Only the delay-seconds form of Retry-After is supported, HTTP dates fall back to backoff
+    double retry_after_seconds = 0;
+    auto retry_after = res.get_header_value("Retry-After");
+    if (!retry_after.empty()) {
+        char *end;
+        auto value = std::strtod(retry_after.c_str(), &end);
+        if (end != retry_after.c_str() && value > 0) {
+            retry_after_seconds = value;
+        }
+    }
+    throw OpenPromptHTTPError("HTTP error " + std::to_string(res.status) + ": " + res.reason, res.status, transient,
+                              retry_after_seconds);
+}
+
+} // namespace duckdb
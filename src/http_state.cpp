@@ -0,0 +1,130 @@
+#include "http_state.hpp"
+
+#include "duckdb/common/string_util.hpp"
+#include "duckdb/main/query_profiler.hpp"
+
+namespace duckdb {
+
+CachedFileHandle::CachedFileHandle(shared_ptr<CachedFile> &file_p) {
+	// If the file was not yet initialized, we need to grab a lock.
+	if (!file_p->initialized) {
+		lock = make_uniq<lock_guard<mutex>>(file_p->lock);
+	}
+	file = file_p;
+}
+
+void CachedFileHandle::SetInitialized(idx_t total_size) {
+	if (file->initialized) {
+		throw InternalException("Cannot set initialized on cached file that was already initialized");
+	}
+	if (!lock) {
+		throw InternalException("Cannot set initialized on cached file without lock");
+	}
+	file->size = total_size;
+	file->initialized = true;
+	lock = nullptr;
+}
+
+void CachedFileHandle::AllocateBuffer(idx_t size) {
+	if (file->initialized) {
+		throw InternalException("Cannot allocate a buffer for a cached file that was already initialized");
+	}
+	file->data = shared_ptr<char>(new char[size], std::default_delete<char[]>());
+	file->capacity = size;
+}
+
+void CachedFileHandle::GrowBuffer(idx_t new_capacity, idx_t bytes_to_copy) {
+	// copy shared ptr to old data
+	auto old_data = file->data;
+	// allocate new buffer that can hold the new capacity
+	AllocateBuffer(new_capacity);
+	// copy the old data
+	Write(old_data.get(), bytes_to_copy);
+}
+
+void CachedFileHandle::Write(const char *buffer, idx_t length, idx_t offset) {
+	//! Only write to non-initialized files with a lock;
+	D_ASSERT(!file->initialized && lock);
+	memcpy(file->data.get() + offset, buffer, length);
+}
+
+void HTTPState::Reset() {
+	// Reset Counters
+	head_count = 0;
+	get_count = 0;
+	put_count = 0;
+	post_count = 0;
+	total_bytes_received = 0;
+	total_bytes_sent = 0;
+	open_prompt_metrics.Reset();
+
+	// Reset cached files
+	cached_files.clear();
+}
+
+shared_ptr<HTTPState> HTTPState::TryGetState(ClientContext &context) {
+	// Registered under its own key, so that it never collides with the httpfs state of the same name
+	return context.registered_state->GetOrCreate<HTTPState>("open_prompt_http_state");
+}
+
+shared_ptr<HTTPState> HTTPState::TryGetState(optional_ptr<FileOpener> opener) {
+	auto client_context = FileOpener::TryGetClientContext(opener);
+	if (client_context) {
+		return TryGetState(*client_context);
+	}
+	return nullptr;
+}
+
+shared_ptr<CachedFile> &HTTPState::GetCachedFile(const string &path) {
+	lock_guard<mutex> lock(cached_files_mutex);
+	auto &cache_entry_ref = cached_files[path];
+	if (!cache_entry_ref) {
+		cache_entry_ref = make_shared_ptr<CachedFile>();
+	}
+	return cache_entry_ref;
+}
+
+void HTTPState::WriteProfilingInformation(std::ostream &ss) {
+	if (IsEmpty()) {
+		return;
+	}
+	auto &metrics = open_prompt_metrics;
+	vector<string> lines;
+	lines.push_back("in: " + StringUtil::BytesToHumanReadableString(total_bytes_received));
+	lines.push_back("out: " + StringUtil::BytesToHumanReadableString(total_bytes_sent));
+	if (metrics.payload_bytes_sent != metrics.bytes_sent || metrics.payload_bytes_received != metrics.bytes_received) {
+		lines.push_back("uncompressed in: " + StringUtil::BytesToHumanReadableString(metrics.payload_bytes_received));
+		lines.push_back("uncompressed out: " + StringUtil::BytesToHumanReadableString(metrics.payload_bytes_sent));
+	}
+	lines.push_back("#POST: " + std::to_string(post_count));
+	lines.push_back("#retries: " + std::to_string(metrics.retries) + " (throttled " +
+	                std::to_string(metrics.throttled) + ")");
+	lines.push_back("#errors: " + std::to_string(metrics.errors) + " (failovers " +
+	                std::to_string(metrics.failovers) + ")");
+	if (metrics.hedges > 0) {
+		lines.push_back("#hedges: " + std::to_string(metrics.hedges) + " (won " + std::to_string(metrics.hedge_wins) +
+		                ")");
+	}
+	lines.push_back("#cache hits: " + std::to_string(metrics.cache_hits));
+	lines.push_back("#deduplicated: " + std::to_string(metrics.deduplicated));
+	lines.push_back("#connections: " + std::to_string(metrics.connections_opened) + " opened, " +
+	                std::to_string(metrics.connections_reused) + " reused");
+	lines.push_back("tokens: " + std::to_string(metrics.prompt_tokens) + " prompt, " +
+	                std::to_string(metrics.completion_tokens) + " completion");
+	lines.push_back("latency p50: " + StringUtil::Format("%.0fms", metrics.latency.Percentile(50)));
+	lines.push_back("latency p95: " + StringUtil::Format("%.0fms", metrics.latency.Percentile(95)));
+	lines.push_back("latency p99: " + StringUtil::Format("%.0fms", metrics.latency.Percentile(99)));
+
+	constexpr idx_t TOTAL_BOX_WIDTH = 39;
+	ss << "┌─────────────────────────────────────┐\n";
+	ss << "│┌───────────────────────────────────┐│\n";
+	ss << "││      open_prompt HTTP Stats       ││\n";
+	ss << "││                                   ││\n";
+	for (auto &line : lines) {
+		ss << "││" + QueryProfiler::DrawPadded(line, TOTAL_BOX_WIDTH - 4) + "││\n";
+	}
+	ss << "│└───────────────────────────────────┘│\n";
+	ss << "└─────────────────────────────────────┘\n";
+}
+
+} // namespace duckdb
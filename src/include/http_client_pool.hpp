@@ -0,0 +1,141 @@
+#pragma once
+
+#include "duckdb.hpp"
+#include "duckdb/common/atomic.hpp"
+#include "duckdb/common/chrono.hpp"
+#include "duckdb/common/mutex.hpp"
+#include "duckdb/common/unordered_map.hpp"
+#include "duckdb/storage/object_cache.hpp"
+
+#define CPPHTTPLIB_OPENSSL_SUPPORT
+#include "httplib.hpp"
+
+#include <condition_variable>
+#include <deque>
+
+namespace duckdb {
+
+//! An API URL split into the part that identifies a connection and the request path
+struct HTTPEndpoint {
+    //! scheme://host[:port], used both to open a client and as the pool key
+    string scheme_host_port;
+    string path;
+
+    static HTTPEndpoint Parse(const string &url);
+};
+
+//! A request that failed at the HTTP level, with what is needed to decide whether to retry it
+class OpenPromptHTTPError : public std::runtime_error {
+public:
+    OpenPromptHTTPError(const string &message, int status_p, bool transient_p, double retry_after_seconds_p = 0)
+        : std::runtime_error(message), status(status_p), transient(transient_p),
+          retry_after_seconds(retry_after_seconds_p) {
+    }
+
+    //! HTTP status code, 0 when no response was received
+    int status;
+    //! Whether the same request may succeed when sent again
+    bool transient;
+    //! Delay requested by the server through Retry-After, 0 if none
+    double retry_after_seconds;
+};
+
+//! Throw a descriptive error for a request that did not produce a response
+void HandleHttpError(const duckdb_httplib_openssl::Result &res, const std::string &request_type);
+//! Throw a descriptive error for a response with a non-200 status
+void HandleHttpStatus(const duckdb_httplib_openssl::Response &res);
+//! Send `body` with `req` straight from the caller's buffer instead of copying it into the request. The buffer must
+//! outlive the request, it is read again when httplib resends the request
+void SetRequestBody(duckdb_httplib_openssl::Request &req, const string &body);
+
+struct HTTPClientPoolHostStats {
+    string host;
+    idx_t idle_connections;
+    idx_t hits;
+    idx_t misses;
+    idx_t evictions;
+};
+
+class HTTPClientPool;
+
+//! A client borrowed from the pool. It is returned on destruction unless it was discarded, either way its slot in
+//! the host's connection limit is freed
+class PooledHTTPClient {
+public:
+    PooledHTTPClient(shared_ptr<HTTPClientPool> pool_p, string key_p,
+                     unique_ptr<duckdb_httplib_openssl::Client> client_p, bool reused_p);
+    PooledHTTPClient(PooledHTTPClient &&other) noexcept = default;
+    ~PooledHTTPClient();
+
+    duckdb_httplib_openssl::Client &operator*() {
+        return *client;
+    }
+    duckdb_httplib_openssl::Client *operator->() {
+        return client.get();
+    }
+    //! Whether the connection came from the idle list rather than being freshly opened
+    bool Reused() const {
+        return reused;
+    }
+    //! Drop the connection instead of returning it, e.g. after a transport error
+    void Discard() {
+        client.reset();
+    }
+
+private:
+    shared_ptr<HTTPClientPool> pool;
+    string key;
+    unique_ptr<duckdb_httplib_openssl::Client> client;
+    bool reused;
+};
+
+//! Database-wide pool of keep-alive HTTP clients keyed by scheme, host and port
+class HTTPClientPool : public ObjectCacheEntry, public enable_shared_from_this<HTTPClientPool> {
+public:
+    static string ObjectType() {
+        return "open_prompt_http_client_pool";
+    }
+    string GetObjectType() override {
+        return ObjectType();
+    }
+
+    //! Get the pool of the database the context belongs to, creating it on first use
+    static shared_ptr<HTTPClientPool> Get(ClientContext &context);
+
+    //! Apply the pool settings of the calling context
+    void Configure(idx_t max_per_host_p, idx_t idle_timeout_seconds_p);
+    //! Borrow a client for the given endpoint, reusing an idle connection when one is available. Waits while the
+    //! host already has max_per_host connections checked out or idle
+    PooledHTTPClient Acquire(const HTTPEndpoint &endpoint);
+    //! Return a borrowed client to the idle list, nullptr for a discarded one
+    void Release(const string &key, unique_ptr<duckdb_httplib_openssl::Client> client);
+
+    vector<HTTPClientPoolHostStats> GetStats();
+
+private:
+    struct IdleClient {
+        unique_ptr<duckdb_httplib_openssl::Client> client;
+        steady_clock::time_point last_used;
+    };
+    struct HostEntry {
+        std::deque<IdleClient> idle;
+        //! Clients borrowed and not yet returned or discarded
+        idx_t checked_out = 0;
+        idx_t hits = 0;
+        idx_t misses = 0;
+        idx_t evictions = 0;
+    };
+
+    static unique_ptr<duckdb_httplib_openssl::Client> CreateClient(const string &scheme_host_port);
+    //! Drop idle clients older than the idle timeout, requires the lock to be held
+    void EvictExpired(HostEntry &entry, steady_clock::time_point now);
+
+    mutex lock;
+    //! Signalled whenever a client is returned or discarded
+    std::condition_variable client_released;
+    unordered_map<string, HostEntry> hosts;
+    atomic<idx_t> max_per_host {64};
+    atomic<idx_t> idle_timeout_seconds {30};
+};
+
+} // namespace duckdb
@@ -6,6 +6,7 @@
 #include "duckdb/common/atomic.hpp"
 #include "duckdb/common/optional_ptr.hpp"
 #include "duckdb/main/client_context_state.hpp"
+#include "open_prompt_metrics.hpp"
 
 namespace duckdb {
 
@@ -80,7 +81,7 @@ public:
 
 	bool IsEmpty() {
 		return head_count == 0 && get_count == 0 && put_count == 0 && post_count == 0 && total_bytes_received == 0 &&
-		       total_bytes_sent == 0;
+		       total_bytes_sent == 0 && open_prompt_metrics.IsEmpty();
 	}
 
 	atomic<idx_t> head_count {0};
@@ -89,6 +90,8 @@ public:
 	atomic<idx_t> post_count {0};
 	atomic<idx_t> total_bytes_received {0};
 	atomic<idx_t> total_bytes_sent {0};
+	//! Detailed metrics of the open_prompt requests of the current query
+	OpenPromptMetrics open_prompt_metrics;
 
 	//! Called by the ClientContext when the current query ends
 	void QueryEnd(ClientContext &context) override {
@@ -0,0 +1,13 @@
+#pragma once
+
+#include "duckdb.hpp"
+#include "duckdb/function/function_set.hpp"
+
+namespace duckdb {
+
+//! open_prompt_agg(text[, instruction[, model]] ORDER BY ...): map-reduce summarization of the texts of a group.
+//! The texts are packed into chunks of at most openprompt_agg_chunk_tokens, every chunk is answered, and the answers
+//! are packed and answered again until a single answer remains
+AggregateFunctionSet GetOpenPromptAggFunction();
+
+} // namespace duckdb
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "duckdb.hpp"
+#include "http_client_pool.hpp"
+#include "open_prompt_metrics.hpp"
+#include "open_prompt_request.hpp"
+
+namespace duckdb {
+
+enum class OpenPromptBatchMode : uint8_t {
+    //! Every request is its own chat completion call
+    NONE,
+    //! Requests are uploaded as a JSONL file to the OpenAI-compatible Batch API
+    BATCH_API,
+    //! Prompts are packed into the "prompt" array of a completions call
+    MULTI_PROMPT,
+    //! Prompts are packed into a single chat message as a JSON array, the model answers with one array entry each
+    PACKED
+};
+
+OpenPromptBatchMode ParseBatchMode(const string &mode);
+
+struct OpenPromptBatchOptions {
+    //! Maximum number of prompts per multi_prompt or packed request
+    idx_t batch_size = 64;
+    idx_t poll_interval_seconds = 10;
+    idx_t timeout_seconds = 86400;
+};
+
+//! Outcome of a single request that was sent as part of a batch
+struct OpenPromptBatchResult {
+    bool success = false;
+    string response;
+    //! Prompt and completion tokens reported for this request, 0 when they are only known for the whole call
+    idx_t tokens = 0;
+};
+
+//! Upload the request bodies as a batch, wait for it to finish and map the results back by custom_id. Every
+//! upstream call is recorded as a request, and the token usage of the results as responses
+void SendBatchAPIRequests(ClientContext &context, HTTPClientPool &pool, OpenPromptMetricsRecorder &recorder,
+                          const string &api_url, const string &api_token, const vector<string> &request_bodies,
+                          const OpenPromptBatchOptions &options, vector<OpenPromptBatchResult> &results);
+
+//! Render the body of a completions request carrying every prompt in its "prompt" array into `body`
+void RenderMultiPromptBody(const string &model_name, const string &system_prompt,
+                           const vector<reference<const string>> &prompts, string &body);
+//! Map the choices of the multi-prompt completions response in `response.content` back to its `count` prompts and
+//! read its token usage into `response`. Throws when the response has no choices, prompts without a usable choice
+//! get an error result
+void ParseMultiPromptResponse(OpenPromptResponse &response, idx_t count, vector<OpenPromptBatchResult> &results);
+
+//! The system prompt of a packed request of `count` prompts, appended to the user's system prompt. A structured
+//! request asks for the object described by PackedJSONSchema instead of a bare array
+string PackedSystemPrompt(const string &system_prompt, idx_t count, bool structured = false);
+//! Schema of the answer to a packed request of `count` prompts: an object whose "answers" array holds one entry
+//! matching `json_schema` per prompt
+string PackedJSONSchema(const string &json_schema, idx_t count);
+//! The user message of a packed request, the prompts as a JSON array
+string RenderPackedPrompt(const vector<reference<const string>> &prompts);
+//! Split the completion of a packed request into one answer per prompt. Returns false when it is not a JSON array,
+//! or an object with an "answers" array, of exactly `count` entries, e.g. because the model merged or skipped items
+bool ParsePackedAnswers(const string &content, idx_t count, vector<string> &answers);
+
+} // namespace duckdb
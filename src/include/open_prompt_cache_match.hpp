@@ -0,0 +1,52 @@
+#pragma once
+
+#include "duckdb.hpp"
+
+namespace duckdb_re2 {
+class RE2;
+}
+
+namespace duckdb {
+
+//! How requests are matched against the response cache: the normalization applied to the user message before a
+//! request is hashed into its cache key, and the approximate tier that reuses the response of a near-duplicate
+//! prompt. Per-query deduplication does not go through it, only identical bodies share a response there
+class OpenPromptCacheMatcher {
+public:
+    OpenPromptCacheMatcher();
+    ~OpenPromptCacheMatcher();
+
+    //! Reads openprompt_cache_normalize, openprompt_cache_strip_patterns and openprompt_cache_similarity
+    void Configure(ClientContext &context);
+
+    //! Whether cache keys are computed from a normalized user message, which needs the bare prompt of every request
+    bool Normalizes() const {
+        return normalize || !strip_patterns.empty();
+    }
+    //! Cache key of a request: the body with its user message `prompt` normalized. Without a prompt, or when it is
+    //! not found in the body, the exact body is hashed
+    string Key(const string &api_url, const string &body, const string &prompt) const;
+    //! Whether prompts are matched approximately, which needs the bare prompt of every request
+    bool Approximate() const {
+        return max_distance >= 0;
+    }
+    //! Maximum number of differing fingerprint bits of a near-duplicate
+    idx_t MaxDistance() const {
+        return NumericCast<idx_t>(max_distance);
+    }
+    //! Everything in the request except the prompt, only requests of the same context are near-duplicates
+    uint64_t Context(const string &api_url, const string &body, const string &prompt) const;
+    //! SimHash of the normalized prompt
+    uint64_t Fingerprint(const string &prompt) const;
+
+private:
+    //! Remove the strip pattern matches from a prompt, then fold case and whitespace when normalizing
+    string Normalize(const string &prompt) const;
+
+    bool normalize = false;
+    vector<unique_ptr<duckdb_re2::RE2>> strip_patterns;
+    //! -1 when approximate matching is disabled
+    int64_t max_distance = -1;
+};
+
+} // namespace duckdb
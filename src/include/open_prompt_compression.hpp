@@ -0,0 +1,27 @@
+#pragma once
+
+#include "duckdb.hpp"
+
+namespace duckdb {
+
+//! Content-Encoding of request bodies, set with openprompt_compression
+enum class OpenPromptCompression : uint8_t { NONE, GZIP, ZSTD };
+
+//! Largest response body DecompressBody produces, a larger one is rejected instead of exhausting memory
+static constexpr idx_t MAX_DECOMPRESSED_BODY_SIZE = 256 * 1024 * 1024;
+
+OpenPromptCompression ParseCompression(const string &name);
+//! The Content-Encoding header value of a compressed body
+const char *CompressionEncoding(OpenPromptCompression compression);
+//! The Accept-Encoding header sent along with compressed requests, every encoding DecompressBody decodes
+const char *AcceptedEncodings();
+
+//! Compress `input` into `out`, replacing its contents. The deflate and zstd contexts are kept per thread and reused
+//! across requests, so their state is allocated once per thread instead of once per request
+void CompressBody(OpenPromptCompression compression, int level, const string &input, string &out);
+//! Decode a response body in place according to its Content-Encoding, empty and identity encodings are left as is.
+//! Throws an IOException for bodies that are corrupt, decode to more than MAX_DECOMPRESSED_BODY_SIZE or use an
+//! encoding that was not asked for
+void DecompressBody(const string &encoding, string &body);
+
+} // namespace duckdb
@@ -0,0 +1,12 @@
+#pragma once
+
+#include "duckdb.hpp"
+#include "duckdb/function/scalar_function.hpp"
+
+namespace duckdb {
+
+//! open_embed(text[, model][, dimensions := N]): embeddings from an OpenAI-compatible /v1/embeddings endpoint,
+//! returned as FLOAT[N]. Rows of a vector are packed into requests of up to openprompt_embedding_batch_size inputs
+ScalarFunctionSet GetOpenEmbedFunction();
+
+} // namespace duckdb
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "duckdb.hpp"
+#include "duckdb/common/chrono.hpp"
+#include "duckdb/common/mutex.hpp"
+#include "duckdb/common/optional_ptr.hpp"
+#include "duckdb/storage/object_cache.hpp"
+#include "http_client_pool.hpp"
+
+namespace duckdb {
+
+//! One entry of an endpoint list
+struct OpenPromptEndpointSpec {
+    string url;
+    double weight = 1;
+};
+
+//! A model server behind an endpoint list
+struct OpenPromptBackend {
+    string url;
+    HTTPEndpoint endpoint;
+    double weight = 1;
+    //! Requests currently sent to this backend
+    idx_t outstanding = 0;
+    idx_t requests = 0;
+    idx_t failures = 0;
+    //! Failures since the last success, the backend is taken out once it reaches the limit
+    idx_t consecutive_failures = 0;
+    steady_clock::time_point unhealthy_until;
+};
+
+struct OpenPromptBackendStats {
+    string url;
+    double weight;
+    idx_t outstanding;
+    idx_t requests;
+    idx_t failures;
+    bool healthy;
+};
+
+//! Database-wide state of the backends of an endpoint list, e.g. "http://a/v1/chat/completions;weight=2, http://b/...".
+//! Requests go to the healthy backend with the fewest outstanding requests relative to its weight. Backends that
+//! keep failing with connection errors or 5xx responses are left out for a cooldown period (a passive health check)
+class OpenPromptEndpointSet : public ObjectCacheEntry {
+public:
+    explicit OpenPromptEndpointSet(const string &url_list);
+
+    static string ObjectType() {
+        return "open_prompt_endpoint_set";
+    }
+    string GetObjectType() override {
+        return ObjectType();
+    }
+
+    static shared_ptr<OpenPromptEndpointSet> Get(ClientContext &context, const string &url_list);
+    //! Split a comma separated list of "url[;weight=N]" entries, throws an InvalidInputException when malformed
+    static vector<OpenPromptEndpointSpec> ParseList(const string &url_list);
+    //! The inverse of ParseList
+    static string FormatList(const vector<OpenPromptEndpointSpec> &specs);
+
+    void Configure(idx_t max_failures, double cooldown_seconds);
+    idx_t Size() const {
+        return backends.size();
+    }
+    //! The first backend of the list, used by the batch modes that cannot spread a batch over backends
+    const OpenPromptBackend &Primary() const {
+        return *backends[0];
+    }
+    //! Pick a backend for a request, avoiding `exclude` when another one is available. Must be released
+    OpenPromptBackend &Acquire(optional_ptr<const OpenPromptBackend> exclude = nullptr);
+    //! Report the outcome of an acquired request, `failed` for connection errors and 5xx responses
+    void Release(OpenPromptBackend &backend, bool failed);
+    //! Whether a healthy backend other than `backend` is available to fail over to
+    bool HasHealthyAlternative(const OpenPromptBackend &backend);
+    vector<OpenPromptBackendStats> GetStats();
+
+private:
+    mutex lock;
+    //! Fixed at construction, only the counters of the backends change
+    vector<unique_ptr<OpenPromptBackend>> backends;
+    //! Where the next selection starts, so that ties are spread round-robin
+    idx_t next_start = 0;
+    idx_t max_failures = 3;
+    double cooldown_seconds = 10;
+};
+
+} // namespace duckdb
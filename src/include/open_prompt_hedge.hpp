@@ -0,0 +1,138 @@
+#pragma once
+
+#include "duckdb.hpp"
+#include "duckdb/common/chrono.hpp"
+#include "duckdb/common/mutex.hpp"
+#include "duckdb/storage/object_cache.hpp"
+#include "http_client_pool.hpp"
+#include "open_prompt_request.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <thread>
+
+namespace duckdb {
+
+//! Database-wide hedging state of an endpoint list: the latencies of its recent successful requests, which set the
+//! hedge delay, and how many requests were hedged, which is kept within a budget
+class OpenPromptHedgePolicy : public ObjectCacheEntry {
+public:
+    //! Latencies the delay is computed from
+    static constexpr idx_t WINDOW_SIZE = 512;
+    //! Requests are not hedged before this many latencies were observed
+    static constexpr idx_t MIN_SAMPLES = 20;
+
+    static string ObjectType() {
+        return "open_prompt_hedge_policy";
+    }
+    string GetObjectType() override {
+        return ObjectType();
+    }
+
+    static shared_ptr<OpenPromptHedgePolicy> Get(ClientContext &context, const string &url_list);
+
+    //! The latency of a successful request
+    void Record(double latency_ms);
+    //! Count a request that may be hedged
+    void RecordRequest();
+    //! The latency at `percentile` (0-100) of the recent requests, negative while too few were observed
+    double Delay(double percentile);
+    //! Reserve a hedge if that keeps the hedges within `budget_percent` of the recent requests
+    bool TryHedge(double budget_percent);
+
+private:
+    mutex lock;
+    //! Ring buffer of the last WINDOW_SIZE latencies
+    vector<double> window;
+    idx_t next = 0;
+    //! The delay is recomputed after this many new latencies, or when the percentile changes
+    idx_t records_since_update = 0;
+    double cached_percentile = -1;
+    double cached_delay = 0;
+    //! Both halved regularly, so that the budget follows the recent traffic
+    idx_t requests = 0;
+    idx_t hedges = 0;
+};
+
+//! A request and its hedge racing for the same response. The first success decides the race, the connection of
+//! the other attempt is shut down so that it returns right away instead of waiting for its response
+class OpenPromptHedgeRace {
+public:
+    static constexpr idx_t PRIMARY = 0;
+    static constexpr idx_t HEDGE = 1;
+
+    //! Make the client of an attempt known before it sends, returns false when the attempt was stopped already
+    bool Register(idx_t attempt, duckdb_httplib_openssl::Client &client);
+    //! Forget the client once its request returned, returns true when it was stopped and must not be reused
+    bool Unregister(idx_t attempt);
+    bool Stopped(idx_t attempt);
+    //! Report the outcome of an attempt, nullptr when it failed. Returns true when the attempt won the race, a
+    //! winning hedge response is moved into `response`
+    bool Finish(idx_t attempt, OpenPromptResponse *attempt_response);
+    //! Called once the hedge delay expired, returns true when the hedge is to be sent because the primary is still
+    //! running. The hedge must then call HedgeFinished once it returned
+    bool StartHedge();
+    void HedgeFinished();
+    //! Called by the primary once it finished: a hedge that was not started is never sent, a running one is waited for
+    void CancelHedge();
+    bool HedgeWon();
+
+    //! The winning hedge response
+    OpenPromptResponse response;
+
+private:
+    mutex lock;
+    std::condition_variable cv;
+    duckdb_httplib_openssl::Client *clients[2] = {nullptr, nullptr};
+    bool stopped[2] = {false, false};
+    bool finished[2] = {false, false};
+    bool decided = false;
+    idx_t winner = PRIMARY;
+    bool hedge_pending = true;
+    bool hedge_running = false;
+};
+
+//! Database-wide sender of hedges. A single timer thread waits for the hedge delays of all requests in flight, a
+//! hedge is only handed to a runner thread once its delay expired while its primary is still running. Threads are
+//! started on first use and kept until the database is closed
+class OpenPromptHedgeScheduler : public ObjectCacheEntry {
+public:
+    ~OpenPromptHedgeScheduler() override;
+
+    static string ObjectType() {
+        return "open_prompt_hedge_scheduler";
+    }
+    string GetObjectType() override {
+        return ObjectType();
+    }
+
+    static shared_ptr<OpenPromptHedgeScheduler> Get(ClientContext &context);
+
+    //! Run `hedge` on a runner thread after `delay_ms`, unless the primary of `race` finished before
+    void Schedule(shared_ptr<OpenPromptHedgeRace> race, double delay_ms, std::function<void()> hedge);
+
+private:
+    struct PendingHedge {
+        shared_ptr<OpenPromptHedgeRace> race;
+        std::function<void()> hedge;
+    };
+
+    void TimerLoop();
+    void RunnerLoop();
+
+    mutex lock;
+    std::condition_variable timer_wakeup;
+    std::condition_variable hedge_ready;
+    //! Hedges waiting for their delay, by deadline
+    std::multimap<steady_clock::time_point, PendingHedge> timers;
+    //! Hedges whose delay expired, waiting for a runner
+    std::deque<PendingHedge> ready;
+    std::thread timer_thread;
+    vector<std::thread> runners;
+    idx_t idle_runners = 0;
+    bool shutdown = false;
+};
+
+} // namespace duckdb
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "duckdb.hpp"
+#include "duckdb/function/scalar_function.hpp"
+#include "duckdb/function/table_function.hpp"
+
+namespace duckdb {
+
+//! open_prompt_submit('table', 'column'[, job := ..., key := ...]): start a background job that sends a prompt for
+//! every row of a table. The prompts are copied into open_prompt_job_inputs when the job is submitted and every
+//! completed batch is appended to open_prompt_job_results, so a job that was cancelled or lost with the process is
+//! resumed by submitting it again, without sending completed rows twice
+TableFunction GetOpenPromptSubmitFunction();
+//! open_prompt_status(): progress and state of every job
+TableFunction GetOpenPromptStatusFunction();
+//! open_prompt_collect('job'): the completed rows of a job
+TableFunction GetOpenPromptCollectFunction();
+//! open_prompt_cancel('job'): stop a running job, the batches it completed are kept
+ScalarFunction GetOpenPromptCancelFunction();
+
+} // namespace duckdb
@@ -0,0 +1,12 @@
+#pragma once
+
+#include "duckdb.hpp"
+#include "duckdb/function/table_function.hpp"
+
+namespace duckdb {
+
+//! open_prompt_map((SELECT ...), 'column'): a table in-out function that keeps a window of requests in flight
+//! across input chunks and emits rows in the order their completions arrive
+TableFunction GetOpenPromptMapFunction();
+
+} // namespace duckdb
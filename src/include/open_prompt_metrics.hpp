@@ -0,0 +1,109 @@
+#pragma once
+
+#include "duckdb.hpp"
+#include "duckdb/common/atomic.hpp"
+#include "duckdb/storage/object_cache.hpp"
+
+namespace duckdb {
+
+class HTTPState;
+struct OpenPromptResponse;
+
+//! Lock-free latency histogram with logarithmic buckets, four per power of two milliseconds
+class OpenPromptLatencyHistogram {
+public:
+    static constexpr idx_t BUCKET_COUNT = 100;
+
+    OpenPromptLatencyHistogram() {
+        Reset();
+    }
+
+    void Record(double latency_ms);
+    //! Approximate latency at percentile `p` (0-100), the upper bound of the bucket it falls in
+    double Percentile(double p) const;
+    idx_t Count() const;
+    void Reset();
+
+private:
+    static idx_t BucketIndex(double latency_ms);
+    static double BucketUpperBound(idx_t bucket);
+
+    atomic<idx_t> buckets[BUCKET_COUNT];
+};
+
+//! Counters of the open_prompt requests sent by a query or by the whole database
+struct OpenPromptMetrics {
+    atomic<idx_t> requests {0};
+    atomic<idx_t> errors {0};
+    atomic<idx_t> retries {0};
+    atomic<idx_t> throttled {0};
+    //! Requests moved to another backend of an endpoint list after a failure
+    atomic<idx_t> failovers {0};
+    //! Duplicate requests sent for slow requests, and how often the duplicate answered first
+    atomic<idx_t> hedges {0};
+    atomic<idx_t> hedge_wins {0};
+    atomic<idx_t> cache_hits {0};
+    atomic<idx_t> deduplicated {0};
+    atomic<idx_t> connections_opened {0};
+    atomic<idx_t> connections_reused {0};
+    atomic<idx_t> bytes_sent {0};
+    atomic<idx_t> bytes_received {0};
+    //! Request and response bodies before compression, equal to the bytes on the wire when nothing is compressed
+    atomic<idx_t> payload_bytes_sent {0};
+    atomic<idx_t> payload_bytes_received {0};
+    atomic<idx_t> prompt_tokens {0};
+    atomic<idx_t> completion_tokens {0};
+    atomic<idx_t> streamed_requests {0};
+    //! Sum of the time to first token of streamed requests
+    atomic<idx_t> time_to_first_token_us {0};
+    OpenPromptLatencyHistogram latency;
+
+    void Reset();
+    bool IsEmpty() const {
+        return requests == 0 && cache_hits == 0 && deduplicated == 0;
+    }
+};
+
+//! Database-wide metrics since the extension was loaded
+class OpenPromptStats : public ObjectCacheEntry {
+public:
+    static string ObjectType() {
+        return "open_prompt_stats";
+    }
+    string GetObjectType() override {
+        return ObjectType();
+    }
+
+    static shared_ptr<OpenPromptStats> Get(ClientContext &context);
+
+    OpenPromptMetrics metrics;
+};
+
+//! Records every event into both the per-query HTTPState and the database-wide OpenPromptStats
+class OpenPromptMetricsRecorder {
+public:
+    explicit OpenPromptMetricsRecorder(ClientContext &context);
+
+    //! A request that received a response, successful or not
+    void RecordRequest(idx_t bytes_sent, idx_t bytes_received, double latency_ms, bool reused_connection);
+    //! Uncompressed size of the bodies of a request recorded with RecordRequest
+    void RecordPayload(idx_t bytes_sent, idx_t bytes_received);
+    void RecordResponse(const OpenPromptResponse &response);
+    void RecordError();
+    void RecordRetry();
+    void RecordThrottled();
+    void RecordFailover();
+    void RecordHedge();
+    void RecordHedgeWin();
+    void RecordCacheHit();
+    void RecordDeduplicated();
+
+private:
+    template <class FUNC>
+    void Apply(FUNC &&func);
+
+    shared_ptr<HTTPState> query_state;
+    shared_ptr<OpenPromptStats> database_stats;
+};
+
+} // namespace duckdb
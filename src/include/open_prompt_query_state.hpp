@@ -0,0 +1,84 @@
+#pragma once
+
+#include "duckdb/common/mutex.hpp"
+#include "duckdb/common/string.hpp"
+#include "duckdb/common/unordered_map.hpp"
+#include "duckdb/main/client_context.hpp"
+#include "duckdb/main/client_context_state.hpp"
+
+#include <condition_variable>
+
+namespace duckdb {
+
+//! A request that is being sent, or has been answered, within the current query
+struct OpenPromptSharedResponse {
+    //! Block until the owner of the request has completed it
+    void Wait() {
+        std::unique_lock<mutex> guard(lock);
+        cv.wait(guard, [&]() { return done; });
+    }
+
+    mutex lock;
+    std::condition_variable cv;
+    bool done = false;
+    bool success = false;
+    string response;
+    int32_t status = 0;
+    double latency_ms = 0;
+};
+
+//! Query-scoped map of request keys to responses, so that each distinct request is sent once per query
+class OpenPromptQueryState : public ClientContextState {
+public:
+    static shared_ptr<OpenPromptQueryState> Get(ClientContext &context) {
+        return context.registered_state->GetOrCreate<OpenPromptQueryState>("open_prompt_query_state");
+    }
+
+    //! Find the response for `key`, or register the caller as the one responsible for sending it
+    shared_ptr<OpenPromptSharedResponse> Claim(const string &key, bool &is_owner) {
+        lock_guard<mutex> parallel_lock(lock);
+        auto lookup = map.find(key);
+        if (lookup != map.end()) {
+            is_owner = false;
+            return lookup->second;
+        }
+        is_owner = true;
+        auto entry = make_shared_ptr<OpenPromptSharedResponse>();
+        map[key] = entry;
+        return entry;
+    }
+
+    //! Publish the outcome to every waiter. Failures are forgotten so that later rows retry them
+    void Complete(const string &key, OpenPromptSharedResponse &entry, bool success, string response,
+                  int32_t status = 0, double latency_ms = 0) {
+        if (!success) {
+            lock_guard<mutex> parallel_lock(lock);
+            map.erase(key);
+        }
+        {
+            lock_guard<mutex> guard(entry.lock);
+            entry.done = true;
+            entry.success = success;
+            entry.response = std::move(response);
+            entry.status = status;
+            entry.latency_ms = latency_ms;
+        }
+        entry.cv.notify_all();
+    }
+
+    void Clear() {
+        lock_guard<mutex> parallel_lock(lock);
+        map.clear();
+    }
+
+    //! Called by the ClientContext when the current query ends
+    void QueryEnd(ClientContext &context) override {
+        Clear();
+    }
+
+protected:
+    mutex lock;
+    unordered_map<string, shared_ptr<OpenPromptSharedResponse>> map;
+};
+
+} // namespace duckdb
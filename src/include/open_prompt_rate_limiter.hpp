@@ -0,0 +1,61 @@
+#pragma once
+
+#include "duckdb.hpp"
+#include "duckdb/common/chrono.hpp"
+#include "duckdb/common/mutex.hpp"
+#include "duckdb/storage/object_cache.hpp"
+
+#include <condition_variable>
+
+namespace duckdb {
+
+struct OpenPromptRateLimits {
+    //! Requests per second, 0 for unlimited
+    double requests_per_second = 0;
+    //! Estimated prompt tokens per minute, 0 for unlimited
+    double tokens_per_minute = 0;
+    //! Upper bound of the adaptive number of in-flight requests across all threads
+    idx_t max_inflight = 256;
+};
+
+//! Database-wide token-bucket limiter with AIMD concurrency control.
+//! Throttling responses halve the allowed in-flight requests and request rate, successes slowly grow them back
+class OpenPromptRateLimiter : public ObjectCacheEntry {
+public:
+    static string ObjectType() {
+        return "open_prompt_rate_limiter";
+    }
+    string GetObjectType() override {
+        return ObjectType();
+    }
+
+    static shared_ptr<OpenPromptRateLimiter> Get(ClientContext &context);
+
+    void Configure(const OpenPromptRateLimits &limits_p);
+    //! Block until a request of `estimated_tokens` may be sent, returns false when interrupted
+    bool Acquire(idx_t estimated_tokens, const atomic<bool> &interrupted);
+    //! Report the outcome of an acquired request
+    void Release(bool throttled);
+    //! Stop sending any request for the given delay, e.g. on Retry-After
+    void Pause(double seconds);
+
+private:
+    //! Refill both buckets, requires the lock to be held
+    void RefillLocked(steady_clock::time_point now);
+
+    mutex lock;
+    std::condition_variable cv;
+    OpenPromptRateLimits limits;
+
+    double request_tokens = 0;
+    double prompt_tokens = 0;
+    steady_clock::time_point last_refill = steady_clock::now();
+    steady_clock::time_point paused_until = steady_clock::now();
+
+    //! AIMD state, the allowed in-flight requests and the fraction of the configured rate in use
+    double inflight_limit = 256;
+    double rate_factor = 1;
+    idx_t inflight = 0;
+};
+
+} // namespace duckdb
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "duckdb.hpp"
+
+namespace duckdb_yyjson {
+struct yyjson_doc;
+struct yyjson_val;
+}
+
+namespace duckdb {
+
+//! A completion returned by the API along with how it was obtained
+struct OpenPromptResponse {
+    string content;
+    //! The completion was cut short locally by a streaming stop condition
+    bool truncated = false;
+    //! Time until the first streamed token, 0 when not streaming
+    double time_to_first_token_ms = 0;
+    //! Streamed tokens per second after the first one, 0 when not streaming
+    double tokens_per_second = 0;
+    //! Token counts reported in the "usage" field, 0 when the server did not report them
+    idx_t prompt_tokens = 0;
+    idx_t completion_tokens = 0;
+    //! Size of the response body as received
+    idx_t bytes_received = 0;
+};
+
+//! Extract the message content from a parsed chat completion, throws when it is missing
+string ParseCompletionContent(duckdb_yyjson::yyjson_val *root);
+//! Read the token counts of a "usage" object, if present, into `response`
+void ParseCompletionUsage(duckdb_yyjson::yyjson_val *root, OpenPromptResponse &response);
+//! Parse a chat completion response body into its message content and token usage. The body is parsed in place
+//! and its buffer is reused for the content, so the completion is never copied
+OpenPromptResponse ParseCompletionResponse(string &&body);
+
+//! Parse `body` in place with yyjson's insitu mode, using per-thread memory that is reused across documents.
+//! Strings of the document point into `body`, which must outlive it. Returns nullptr on invalid JSON, the document
+//! must be freed with yyjson_doc_free before the next call on the same thread
+duckdb_yyjson::yyjson_doc *ReadJSONInsitu(string &body);
+
+//! Append `str` to `out` as a quoted JSON string
+void AppendJSONString(string &out, const char *str, idx_t len);
+//! Append `str` to `out` with JSON string escaping but without the surrounding quotes
+void AppendJSONEscaped(string &out, const char *str, idx_t len);
+
+//! Chat completion request body with everything but the user message rendered ahead of time
+struct OpenPromptRequestTemplate {
+    //! The body up to and including the system message, ends inside the "messages" array
+    string prefix;
+    bool has_system_message = false;
+
+    static OpenPromptRequestTemplate Create(const string &model_name, const string &json_schema,
+                                            const string &system_prompt);
+    //! The template for these options, only rebuilt when they differ from the previous call on this thread.
+    //! The reference stays valid until the next call on the same thread
+    static const OpenPromptRequestTemplate &GetCached(const string &model_name, const string &json_schema,
+                                                     const string &system_prompt);
+
+    //! Render the request body for a single user prompt into `out`, optionally asking for a streamed response
+    void Render(const char *user_prompt, idx_t user_prompt_len, string &out, bool stream = false) const;
+    //! Render the body up to the opening quote of the user message content into `out`, so that the caller can
+    //! append the escaped content in pieces (see AppendJSONEscaped) before calling EndUserMessage
+    void BeginUserMessage(string &out, idx_t content_size) const;
+    void EndUserMessage(string &out, bool stream = false) const;
+
+    bool operator==(const OpenPromptRequestTemplate &other) const {
+        return prefix == other.prefix && has_system_message == other.has_system_message;
+    }
+};
+
+} // namespace duckdb
@@ -0,0 +1,156 @@
+#pragma once
+
+#include "duckdb.hpp"
+#include "duckdb/common/atomic.hpp"
+#include "duckdb/common/string_util.hpp"
+#include "http_client_pool.hpp"
+#include "open_prompt_batch.hpp"
+#include "open_prompt_cache_match.hpp"
+#include "open_prompt_compression.hpp"
+#include "open_prompt_endpoints.hpp"
+#include "open_prompt_hedge.hpp"
+#include "open_prompt_metrics.hpp"
+#include "open_prompt_query_state.hpp"
+#include "open_prompt_rate_limiter.hpp"
+#include "open_prompt_request.hpp"
+#include "open_prompt_stream.hpp"
+#include "open_prompt_tokens.hpp"
+#include "open_prompt_worker_pool.hpp"
+#include "prompt_response_cache.hpp"
+
+#include <thread>
+
+namespace duckdb {
+
+//! A single request body and, once sent, its outcome
+struct OpenPromptRequest {
+    string body;
+    //! The bare user prompt, only needed by the multi_prompt and packed batch modes
+    string prompt;
+    //! The outcome is known without sending the request, e.g. for a prompt over the input token budget
+    bool completed = false;
+    bool success = false;
+    //! The completion, or the error message prefixed with "Error: "
+    string response;
+    //! HTTP status of the last response, 0 when none was received
+    int32_t status = 0;
+    //! Time until the outcome was known, including retries. Requests answered by an identical request of the same
+    //! query report the latency of that request
+    double latency_ms = 0;
+    //! Prompt and completion tokens reported by the server, 0 for cached and deduplicated responses
+    idx_t tokens = 0;
+
+    //! The error message without its "Error: " prefix
+    string ErrorMessage() const {
+        return StringUtil::StartsWith(response, "Error: ") ? response.substr(7) : response;
+    }
+};
+
+struct OpenPromptRetryOptions {
+    idx_t max_retries = 3;
+    idx_t base_delay_ms = 500;
+    idx_t max_delay_ms = 30000;
+};
+
+//! The response cache configured for the context, or nullptr when caching is disabled
+shared_ptr<PromptResponseCache> GetResponseCache(ClientContext &context);
+
+//! Sends chat completion requests for one vector, going through the response cache, per-query deduplication,
+//! the rate limiter and the configured batch mode, and records metrics for every request
+class OpenPromptSender {
+public:
+    //! Reads every openprompt_* setting of the context
+    OpenPromptSender(ClientContext &context, const string &api_url, const string &api_token);
+
+    //! Whether request bodies have to be rendered for a streamed response
+    bool Streaming() const {
+        return stream_options.enabled;
+    }
+    //! Whether identical request bodies should only be sent once
+    bool Deduplicate() const {
+        return deduplicate;
+    }
+    //! Maximum number of requests of one vector sent at the same time
+    idx_t MaxConcurrency() const {
+        return max_concurrency;
+    }
+    OpenPromptBatchMode GetBatchMode() const {
+        return batch_mode;
+    }
+    //! Whether requests need their bare prompt, see OpenPromptRequest::prompt
+    bool NeedsPrompts() const {
+        return batch_mode == OpenPromptBatchMode::MULTI_PROMPT || batch_mode == OpenPromptBatchMode::PACKED ||
+               (response_cache && (cache_matcher.Normalizes() || cache_matcher.Approximate()));
+    }
+    const OpenPromptTokenBudget &TokenBudget() const {
+        return token_budget;
+    }
+    OpenPromptMetricsRecorder &Metrics() {
+        return recorder;
+    }
+    //! Run task(0) .. task(task_count - 1) on at most MaxConcurrency() threads of the database's worker pool.
+    //! Tasks must not throw; each one is responsible for recording its own outcome
+    void RunConcurrently(idx_t task_count, const std::function<void(idx_t)> &task) {
+        worker_pool->Run(task_count, max_concurrency, task);
+    }
+
+    //! Send every request and fill in its outcome, bodies must be distinct. Failed requests do not throw, their
+    //! response holds the error. `model_name`, `json_schema` and `system_prompt` are the options the bodies were
+    //! rendered with, the multi_prompt and packed batch modes build their own bodies from them
+    void Send(vector<OpenPromptRequest> &requests, const string &model_name, const string &json_schema,
+              const string &system_prompt);
+    //! Send one request through the query's deduplication and the response cache and record its outcome instead of
+    //! throwing. Safe to call from any thread
+    void SendRequest(OpenPromptRequest &request);
+    //! Send one request through the rate limiter with retries, bypassing the cache. Throws on failure, safe to
+    //! call from any thread. With `raw_body` the response body is returned unparsed as the content and streaming
+    //! is not used, for endpoints other than chat completions
+    OpenPromptResponse SendOne(const string &body, bool raw_body = false);
+
+private:
+    //! Send a request once. An attempt of a hedge race registers its connection with `race`, so that it can be cut
+    //! off when the other attempt wins
+    OpenPromptResponse PerformRequest(const HTTPEndpoint &endpoint, const string &body, bool raw_body,
+                                      optional_ptr<OpenPromptHedgeRace> race = nullptr,
+                                      idx_t attempt = OpenPromptHedgeRace::PRIMARY);
+    //! Send a request to `backend`, and a duplicate to another backend once it takes longer than the hedge
+    //! percentile of the recent requests. The first success is returned
+    OpenPromptResponse PerformHedgedRequest(const OpenPromptBackend &backend, const string &body, bool raw_body);
+    //! Send the request on its own, bypassing the cache, and record its outcome instead of throwing. Returns
+    //! whether the response may be cached
+    bool SendAndRecord(OpenPromptRequest &request);
+    //! Look up the response cache, exactly and then for a near-duplicate prompt
+    bool FindCached(const string &cache_key, OpenPromptRequest &request);
+    //! Store a successful response in the response cache
+    void InsertCached(const string &cache_key, const OpenPromptRequest &request);
+
+    ClientContext &context;
+    string api_url;
+    string api_token;
+    //! The backends of `api_url`, which may list several endpoints
+    shared_ptr<OpenPromptEndpointSet> endpoints;
+    shared_ptr<HTTPClientPool> pool;
+    shared_ptr<OpenPromptWorkerPool> worker_pool;
+    shared_ptr<PromptResponseCache> response_cache;
+    OpenPromptCacheMatcher cache_matcher;
+    shared_ptr<OpenPromptQueryState> query_state;
+    shared_ptr<OpenPromptRateLimiter> limiter;
+    OpenPromptMetricsRecorder recorder;
+
+    bool deduplicate;
+    idx_t max_concurrency;
+    OpenPromptBatchMode batch_mode;
+    OpenPromptStreamOptions stream_options;
+    OpenPromptRetryOptions retry_options;
+    OpenPromptBatchOptions batch_options;
+    OpenPromptTokenBudget token_budget;
+    OpenPromptCompression compression = OpenPromptCompression::NONE;
+    int compression_level = 3;
+    //! nullptr when requests are not hedged
+    shared_ptr<OpenPromptHedgePolicy> hedge_policy;
+    shared_ptr<OpenPromptHedgeScheduler> hedge_scheduler;
+    double hedge_percentile = 0;
+    double hedge_budget_percent = 0;
+};
+
+} // namespace duckdb
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "duckdb.hpp"
+
+namespace duckdb {
+
+//! Access to the openprompt_* extension options
+struct OpenPromptSettings {
+public:
+    //! Register every extension option
+    static void Register(DBConfig &config);
+
+    static idx_t GetUBigInt(ClientContext &context, const string &setting_name, idx_t default_value);
+    static double GetDouble(ClientContext &context, const string &setting_name, double default_value);
+    static bool GetBoolean(ClientContext &context, const string &setting_name, bool default_value);
+    //! Returns an empty string when the setting is not set
+    static string GetString(ClientContext &context, const string &setting_name);
+    //! Returns an empty list when the setting is not set
+    static vector<string> GetStringList(ClientContext &context, const string &setting_name);
+    //! Read a variable assigned with SET VARIABLE or one of the set_* functions
+    static string GetVariable(ClientContext &context, const string &var_name, const string &default_value);
+};
+
+} // namespace duckdb
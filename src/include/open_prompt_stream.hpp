@@ -0,0 +1,58 @@
+#pragma once
+
+#include "duckdb.hpp"
+#include "duckdb/common/chrono.hpp"
+#include "http_client_pool.hpp"
+#include "open_prompt_request.hpp"
+
+namespace duckdb {
+
+struct OpenPromptStreamOptions {
+    //! Request a server-sent event stream instead of a single response
+    bool enabled = false;
+    //! Stop reading once the completion has this many characters, 0 for no limit
+    idx_t max_chars = 0;
+    //! Stop reading once the completion contains this string, which is not included in the result
+    string stop_pattern;
+};
+
+//! Incrementally decodes a server-sent event stream of chat completion chunks
+class OpenPromptStreamDecoder {
+public:
+    explicit OpenPromptStreamDecoder(const OpenPromptStreamOptions &options_p);
+
+    //! Feed received bytes, returns false once a stop condition was reached and reading should be cut off. After
+    //! [DONE] the rest of the body is accepted and ignored, so that the connection can be reused
+    bool Feed(const char *data, idx_t len);
+    //! Whether the stream ended with [DONE]
+    bool Done() const {
+        return done;
+    }
+    //! Whether a stop condition ended reading early
+    bool Stopped() const {
+        return stopped;
+    }
+    //! Compute the timing metrics and return the completion
+    OpenPromptResponse &Finalize();
+
+private:
+    //! Handle a single "data:" payload
+    void HandleEvent(const char *data, idx_t len);
+    void ApplyStopConditions(idx_t previous_size);
+
+    const OpenPromptStreamOptions &options;
+    OpenPromptResponse response;
+    string buffer;
+    bool done = false;
+    bool stopped = false;
+    idx_t token_count = 0;
+    steady_clock::time_point start_time;
+    steady_clock::time_point first_token_time;
+};
+
+//! Send a streaming chat completion, closing the connection as soon as a stop condition is reached
+OpenPromptResponse PerformStreamingRequest(PooledHTTPClient &client, const HTTPEndpoint &endpoint,
+                                           const duckdb_httplib_openssl::Headers &headers, const string &body,
+                                           const OpenPromptStreamOptions &options);
+
+} // namespace duckdb
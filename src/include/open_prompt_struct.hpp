@@ -0,0 +1,35 @@
+#pragma once
+
+#include "duckdb.hpp"
+
+namespace duckdb_yyjson {
+struct yyjson_doc;
+struct yyjson_val;
+}
+
+namespace duckdb {
+
+//! Derive the STRUCT type matching a JSON schema of "type": "object", throws a BinderException when the schema
+//! cannot be mapped. Strings and enums become VARCHAR, integers BIGINT, numbers DOUBLE, booleans BOOLEAN,
+//! arrays LIST and nested objects STRUCT. Properties without a usable type are kept as their JSON text
+LogicalType JSONSchemaToStructType(const string &json_schema);
+
+//! Decode a parsed JSON value into row `row` of a flat `result` vector of the given type. Missing values and
+//! values of the wrong type become NULL
+void WriteJSONValue(duckdb_yyjson::yyjson_val *val, Vector &result, idx_t row);
+
+//! A completion parsed once, so that rows sharing a request are decoded from the same document
+class OpenPromptJSONContent {
+public:
+    explicit OpenPromptJSONContent(const string &content);
+    ~OpenPromptJSONContent();
+    OpenPromptJSONContent(const OpenPromptJSONContent &) = delete;
+
+    //! The root value, nullptr when the content is not valid JSON
+    duckdb_yyjson::yyjson_val *Root() const;
+
+private:
+    duckdb_yyjson::yyjson_doc *doc;
+};
+
+} // namespace duckdb
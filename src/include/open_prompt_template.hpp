@@ -0,0 +1,52 @@
+#pragma once
+
+#include "duckdb.hpp"
+#include "duckdb/common/case_insensitive_map.hpp"
+#include "open_prompt_tokens.hpp"
+
+namespace duckdb {
+
+//! A prompt with named placeholders such as "Classify {a} given {b}", parsed once at bind time. Each placeholder
+//! refers to a function argument, "{{" and "}}" stand for literal braces and any other brace is kept as is
+class OpenPromptTextTemplate {
+public:
+    //! Parse `text`, resolving placeholders to argument indexes through `arguments`. Throws a BinderException for
+    //! placeholders without an argument and for arguments the template does not use
+    static OpenPromptTextTemplate Parse(const string &text, const case_insensitive_map_t<idx_t> &arguments);
+
+    const string &Text() const {
+        return text;
+    }
+    //! The argument indexes the template reads, each listed once
+    const vector<idx_t> &Arguments() const {
+        return arguments;
+    }
+    //! Size of the rendered prompt for these argument values, before escaping
+    idx_t RenderedSize(const vector<string_t> &values) const;
+    //! Append the rendered prompt to `out` as JSON string content. The literal text was escaped at parse time, only
+    //! the argument values are escaped as they are copied
+    void AppendEscaped(string &out, const vector<string_t> &values) const;
+    //! Estimated tokens of the rendered prompt, without rendering it
+    idx_t EstimateTokens(const vector<string_t> &values, const OpenPromptTokenEstimator &estimator) const;
+    //! The rendered prompt as plain text
+    string Render(const vector<string_t> &values) const;
+
+    bool operator==(const OpenPromptTextTemplate &other) const {
+        return text == other.text && arguments == other.arguments;
+    }
+
+private:
+    struct Segment {
+        //! Literal text, unescaped and JSON escaped, or the argument index of a placeholder
+        string literal;
+        string escaped_literal;
+        idx_t argument = DConstants::INVALID_INDEX;
+    };
+
+    string text;
+    vector<Segment> segments;
+    vector<idx_t> arguments;
+    idx_t literal_size = 0;
+};
+
+} // namespace duckdb
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "duckdb.hpp"
+#include "duckdb/function/scalar_function.hpp"
+
+namespace duckdb {
+
+//! Estimates token counts locally, without the model's tokenizer. Runs of letters and digits count one token per
+//! `chars_per_token` characters, other ASCII symbols one token each, whitespace is folded into the next token and
+//! every non-ASCII code point counts as a token of its own. For English text with BPE tokenizers this tends to
+//! overestimate slightly, which is the safe side for a context budget
+class OpenPromptTokenEstimator {
+public:
+    explicit OpenPromptTokenEstimator(double chars_per_token = 4);
+
+    idx_t Estimate(const char *str, idx_t len) const;
+    idx_t Estimate(const string &str) const {
+        return Estimate(str.c_str(), str.size());
+    }
+    //! Length of the longest prefix of `str` estimated at no more than `max_tokens`, ends on a code point boundary
+    idx_t TruncateLength(const char *str, idx_t len, idx_t max_tokens) const;
+    //! Split `str` into pieces of at most `max_tokens` each, ending at whitespace where possible. Consecutive pieces
+    //! share roughly `overlap_tokens` of text
+    vector<string> Chunk(const char *str, idx_t len, idx_t max_tokens, idx_t overlap_tokens = 0) const;
+
+private:
+    //! Scan `str` until the next code point would exceed `max_tokens`, returns the offset reached and the tokens
+    //! counted up to there in `tokens`
+    idx_t Scan(const char *str, idx_t len, idx_t max_tokens, idx_t &tokens) const;
+
+    double chars_per_token;
+};
+
+//! How prompts over the input token budget are handled
+enum class OpenPromptOverflowMode : uint8_t {
+    //! The row fails with an error, without sending the request
+    REJECT,
+    //! The prompt is cut to the budget
+    TRUNCATE
+};
+
+OpenPromptOverflowMode ParseOverflowMode(const string &mode);
+
+//! The input token budget of a request, read from the openprompt_max_input_tokens settings
+struct OpenPromptTokenBudget {
+    //! 0 when prompts are not checked
+    idx_t max_input_tokens = 0;
+    OpenPromptOverflowMode overflow = OpenPromptOverflowMode::REJECT;
+    OpenPromptTokenEstimator estimator;
+
+    bool Enabled() const {
+        return max_input_tokens > 0;
+    }
+};
+
+//! open_prompt_token_count(text): the estimated tokens of a text
+ScalarFunction GetOpenPromptTokenCountFunction();
+//! open_prompt_chunk(text, max_tokens[, overlap_tokens]): a text split into pieces that fit a token budget
+ScalarFunctionSet GetOpenPromptChunkFunction();
+
+} // namespace duckdb
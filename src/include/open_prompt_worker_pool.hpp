@@ -0,0 +1,58 @@
+#pragma once
+
+#include "duckdb.hpp"
+#include "duckdb/common/mutex.hpp"
+#include "duckdb/storage/object_cache.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <thread>
+
+namespace duckdb {
+
+//! Database-wide pool of request worker threads. Threads are started on demand and kept until the database is
+//! closed, so that every vector reuses them together with their thread-local parser, template and codec state
+class OpenPromptWorkerPool : public ObjectCacheEntry {
+public:
+    //! Threads are not started beyond this, requests over it wait for a free worker
+    static constexpr idx_t MAX_THREADS = 256;
+
+    ~OpenPromptWorkerPool() override;
+
+    static string ObjectType() {
+        return "open_prompt_worker_pool";
+    }
+    string GetObjectType() override {
+        return ObjectType();
+    }
+
+    static shared_ptr<OpenPromptWorkerPool> Get(ClientContext &context);
+
+    //! Run task(0) .. task(task_count - 1) on the calling thread and at most max_concurrency - 1 pool threads,
+    //! returns once every task finished. Tasks must not throw; each one is responsible for recording its own outcome
+    void Run(idx_t task_count, idx_t max_concurrency, const std::function<void(idx_t)> &task);
+    //! Run `task` on a pool thread without waiting for it. Tasks over MAX_THREADS wait for a free worker, tasks
+    //! still waiting when the database is closed are dropped. The task must not throw
+    void Submit(std::function<void()> task);
+    idx_t ThreadCount();
+
+private:
+    struct Job;
+
+    void WorkerLoop();
+    //! Take tasks of `job` until none are left
+    static void RunTasks(Job &job);
+
+    mutex lock;
+    std::condition_variable work_available;
+    //! Jobs that still accept helper threads
+    std::deque<shared_ptr<Job>> jobs;
+    //! Submitted tasks not yet picked up by a thread
+    std::deque<std::function<void()>> tasks;
+    vector<std::thread> threads;
+    idx_t idle_threads = 0;
+    bool shutdown = false;
+};
+
+} // namespace duckdb
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "duckdb.hpp"
+#include "duckdb/common/mutex.hpp"
+#include "duckdb/common/unordered_map.hpp"
+#include "duckdb/storage/object_cache.hpp"
+#include "prompt_similarity_index.hpp"
+
+#include <fstream>
+#include <list>
+
+namespace duckdb {
+
+struct PromptResponseCacheStats {
+    string path;
+    idx_t entries;
+    idx_t bytes;
+    idx_t hits;
+    idx_t misses;
+    idx_t evictions;
+    idx_t expirations;
+    //! Log writes that failed, e.g. on a full disk. The entries stay cached in memory
+    idx_t write_failures;
+    //! Fingerprints in the approximate match index
+    idx_t similar_entries;
+    //! Lookups answered with the response of a near-duplicate prompt
+    idx_t approximate_hits;
+};
+
+//! Content-addressed store of completions, persisted as an append-only log
+//! Entries are evicted in LRU order once the cache exceeds its size limit and expire after a TTL
+class PromptResponseCache : public ObjectCacheEntry {
+public:
+    explicit PromptResponseCache(string path_p);
+
+    static string ObjectType() {
+        return "open_prompt_response_cache";
+    }
+    string GetObjectType() override {
+        return ObjectType();
+    }
+
+    //! Get the cache stored at `path`, shared by every connection of the database
+    static shared_ptr<PromptResponseCache> Get(ClientContext &context, const string &path);
+    //! Key of a request, the hex encoded SHA-256 of the endpoint and serialized request body
+    static string ComputeKey(const string &api_url, const string &request_body);
+
+    void Configure(idx_t ttl_seconds_p, idx_t max_bytes_p);
+    //! Find and Insert do not throw, a cache that cannot be written counts a write failure and keeps its entries in
+    //! memory only
+    bool Find(const string &key, string &result);
+    void Insert(const string &key, const string &value);
+    //! Make the entry `key` findable by FindSimilar. The index is kept in memory only, entries loaded from the log
+    //! are matched exactly until they are inserted again
+    void InsertSimilar(const string &key, uint64_t context, uint64_t fingerprint);
+    //! Find the live entry indexed with the same context whose fingerprint is closest to `fingerprint`, at most
+    //! `max_distance` bits apart
+    bool FindSimilar(uint64_t context, uint64_t fingerprint, idx_t max_distance, string &result);
+    //! Remove every entry and truncate the log, returns the number of removed entries
+    idx_t Clear();
+    PromptResponseCacheStats GetStats();
+
+private:
+    struct Entry {
+        string value;
+        int64_t created;
+        std::list<string>::iterator lru_position;
+    };
+
+    bool IsExpired(const Entry &entry, int64_t now) const;
+    void EraseLocked(unordered_map<string, Entry>::iterator entry);
+    void EvictLocked();
+    //! Read the log on first use. Does not throw, a log that cannot be opened for appending leaves the cache in
+    //! memory only mode
+    void LoadLocked();
+    void AppendLocked(const string &key, const Entry &entry);
+    //! Rewrite the log with only the live entries
+    void CompactLocked();
+    void OpenLogLocked(std::ios::openmode mode);
+
+    mutex lock;
+    string path;
+    bool loaded = false;
+    unordered_map<string, Entry> entries;
+    //! Most recently used keys at the front
+    std::list<string> lru;
+    PromptSimilarityIndex similarity_index;
+    std::ofstream log;
+    idx_t total_bytes = 0;
+    idx_t log_bytes = 0;
+    //! A write failed, the log may end in a partial record and is rewritten on the next insert
+    bool log_damaged = false;
+    //! The log could not be opened when loading, entries are not written until the cache is cleared
+    bool memory_only = false;
+    idx_t ttl_seconds = 0;
+    idx_t max_bytes = 256 * 1024 * 1024;
+
+    idx_t hits = 0;
+    idx_t misses = 0;
+    idx_t evictions = 0;
+    idx_t expirations = 0;
+    idx_t write_failures = 0;
+    idx_t approximate_hits = 0;
+};
+
+} // namespace duckdb
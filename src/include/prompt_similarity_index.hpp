@@ -0,0 +1,52 @@
+#pragma once
+
+#include "duckdb.hpp"
+#include "duckdb/common/unordered_map.hpp"
+
+namespace duckdb {
+
+//! In-memory index of SimHash fingerprints of cached prompts, for reusing the response of a near-duplicate prompt.
+//! Fingerprints are split into BANDS bands. Two fingerprints at most 2 * BANDS - 1 bits apart differ in at most one
+//! bit of some band, so candidates are looked up by every band value and its single bit flips, and then confirmed
+//! with a popcount of their difference. Not thread-safe, the owning cache guards it with its own lock
+class PromptSimilarityIndex {
+public:
+    static constexpr idx_t BANDS = 8;
+    static constexpr idx_t BAND_BITS = 64 / BANDS;
+    //! Largest distance the band lookup is guaranteed to find
+    static constexpr idx_t MAX_DISTANCE = 2 * BANDS - 1;
+    //! Fingerprints kept, the oldest are replaced first
+    static constexpr idx_t CAPACITY = 65536;
+
+    //! SimHash over the words and pairs of consecutive words of `text`, ignoring case and punctuation
+    static uint64_t Fingerprint(const string &text);
+    //! Number of differing bits
+    static idx_t Distance(uint64_t left, uint64_t right);
+
+    void Insert(uint64_t context, uint64_t fingerprint, const string &key);
+    //! Keys indexed with the same context within `max_distance` bits of `fingerprint`, closest first
+    vector<string> Find(uint64_t context, uint64_t fingerprint, idx_t max_distance) const;
+    void Clear();
+    idx_t Size() const {
+        return entries.size();
+    }
+
+private:
+    struct Entry {
+        uint64_t context;
+        uint64_t fingerprint;
+        string key;
+    };
+
+    static uint64_t BucketKey(uint64_t context, idx_t band, uint64_t band_value);
+    static uint64_t BandValue(idx_t band, uint64_t fingerprint);
+    void RemoveFromBuckets(idx_t slot);
+
+    //! Ring buffer of the indexed fingerprints
+    vector<Entry> entries;
+    idx_t next = 0;
+    //! Slots of `entries` by context, band and band value
+    unordered_map<uint64_t, vector<idx_t>> buckets;
+};
+
+} // namespace duckdb
@@ -0,0 +1,310 @@
+#include "open_prompt_agg.hpp"
+#include "open_prompt_sender.hpp"
+#include "open_prompt_settings.hpp"
+
+#include "duckdb/common/exception/binder_exception.hpp"
+#include "duckdb/common/unordered_map.hpp"
+#include "duckdb/execution/expression_executor.hpp"
+#include "duckdb/function/aggregate_function.hpp"
+
+namespace duckdb {
+
+static constexpr const char *DEFAULT_AGG_INSTRUCTION = "Summarize the following texts.";
+//! Tokens of the "[n] " label and separator each text is sent with
+static constexpr idx_t AGG_ITEM_OVERHEAD = 4;
+
+struct OpenPromptAggData : public FunctionData {
+    explicit OpenPromptAggData(ClientContext &context_p) : context(context_p) {
+    }
+
+    //! Requests are sent when the groups are finalized, which only gets the bind data
+    ClientContext &context;
+    string api_url;
+    string api_token;
+    string model_name;
+    //! The same for every request of the query, at every level, so that servers can reuse its cached prefix
+    string system_prompt;
+    idx_t chunk_tokens = 0;
+    bool null_on_error = false;
+
+    unique_ptr<FunctionData> Copy() const override {
+        return make_uniq<OpenPromptAggData>(*this);
+    }
+    bool Equals(const FunctionData &other_p) const override {
+        auto &other = other_p.Cast<OpenPromptAggData>();
+        return api_url == other.api_url && api_token == other.api_token && model_name == other.model_name &&
+               system_prompt == other.system_prompt && chunk_tokens == other.chunk_tokens &&
+               null_on_error == other.null_on_error;
+    }
+};
+
+struct OpenPromptAggState {
+    //! The texts of the group in input order, nullptr until the first non-NULL text
+    vector<string> *texts;
+};
+
+struct OpenPromptAggOperation {
+    template <class STATE>
+    static void Initialize(STATE &state) {
+        state.texts = nullptr;
+    }
+    template <class STATE>
+    static void Destroy(STATE &state, AggregateInputData &aggr_input_data) {
+        delete state.texts;
+        state.texts = nullptr;
+    }
+    static bool IgnoreNull() {
+        return true;
+    }
+};
+
+static void OpenPromptAggUpdate(Vector inputs[], AggregateInputData &aggr_input_data, idx_t input_count,
+                                Vector &states, idx_t count) {
+    UnifiedVectorFormat text_data;
+    inputs[0].ToUnifiedFormat(count, text_data);
+    UnifiedVectorFormat state_data;
+    states.ToUnifiedFormat(count, state_data);
+    auto texts = UnifiedVectorFormat::GetData<string_t>(text_data);
+    auto state_ptrs = UnifiedVectorFormat::GetData<OpenPromptAggState *>(state_data);
+    for (idx_t i = 0; i < count; i++) {
+        auto text_idx = text_data.sel->get_index(i);
+        if (!text_data.validity.RowIsValid(text_idx)) {
+            continue;
+        }
+        auto &state = *state_ptrs[state_data.sel->get_index(i)];
+        if (!state.texts) {
+            state.texts = new vector<string>();
+        }
+        state.texts->push_back(texts[text_idx].GetString());
+    }
+}
+
+static void OpenPromptAggCombine(Vector &source, Vector &target, AggregateInputData &aggr_input_data, idx_t count) {
+    auto sources = FlatVector::GetData<OpenPromptAggState *>(source);
+    auto targets = FlatVector::GetData<OpenPromptAggState *>(target);
+    for (idx_t i = 0; i < count; i++) {
+        auto &source_state = *sources[i];
+        auto &target_state = *targets[i];
+        if (!source_state.texts) {
+            continue;
+        }
+        if (!target_state.texts) {
+            target_state.texts = source_state.texts;
+            source_state.texts = nullptr;
+            continue;
+        }
+        for (auto &text : *source_state.texts) {
+            target_state.texts->push_back(std::move(text));
+        }
+    }
+}
+
+//! The reduction of one group, one level at a time
+struct OpenPromptAggGroup {
+    //! Texts of the current level: the group's texts, then the answers of the previous level
+    vector<string> items;
+    //! Requests of the current level, one per chunk
+    vector<idx_t> chunk_requests;
+    //! The group has no non-NULL text, its result is NULL
+    bool empty = false;
+    bool done = false;
+    bool success = true;
+    string result;
+};
+
+//! Pack consecutive items into numbered lists of at most `max_tokens` estimated tokens. Items are at most half the
+//! budget, so every chunk but the last holds two items or more and each level at least halves the item count
+static vector<string> PackChunks(const vector<string> &items, const OpenPromptTokenEstimator &estimator,
+                                 idx_t max_tokens) {
+    vector<string> chunks;
+    string chunk;
+    idx_t chunk_tokens = 0;
+    idx_t chunk_items = 0;
+    for (auto &item : items) {
+        auto item_tokens = estimator.Estimate(item) + AGG_ITEM_OVERHEAD;
+        if (chunk_items > 0 && chunk_tokens + item_tokens > max_tokens) {
+            chunks.push_back(std::move(chunk));
+            chunk.clear();
+            chunk_tokens = 0;
+            chunk_items = 0;
+        }
+        if (chunk_items > 0) {
+            chunk += "\n\n";
+        }
+        chunk += "[" + std::to_string(++chunk_items) + "] ";
+        chunk += item;
+        chunk_tokens += item_tokens;
+    }
+    if (chunk_items > 0) {
+        chunks.push_back(std::move(chunk));
+    }
+    return chunks;
+}
+
+static void OpenPromptAggFinalize(Vector &states, AggregateInputData &aggr_input_data, Vector &result, idx_t count,
+                                  idx_t offset) {
+    auto &info = aggr_input_data.bind_data->Cast<OpenPromptAggData>();
+    UnifiedVectorFormat state_data;
+    states.ToUnifiedFormat(count, state_data);
+    auto state_ptrs = UnifiedVectorFormat::GetData<OpenPromptAggState *>(state_data);
+
+    OpenPromptSender sender(info.context, info.api_url, info.api_token);
+    auto &estimator = sender.TokenBudget().estimator;
+    auto max_tokens = info.chunk_tokens;
+    if (sender.TokenBudget().Enabled()) {
+        auto system_tokens = estimator.Estimate(info.system_prompt);
+        auto max_input_tokens = sender.TokenBudget().max_input_tokens;
+        max_tokens = MinValue(max_tokens, max_input_tokens > system_tokens ? max_input_tokens - system_tokens : 0);
+    }
+    max_tokens = MaxValue<idx_t>(max_tokens, 2 * (AGG_ITEM_OVERHEAD + 1));
+    auto max_item_tokens = max_tokens / 2 - AGG_ITEM_OVERHEAD;
+
+    // Long texts are split into pieces, so that they are summarized in full instead of cut off
+    vector<OpenPromptAggGroup> groups(count);
+    for (idx_t i = 0; i < count; i++) {
+        auto &state = *state_ptrs[state_data.sel->get_index(i)];
+        auto &group = groups[i];
+        if (!state.texts || state.texts->empty()) {
+            group.empty = true;
+            group.done = true;
+            continue;
+        }
+        for (auto &text : *state.texts) {
+            if (estimator.Estimate(text) <= max_item_tokens) {
+                group.items.push_back(text);
+                continue;
+            }
+            for (auto &piece : estimator.Chunk(text.c_str(), text.size(), max_item_tokens)) {
+                group.items.push_back(std::move(piece));
+            }
+        }
+    }
+
+    // Every level sends the chunks of all unfinished groups together, so that the groups are summarized
+    // concurrently instead of one after the other
+    auto &request_template = OpenPromptRequestTemplate::GetCached(info.model_name, "", info.system_prompt);
+    while (true) {
+        vector<OpenPromptRequest> requests;
+        unordered_map<string, idx_t> request_lookup;
+        for (auto &group : groups) {
+            if (group.done) {
+                continue;
+            }
+            group.chunk_requests.clear();
+            for (auto &chunk : PackChunks(group.items, estimator, max_tokens)) {
+                OpenPromptRequest request;
+                request_template.Render(chunk.c_str(), chunk.size(), request.body, sender.Streaming());
+                auto lookup = request_lookup.find(request.body);
+                if (lookup != request_lookup.end()) {
+                    group.chunk_requests.push_back(lookup->second);
+                    sender.Metrics().RecordDeduplicated();
+                    continue;
+                }
+                if (sender.NeedsPrompts()) {
+                    request.prompt = std::move(chunk);
+                }
+                request_lookup.emplace(request.body, requests.size());
+                group.chunk_requests.push_back(requests.size());
+                requests.push_back(std::move(request));
+            }
+        }
+        if (requests.empty()) {
+            break;
+        }
+        sender.Send(requests, info.model_name, "", info.system_prompt);
+
+        for (auto &group : groups) {
+            if (group.done) {
+                continue;
+            }
+            group.items.clear();
+            for (auto request_idx : group.chunk_requests) {
+                auto &request = requests[request_idx];
+                if (!request.success) {
+                    group.success = false;
+                    group.result = request.response;
+                    group.done = true;
+                    break;
+                }
+                // Answers are cut to half the budget, which keeps the reduction converging
+                auto length = estimator.TruncateLength(request.response.c_str(), request.response.size(),
+                                                       max_item_tokens);
+                group.items.push_back(request.response.substr(0, length));
+            }
+            if (!group.done && group.chunk_requests.size() == 1) {
+                group.result = requests[group.chunk_requests[0]].response;
+                group.done = true;
+            }
+        }
+    }
+
+    if (states.GetVectorType() == VectorType::CONSTANT_VECTOR) {
+        result.SetVectorType(VectorType::CONSTANT_VECTOR);
+    } else {
+        result.SetVectorType(VectorType::FLAT_VECTOR);
+    }
+    auto result_data = FlatVector::GetData<string_t>(result);
+    for (idx_t i = 0; i < count; i++) {
+        auto &group = groups[i];
+        auto row = i + offset;
+        if (group.empty || (!group.success && info.null_on_error)) {
+            if (result.GetVectorType() == VectorType::CONSTANT_VECTOR) {
+                ConstantVector::SetNull(result, true);
+            } else {
+                FlatVector::SetNull(result, row, true);
+            }
+            continue;
+        }
+        result_data[row] = StringVector::AddString(result, group.result);
+    }
+}
+
+static unique_ptr<FunctionData> OpenPromptAggBind(ClientContext &context, AggregateFunction &function,
+                                                  vector<unique_ptr<Expression>> &arguments) {
+    auto res = make_uniq<OpenPromptAggData>(context);
+    res->api_url = OpenPromptSettings::GetVariable(context, "openprompt_api_url",
+                                                   "http://localhost:11434/v1/chat/completions");
+    res->api_token = OpenPromptSettings::GetVariable(context, "openprompt_api_token", "");
+    res->model_name = OpenPromptSettings::GetVariable(context, "openprompt_model_name", "qwen2.5:0.5b");
+    res->chunk_tokens = OpenPromptSettings::GetUBigInt(context, "openprompt_agg_chunk_tokens", 4000);
+    res->null_on_error = OpenPromptSettings::GetBoolean(context, "openprompt_null_on_error", false);
+
+    // Instruction and model are part of the shared prefix, so they have to be constant
+    string instruction = DEFAULT_AGG_INSTRUCTION;
+    for (idx_t i = 1; i < arguments.size(); i++) {
+        if (!arguments[i]->IsFoldable()) {
+            throw BinderException("open_prompt_agg: the instruction and model must be constant");
+        }
+        auto value = ExpressionExecutor::EvaluateScalar(context, *arguments[i]);
+        if (value.IsNull()) {
+            continue;
+        }
+        if (i == 1) {
+            instruction = value.ToString();
+        } else {
+            res->model_name = value.ToString();
+        }
+    }
+    res->system_prompt = instruction + "\n\nThe input is a numbered list of texts, or of answers to earlier parts "
+                                       "of the same list. Reply with a single answer that covers every item.";
+    while (arguments.size() > 1) {
+        Function::EraseArgument(function, arguments, arguments.size() - 1);
+    }
+    return std::move(res);
+}
+
+AggregateFunctionSet GetOpenPromptAggFunction() {
+    AggregateFunctionSet set("open_prompt_agg");
+    for (idx_t argument_count = 1; argument_count <= 3; argument_count++) {
+        AggregateFunction function(
+            vector<LogicalType>(argument_count, LogicalType::VARCHAR), LogicalType::VARCHAR,
+            AggregateFunction::StateSize<OpenPromptAggState>,
+            AggregateFunction::StateInitialize<OpenPromptAggState, OpenPromptAggOperation>, OpenPromptAggUpdate,
+            OpenPromptAggCombine, OpenPromptAggFinalize, FunctionNullHandling::DEFAULT_NULL_HANDLING, nullptr,
+            OpenPromptAggBind, AggregateFunction::StateDestroy<OpenPromptAggState, OpenPromptAggOperation>);
+        set.AddFunction(function);
+    }
+    return set;
+}
+
+} // namespace duckdb
@@ -0,0 +1,413 @@
+#include "open_prompt_batch.hpp"
+#include "open_prompt_request.hpp"
+
+#include "duckdb/common/chrono.hpp"
+#include "duckdb/common/string_util.hpp"
+#include "yyjson.hpp"
+
+#include <chrono>
+#include <thread>
+
+namespace duckdb {
+
+using yyjson_doc_ptr = unique_ptr<duckdb_yyjson::yyjson_doc, void (*)(duckdb_yyjson::yyjson_doc *)>;
+
+//! Longest sleep between checks for an interrupt while waiting for a batch
+static constexpr int64_t POLL_SLICE_MS = 100;
+
+OpenPromptBatchMode ParseBatchMode(const string &mode) {
+    auto lmode = StringUtil::Lower(mode);
+    if (lmode.empty() || lmode == "none") {
+        return OpenPromptBatchMode::NONE;
+    } else if (lmode == "batch_api") {
+        return OpenPromptBatchMode::BATCH_API;
+    } else if (lmode == "multi_prompt") {
+        return OpenPromptBatchMode::MULTI_PROMPT;
+    } else if (lmode == "packed") {
+        return OpenPromptBatchMode::PACKED;
+    }
+    throw InvalidInputException(
+        "Unsupported openprompt_batch_mode \"%s\", expected none, batch_api, multi_prompt or packed", mode);
+}
+
+static yyjson_doc_ptr ParseJSON(const string &body, const string &what) {
+    yyjson_doc_ptr doc(duckdb_yyjson::yyjson_read(body.c_str(), body.length(), 0), &duckdb_yyjson::yyjson_doc_free);
+    if (!doc || !duckdb_yyjson::yyjson_doc_get_root(doc.get())) {
+        throw std::runtime_error("Failed to parse " + what + " response");
+    }
+    return doc;
+}
+
+static string GetStringField(duckdb_yyjson::yyjson_val *obj, const char *field) {
+    auto val = duckdb_yyjson::yyjson_obj_get(obj, field);
+    auto str = duckdb_yyjson::yyjson_get_str(val);
+    return str ? string(str, duckdb_yyjson::yyjson_get_len(val)) : string();
+}
+
+static duckdb_httplib_openssl::Headers AuthorizationHeaders(const string &api_token) {
+    duckdb_httplib_openssl::Headers headers;
+    if (!api_token.empty()) {
+        headers.emplace("Authorization", "Bearer " + api_token);
+    }
+    return headers;
+}
+
+static void CheckResponse(PooledHTTPClient &client, const duckdb_httplib_openssl::Result &res,
+                          const string &request_type, const string &what) {
+    if (!res) {
+        client.Discard();
+        HandleHttpError(res, request_type);
+    }
+    if (res->status != 200) {
+        throw std::runtime_error(what + " failed with HTTP error " + std::to_string(res->status) + ": " +
+                                 res->reason);
+    }
+}
+
+//! Perform one Batch API call with `send` and record it like a completion request, calls that received no
+//! response are not recorded
+template <class FUNC>
+static duckdb_httplib_openssl::Result RecordedCall(PooledHTTPClient &client, OpenPromptMetricsRecorder &recorder,
+                                                   idx_t bytes_sent, FUNC &&send) {
+    bool reused = client.Reused();
+    auto start_time = steady_clock::now();
+    auto res = send(*client);
+    if (res) {
+        auto latency_ms = std::chrono::duration<double, std::milli>(steady_clock::now() - start_time).count();
+        recorder.RecordRequest(bytes_sent, res->body.size(), latency_ms, reused);
+        recorder.RecordPayload(bytes_sent, res->body.size());
+    }
+    return res;
+}
+
+// The Batch API lives next to the chat completions endpoint, e.g. https://api.openai.com/v1/batches
+static string GetBatchAPIBase(const HTTPEndpoint &endpoint) {
+    static const string CHAT_COMPLETIONS = "/chat/completions";
+    auto &path = endpoint.path;
+    if (!StringUtil::EndsWith(path, CHAT_COMPLETIONS)) {
+        throw std::runtime_error("Batch API mode requires openprompt_api_url to end in " + CHAT_COMPLETIONS);
+    }
+    return path.substr(0, path.size() - CHAT_COMPLETIONS.size());
+}
+
+void SendBatchAPIRequests(ClientContext &context, HTTPClientPool &pool, OpenPromptMetricsRecorder &recorder,
+                          const string &api_url, const string &api_token, const vector<string> &request_bodies,
+                          const OpenPromptBatchOptions &options, vector<OpenPromptBatchResult> &results) {
+    results.resize(request_bodies.size());
+    if (request_bodies.empty()) {
+        return;
+    }
+    auto endpoint = HTTPEndpoint::Parse(api_url);
+    auto base = GetBatchAPIBase(endpoint);
+    auto headers = AuthorizationHeaders(api_token);
+
+    // 1. Upload the requests as a JSONL file, the custom_id is the index of the request
+    string jsonl;
+    for (idx_t i = 0; i < request_bodies.size(); i++) {
+        jsonl += "{\"custom_id\":\"request-" + std::to_string(i) + "\",\"method\":\"POST\",\"url\":";
+        AppendJSONString(jsonl, endpoint.path.c_str(), endpoint.path.size());
+        jsonl += ",\"body\":";
+        jsonl += request_bodies[i];
+        jsonl += "}\n";
+    }
+    string file_id;
+    {
+        auto client = pool.Acquire(endpoint);
+        duckdb_httplib_openssl::MultipartFormDataItems items = {
+            {"purpose", "batch", "", ""},
+            {"file", jsonl, "open_prompt_batch.jsonl", "application/jsonl"}
+        };
+        auto res = RecordedCall(client, recorder, jsonl.size(), [&](duckdb_httplib_openssl::Client &http) {
+            return http.Post((base + "/files").c_str(), headers, items);
+        });
+        CheckResponse(client, res, "POST", "Batch file upload");
+        auto doc = ParseJSON(res->body, "file upload");
+        file_id = GetStringField(duckdb_yyjson::yyjson_doc_get_root(doc.get()), "id");
+        if (file_id.empty()) {
+            throw std::runtime_error("Batch file upload response is missing the file id");
+        }
+    }
+
+    // 2. Create the batch
+    string batch_id;
+    {
+        string body = "{\"input_file_id\":";
+        AppendJSONString(body, file_id.c_str(), file_id.size());
+        body += ",\"endpoint\":";
+        AppendJSONString(body, endpoint.path.c_str(), endpoint.path.size());
+        body += ",\"completion_window\":\"24h\"}";
+        auto client = pool.Acquire(endpoint);
+        auto res = RecordedCall(client, recorder, body.size(), [&](duckdb_httplib_openssl::Client &http) {
+            return http.Post((base + "/batches").c_str(), headers, body, "application/json");
+        });
+        CheckResponse(client, res, "POST", "Batch creation");
+        auto doc = ParseJSON(res->body, "batch creation");
+        batch_id = GetStringField(duckdb_yyjson::yyjson_doc_get_root(doc.get()), "id");
+        if (batch_id.empty()) {
+            throw std::runtime_error("Batch creation response is missing the batch id");
+        }
+    }
+
+    // 3. Poll until the batch reaches a terminal state
+    string output_file_id;
+    string error_file_id;
+    auto batch_path = base + "/batches/" + batch_id;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(options.timeout_seconds);
+    while (true) {
+        string status;
+        {
+            auto client = pool.Acquire(endpoint);
+            auto res = RecordedCall(client, recorder, 0, [&](duckdb_httplib_openssl::Client &http) {
+                return http.Get(batch_path.c_str(), headers);
+            });
+            CheckResponse(client, res, "GET", "Batch status request");
+            auto doc = ParseJSON(res->body, "batch status");
+            auto root = duckdb_yyjson::yyjson_doc_get_root(doc.get());
+            status = GetStringField(root, "status");
+            output_file_id = GetStringField(root, "output_file_id");
+            error_file_id = GetStringField(root, "error_file_id");
+        }
+        if (status == "completed") {
+            break;
+        }
+        if (status == "failed" || status == "expired" || status == "cancelled") {
+            throw std::runtime_error("Batch " + batch_id + " ended with status " + status);
+        }
+        // Sleep in short slices, so that an interrupt cancels the batch right away instead of after a poll interval
+        auto poll_interval = std::chrono::seconds(options.poll_interval_seconds);
+        auto next_poll = MinValue(std::chrono::steady_clock::now() + poll_interval, deadline);
+        while (!context.interrupted && std::chrono::steady_clock::now() < next_poll) {
+            std::this_thread::sleep_for(MinValue<std::chrono::steady_clock::duration>(
+                std::chrono::milliseconds(POLL_SLICE_MS), next_poll - std::chrono::steady_clock::now()));
+        }
+        if (context.interrupted || std::chrono::steady_clock::now() >= deadline) {
+            auto client = pool.Acquire(endpoint);
+            RecordedCall(client, recorder, 0, [&](duckdb_httplib_openssl::Client &http) {
+                return http.Post((batch_path + "/cancel").c_str(), headers, string(), "application/json");
+            });
+            if (context.interrupted) {
+                throw InterruptException();
+            }
+            throw std::runtime_error("Batch " + batch_id + " did not complete within openprompt_batch_timeout");
+        }
+    }
+
+    // 4. Download the output and error files and map every line back to its request
+    OpenPromptResponse usage;
+    for (auto &file : {output_file_id, error_file_id}) {
+        if (file.empty()) {
+            continue;
+        }
+        auto client = pool.Acquire(endpoint);
+        auto res = RecordedCall(client, recorder, 0, [&](duckdb_httplib_openssl::Client &http) {
+            return http.Get((base + "/files/" + file + "/content").c_str(), headers);
+        });
+        CheckResponse(client, res, "GET", "Batch result download");
+        for (auto &line : StringUtil::Split(res->body, '\n')) {
+            yyjson_doc_ptr doc(duckdb_yyjson::yyjson_read(line.c_str(), line.size(), 0),
+                               &duckdb_yyjson::yyjson_doc_free);
+            if (!doc) {
+                continue;
+            }
+            auto root = duckdb_yyjson::yyjson_doc_get_root(doc.get());
+            auto custom_id = GetStringField(root, "custom_id");
+            if (!StringUtil::StartsWith(custom_id, "request-")) {
+                continue;
+            }
+            idx_t request_idx;
+            try {
+                request_idx = std::stoull(custom_id.substr(8));
+            } catch (std::exception &) {
+                continue;
+            }
+            if (request_idx >= results.size()) {
+                continue;
+            }
+            auto &result = results[request_idx];
+            try {
+                auto response = duckdb_yyjson::yyjson_obj_get(root, "response");
+                auto status_code = duckdb_yyjson::yyjson_get_int(duckdb_yyjson::yyjson_obj_get(response, "status_code"));
+                auto body = duckdb_yyjson::yyjson_obj_get(response, "body");
+                if (!response || status_code != 200 || !body) {
+                    auto error = duckdb_yyjson::yyjson_obj_get(root, "error");
+                    auto message = GetStringField(error, "message");
+                    if (message.empty()) {
+                        message = GetStringField(duckdb_yyjson::yyjson_obj_get(body, "error"), "message");
+                    }
+                    throw std::runtime_error("HTTP error " + std::to_string(status_code) + ": " + message);
+                }
+                result.response = ParseCompletionContent(body);
+                result.success = true;
+                OpenPromptResponse result_usage;
+                ParseCompletionUsage(body, result_usage);
+                result.tokens = result_usage.prompt_tokens + result_usage.completion_tokens;
+                usage.prompt_tokens += result_usage.prompt_tokens;
+                usage.completion_tokens += result_usage.completion_tokens;
+            } catch (std::exception &e) {
+                result.response = "Error: " + string(e.what());
+            }
+        }
+    }
+    recorder.RecordResponse(usage);
+    for (auto &result : results) {
+        if (!result.success && result.response.empty()) {
+            result.response = "Error: Missing result in batch " + batch_id;
+        }
+    }
+}
+
+void RenderMultiPromptBody(const string &model_name, const string &system_prompt,
+                           const vector<reference<const string>> &prompts, string &body) {
+    // Completions endpoints have no system role, the system prompt is prepended to every prompt
+    body = "{\"model\":";
+    AppendJSONString(body, model_name.c_str(), model_name.size());
+    body += ",\"prompt\":[";
+    for (idx_t i = 0; i < prompts.size(); i++) {
+        if (i > 0) {
+            body += ',';
+        }
+        auto &prompt = prompts[i].get();
+        if (system_prompt.empty()) {
+            AppendJSONString(body, prompt.c_str(), prompt.size());
+            continue;
+        }
+        body += '"';
+        AppendJSONEscaped(body, system_prompt.c_str(), system_prompt.size());
+        body += "\\n\\n";
+        AppendJSONEscaped(body, prompt.c_str(), prompt.size());
+        body += '"';
+    }
+    body += "]}";
+}
+
+void ParseMultiPromptResponse(OpenPromptResponse &response, idx_t count, vector<OpenPromptBatchResult> &results) {
+    results.assign(count, OpenPromptBatchResult());
+    auto doc = ParseJSON(response.content, "multi-prompt");
+    auto root = duckdb_yyjson::yyjson_doc_get_root(doc.get());
+    ParseCompletionUsage(root, response);
+    auto choices = duckdb_yyjson::yyjson_obj_get(root, "choices");
+    if (!choices || !duckdb_yyjson::yyjson_is_arr(choices)) {
+        throw std::runtime_error("Invalid response format: missing choices array");
+    }
+    duckdb_yyjson::yyjson_arr_iter iter;
+    duckdb_yyjson::yyjson_arr_iter_init(choices, &iter);
+    duckdb_yyjson::yyjson_val *choice;
+    for (idx_t idx = 0; (choice = duckdb_yyjson::yyjson_arr_iter_next(&iter)); idx++) {
+        // Choices carry the index of their prompt within the request, they may arrive out of order
+        auto index_val = duckdb_yyjson::yyjson_obj_get(choice, "index");
+        auto prompt_idx = index_val ? duckdb_yyjson::yyjson_get_uint(index_val) : idx;
+        if (prompt_idx >= count) {
+            continue;
+        }
+        auto &result = results[prompt_idx];
+        auto text = duckdb_yyjson::yyjson_obj_get(choice, "text");
+        if (!duckdb_yyjson::yyjson_is_str(text)) {
+            result.response = "Error: Invalid response format: choice is missing its text";
+            continue;
+        }
+        result.response.assign(duckdb_yyjson::yyjson_get_str(text), duckdb_yyjson::yyjson_get_len(text));
+        result.success = true;
+    }
+    for (auto &result : results) {
+        if (!result.success && result.response.empty()) {
+            result.response = "Error: Missing choice in multi-prompt response";
+        }
+    }
+}
+
+string PackedSystemPrompt(const string &system_prompt, idx_t count, bool structured) {
+    auto instruction =
+        structured
+            ? StringUtil::Format(
+                  "You will receive a JSON array of %d independent requests. Handle each request on its own, following "
+                  "the instructions above if any, and reply with only a JSON object whose \"answers\" array holds %d "
+                  "entries, where entry i is the answer to request i in the format of the response schema.",
+                  count, count)
+            : StringUtil::Format(
+                  "You will receive a JSON array of %d independent requests. Handle each request on its own, following "
+                  "the instructions above if any, and reply with only a JSON array of %d strings where entry i is the "
+                  "complete answer to request i.",
+                  count, count);
+    return system_prompt.empty() ? instruction : system_prompt + "\n\n" + instruction;
+}
+
+string PackedJSONSchema(const string &json_schema, idx_t count) {
+    // The {"name": ..., "schema": {...}} wrapper of the json_schema response format is unwrapped, as for
+    // open_prompt_struct, since only the schema itself can describe an array entry
+    string item_schema = json_schema;
+    yyjson_doc_ptr doc(duckdb_yyjson::yyjson_read(json_schema.c_str(), json_schema.size(), 0),
+                       &duckdb_yyjson::yyjson_doc_free);
+    auto root = doc ? duckdb_yyjson::yyjson_doc_get_root(doc.get()) : nullptr;
+    auto wrapped = duckdb_yyjson::yyjson_obj_get(root, "schema");
+    if (duckdb_yyjson::yyjson_is_obj(wrapped) && !duckdb_yyjson::yyjson_obj_get(root, "properties")) {
+        size_t len;
+        auto json = duckdb_yyjson::yyjson_val_write(wrapped, 0, &len);
+        if (json) {
+            item_schema.assign(json, len);
+            free(json);
+        }
+    }
+    return StringUtil::Format("{\"type\":\"object\",\"properties\":{\"answers\":{\"type\":\"array\",\"minItems\":%d,"
+                              "\"maxItems\":%d,\"items\":%s}},\"required\":[\"answers\"]}",
+                              count, count, item_schema);
+}
+
+string RenderPackedPrompt(const vector<reference<const string>> &prompts) {
+    string result = "[";
+    for (idx_t i = 0; i < prompts.size(); i++) {
+        if (i > 0) {
+            result += ",\n";
+        }
+        auto &prompt = prompts[i].get();
+        AppendJSONString(result, prompt.c_str(), prompt.size());
+    }
+    result += "]";
+    return result;
+}
+
+bool ParsePackedAnswers(const string &content, idx_t count, vector<string> &answers) {
+    // A structured response is an object holding the array, see PackedJSONSchema
+    yyjson_doc_ptr doc(duckdb_yyjson::yyjson_read(content.c_str(), content.size(), 0),
+                       &duckdb_yyjson::yyjson_doc_free);
+    auto root = doc ? duckdb_yyjson::yyjson_doc_get_root(doc.get()) : nullptr;
+    if (duckdb_yyjson::yyjson_is_obj(root)) {
+        root = duckdb_yyjson::yyjson_obj_get(root, "answers");
+    } else if (!duckdb_yyjson::yyjson_is_arr(root)) {
+        // Models like to wrap the array in a code fence or a sentence, only the outermost brackets are parsed
+        auto begin = content.find('[');
+        auto end = content.rfind(']');
+        if (begin == string::npos || end == string::npos || end < begin) {
+            return false;
+        }
+        doc.reset(duckdb_yyjson::yyjson_read(content.c_str() + begin, end - begin + 1, 0));
+        root = doc ? duckdb_yyjson::yyjson_doc_get_root(doc.get()) : nullptr;
+    }
+    if (!duckdb_yyjson::yyjson_is_arr(root) || duckdb_yyjson::yyjson_arr_size(root) != count) {
+        return false;
+    }
+    answers.clear();
+    answers.reserve(count);
+    duckdb_yyjson::yyjson_arr_iter iter;
+    duckdb_yyjson::yyjson_arr_iter_init(root, &iter);
+    duckdb_yyjson::yyjson_val *entry;
+    while ((entry = duckdb_yyjson::yyjson_arr_iter_next(&iter))) {
+        if (duckdb_yyjson::yyjson_is_str(entry)) {
+            answers.emplace_back(duckdb_yyjson::yyjson_get_str(entry), duckdb_yyjson::yyjson_get_len(entry));
+            continue;
+        }
+        if (duckdb_yyjson::yyjson_is_null(entry)) {
+            return false;
+        }
+        // An object or number answer is kept as its JSON text
+        size_t len;
+        auto json = duckdb_yyjson::yyjson_val_write(entry, 0, &len);
+        if (!json) {
+            return false;
+        }
+        answers.emplace_back(json, len);
+        free(json);
+    }
+    return true;
+}
+
+} // namespace duckdb
@@ -0,0 +1,116 @@
+#include "open_prompt_cache_match.hpp"
+#include "open_prompt_request.hpp"
+#include "open_prompt_settings.hpp"
+#include "prompt_response_cache.hpp"
+#include "prompt_similarity_index.hpp"
+
+#include "duckdb/common/types/hash.hpp"
+#include "re2/re2.h"
+
+#include <cmath>
+
+namespace duckdb {
+
+OpenPromptCacheMatcher::OpenPromptCacheMatcher() {
+}
+
+OpenPromptCacheMatcher::~OpenPromptCacheMatcher() {
+}
+
+void OpenPromptCacheMatcher::Configure(ClientContext &context) {
+    normalize = OpenPromptSettings::GetBoolean(context, "openprompt_cache_normalize", false);
+    strip_patterns.clear();
+    for (auto &pattern : OpenPromptSettings::GetStringList(context, "openprompt_cache_strip_patterns")) {
+        duckdb_re2::RE2::Options options;
+        options.set_log_errors(false);
+        auto regex = make_uniq<duckdb_re2::RE2>(pattern, options);
+        if (!regex->ok()) {
+            throw InvalidInputException("Invalid openprompt_cache_strip_patterns entry \"%s\": %s", pattern,
+                                        regex->error());
+        }
+        strip_patterns.push_back(std::move(regex));
+    }
+    // A similarity of s tolerates (1 - s) of the 64 fingerprint bits to differ, as far as the band index can find
+    auto similarity = OpenPromptSettings::GetDouble(context, "openprompt_cache_similarity", 0);
+    if (similarity <= 0) {
+        max_distance = -1;
+    } else {
+        auto distance = std::floor((1 - MinValue(similarity, 1.0)) * 64);
+        max_distance = MinValue<int64_t>(static_cast<int64_t>(distance), PromptSimilarityIndex::MAX_DISTANCE);
+    }
+}
+
+static bool IsSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+string OpenPromptCacheMatcher::Normalize(const string &prompt) const {
+    if (!Normalizes()) {
+        return prompt;
+    }
+    string stripped = prompt;
+    for (auto &pattern : strip_patterns) {
+        duckdb_re2::RE2::GlobalReplace(&stripped, *pattern, "");
+    }
+    if (!normalize) {
+        return stripped;
+    }
+    // Runs of whitespace fold into one space, leading and trailing whitespace is dropped
+    string result;
+    result.reserve(stripped.size());
+    bool pending_space = false;
+    for (auto c : stripped) {
+        if (IsSpace(c)) {
+            pending_space = !result.empty();
+            continue;
+        }
+        if (pending_space) {
+            result += ' ';
+            pending_space = false;
+        }
+        result += c >= 'A' && c <= 'Z' ? static_cast<char>(c + ('a' - 'A')) : c;
+    }
+    return result;
+}
+
+//! Position of the user message content in a request body, npos when it is not found. The user message comes
+//! last, after the model, schema and system prompt
+static idx_t FindPrompt(const string &body, const string &prompt, string &escaped_prompt) {
+    AppendJSONEscaped(escaped_prompt, prompt.c_str(), prompt.size());
+    return escaped_prompt.empty() ? string::npos : body.rfind(escaped_prompt);
+}
+
+string OpenPromptCacheMatcher::Key(const string &api_url, const string &body, const string &prompt) const {
+    if (!Normalizes() || prompt.empty()) {
+        return PromptResponseCache::ComputeKey(api_url, body);
+    }
+    string escaped_prompt;
+    auto position = FindPrompt(body, prompt, escaped_prompt);
+    if (position == string::npos) {
+        return PromptResponseCache::ComputeKey(api_url, body);
+    }
+    // Only the user message is normalized, the model, schema and system prompt have to match exactly
+    auto normalized = Normalize(prompt);
+    string key_body = body.substr(0, position);
+    AppendJSONEscaped(key_body, normalized.c_str(), normalized.size());
+    key_body.append(body, position + escaped_prompt.size(), string::npos);
+    return PromptResponseCache::ComputeKey(api_url, key_body);
+}
+
+uint64_t OpenPromptCacheMatcher::Context(const string &api_url, const string &body, const string &prompt) const {
+    string escaped_prompt;
+    auto position = FindPrompt(body, prompt, escaped_prompt);
+    auto url_hash = Hash(api_url.c_str(), api_url.size());
+    if (position == string::npos) {
+        return CombineHash(url_hash, Hash(body.c_str(), body.size()));
+    }
+    auto suffix_start = position + escaped_prompt.size();
+    return CombineHash(CombineHash(url_hash, Hash(body.c_str(), position)),
+                       Hash(body.c_str() + suffix_start, body.size() - suffix_start));
+}
+
+uint64_t OpenPromptCacheMatcher::Fingerprint(const string &prompt) const {
+    return PromptSimilarityIndex::Fingerprint(Normalize(prompt));
+}
+
+} // namespace duckdb
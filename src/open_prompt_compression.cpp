@@ -0,0 +1,268 @@
+#include "open_prompt_compression.hpp"
+
+#include "duckdb/common/string_util.hpp"
+#include "miniz.hpp"
+#include "zstd.h"
+
+namespace duckdb {
+
+OpenPromptCompression ParseCompression(const string &name) {
+    auto lname = StringUtil::Lower(name);
+    if (lname.empty() || lname == "none") {
+        return OpenPromptCompression::NONE;
+    } else if (lname == "gzip") {
+        return OpenPromptCompression::GZIP;
+    } else if (lname == "zstd") {
+        return OpenPromptCompression::ZSTD;
+    }
+    throw InvalidInputException("Unsupported openprompt_compression \"%s\", expected none, gzip or zstd", name);
+}
+
+const char *CompressionEncoding(OpenPromptCompression compression) {
+    return compression == OpenPromptCompression::ZSTD ? "zstd" : "gzip";
+}
+
+const char *AcceptedEncodings() {
+    return "zstd, gzip";
+}
+
+static constexpr idx_t GZIP_HEADER_SIZE = 10;
+static constexpr idx_t GZIP_FOOTER_SIZE = 8;
+//! Deflate, no flags, no modification time, unknown OS
+static constexpr uint8_t GZIP_HEADER[GZIP_HEADER_SIZE] = {0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 0xff};
+static constexpr uint8_t GZIP_FLAG_HCRC = 0x02;
+static constexpr uint8_t GZIP_FLAG_EXTRA = 0x04;
+static constexpr uint8_t GZIP_FLAG_NAME = 0x08;
+static constexpr uint8_t GZIP_FLAG_COMMENT = 0x10;
+
+//! Codec state of one thread, allocated on first use
+struct OpenPromptCodecContexts {
+    ~OpenPromptCodecContexts() {
+        if (deflate_level >= 0) {
+            duckdb_miniz::mz_deflateEnd(&deflate_stream);
+        }
+        duckdb_zstd::ZSTD_freeCCtx(zstd_compress);
+        duckdb_zstd::ZSTD_freeDCtx(zstd_decompress);
+    }
+
+    duckdb_miniz::mz_stream deflate_stream;
+    //! Level `deflate_stream` was initialized with, -1 before the first use
+    int deflate_level = -1;
+    duckdb_zstd::ZSTD_CCtx *zstd_compress = nullptr;
+    duckdb_zstd::ZSTD_DCtx *zstd_decompress = nullptr;
+
+    static OpenPromptCodecContexts &Get() {
+        thread_local OpenPromptCodecContexts contexts;
+        return contexts;
+    }
+};
+
+//! The decoded size a response announces is only trusted up to this multiple of its compressed size, the buffer
+//! grows from there when the announcement was honest
+static constexpr idx_t MAX_SIZE_HINT_RATIO = 16;
+
+//! Initial size of a decoding buffer, from a size announced by the server
+static idx_t DecodeBufferSize(idx_t announced_size, idx_t compressed_size) {
+    auto limit = MinValue<idx_t>(compressed_size * MAX_SIZE_HINT_RATIO + 4096, MAX_DECOMPRESSED_BODY_SIZE);
+    return MaxValue<idx_t>(MinValue(announced_size, limit), 1);
+}
+
+//! Double a decoding buffer, up to MAX_DECOMPRESSED_BODY_SIZE
+static void GrowDecodeBuffer(string &out) {
+    if (out.size() >= MAX_DECOMPRESSED_BODY_SIZE) {
+        throw IOException("Decompressed response body exceeds %llu bytes", MAX_DECOMPRESSED_BODY_SIZE);
+    }
+    out.resize(MinValue<idx_t>(out.size() * 2, MAX_DECOMPRESSED_BODY_SIZE));
+}
+
+static void StoreLE32(uint32_t value, char *target) {
+    for (idx_t i = 0; i < 4; i++) {
+        target[i] = static_cast<char>((value >> (8 * i)) & 0xff);
+    }
+}
+
+static uint32_t LoadLE32(const uint8_t *source) {
+    return uint32_t(source[0]) | uint32_t(source[1]) << 8 | uint32_t(source[2]) << 16 | uint32_t(source[3]) << 24;
+}
+
+static void GzipCompress(OpenPromptCodecContexts &contexts, int level, const string &input, string &out) {
+    level = MinValue(MaxValue(level, 1), 9);
+    auto &stream = contexts.deflate_stream;
+    if (contexts.deflate_level != level) {
+        if (contexts.deflate_level >= 0) {
+            duckdb_miniz::mz_deflateEnd(&stream);
+            contexts.deflate_level = -1;
+        }
+        memset(&stream, 0, sizeof(stream));
+        if (duckdb_miniz::mz_deflateInit2(&stream, level, MZ_DEFLATED, -MZ_DEFAULT_WINDOW_BITS, 8,
+                                          duckdb_miniz::MZ_DEFAULT_STRATEGY) != duckdb_miniz::MZ_OK) {
+            throw IOException("Failed to initialize gzip compression");
+        }
+        contexts.deflate_level = level;
+    } else {
+        duckdb_miniz::mz_deflateReset(&stream);
+    }
+    auto bound = duckdb_miniz::mz_deflateBound(&stream, input.size());
+    out.resize(GZIP_HEADER_SIZE + bound + GZIP_FOOTER_SIZE);
+    memcpy(&out[0], GZIP_HEADER, GZIP_HEADER_SIZE);
+    stream.next_in = reinterpret_cast<const unsigned char *>(input.data());
+    stream.avail_in = input.size();
+    stream.next_out = reinterpret_cast<unsigned char *>(&out[GZIP_HEADER_SIZE]);
+    stream.avail_out = bound;
+    if (duckdb_miniz::mz_deflate(&stream, duckdb_miniz::MZ_FINISH) != duckdb_miniz::MZ_STREAM_END) {
+        throw IOException("Failed to gzip the request body");
+    }
+    auto size = GZIP_HEADER_SIZE + stream.total_out;
+    auto crc = duckdb_miniz::mz_crc32(MZ_CRC32_INIT, reinterpret_cast<const unsigned char *>(input.data()),
+                                      input.size());
+    StoreLE32(static_cast<uint32_t>(crc), &out[size]);
+    StoreLE32(static_cast<uint32_t>(input.size()), &out[size + 4]);
+    out.resize(size + GZIP_FOOTER_SIZE);
+}
+
+static void GzipDecompress(const string &body, string &out) {
+    auto data = reinterpret_cast<const uint8_t *>(body.data());
+    auto size = body.size();
+    if (size < GZIP_HEADER_SIZE + GZIP_FOOTER_SIZE || data[0] != 0x1f || data[1] != 0x8b || data[2] != 8) {
+        throw IOException("Invalid gzip response body");
+    }
+    auto flags = data[3];
+    idx_t offset = GZIP_HEADER_SIZE;
+    if (flags & GZIP_FLAG_EXTRA) {
+        offset += 2 + (data[offset] | data[offset + 1] << 8);
+    }
+    for (auto flag : {GZIP_FLAG_NAME, GZIP_FLAG_COMMENT}) {
+        if (flags & flag) {
+            while (offset < size && data[offset] != 0) {
+                offset++;
+            }
+            offset++;
+        }
+    }
+    if (flags & GZIP_FLAG_HCRC) {
+        offset += 2;
+    }
+    if (offset + GZIP_FOOTER_SIZE > size) {
+        throw IOException("Invalid gzip response body");
+    }
+    auto expected_crc = LoadLE32(data + size - 8);
+    // The uncompressed size modulo 2^32, exact for any realistic response
+    auto expected_size = LoadLE32(data + size - 4);
+
+    duckdb_miniz::mz_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (duckdb_miniz::mz_inflateInit2(&stream, -MZ_DEFAULT_WINDOW_BITS) != duckdb_miniz::MZ_OK) {
+        throw IOException("Failed to initialize gzip decompression");
+    }
+    out.resize(DecodeBufferSize(expected_size, size));
+    stream.next_in = data + offset;
+    stream.avail_in = size - GZIP_FOOTER_SIZE - offset;
+    while (true) {
+        stream.next_out = reinterpret_cast<unsigned char *>(&out[stream.total_out]);
+        stream.avail_out = out.size() - stream.total_out;
+        auto status = duckdb_miniz::mz_inflate(&stream, duckdb_miniz::MZ_NO_FLUSH);
+        if (status == duckdb_miniz::MZ_STREAM_END) {
+            break;
+        }
+        if (stream.avail_out == 0) {
+            try {
+                GrowDecodeBuffer(out);
+            } catch (...) {
+                duckdb_miniz::mz_inflateEnd(&stream);
+                throw;
+            }
+            continue;
+        }
+        if (status != duckdb_miniz::MZ_OK || stream.avail_in == 0) {
+            duckdb_miniz::mz_inflateEnd(&stream);
+            throw IOException("Corrupt or truncated gzip response body");
+        }
+    }
+    out.resize(stream.total_out);
+    duckdb_miniz::mz_inflateEnd(&stream);
+    auto crc = duckdb_miniz::mz_crc32(MZ_CRC32_INIT, reinterpret_cast<const unsigned char *>(out.data()),
+                                      out.size());
+    if (static_cast<uint32_t>(crc) != expected_crc || static_cast<uint32_t>(out.size()) != expected_size) {
+        throw IOException("Checksum mismatch in gzip response body");
+    }
+}
+
+static void ZstdCompress(OpenPromptCodecContexts &contexts, int level, const string &input, string &out) {
+    if (!contexts.zstd_compress) {
+        contexts.zstd_compress = duckdb_zstd::ZSTD_createCCtx();
+    }
+    out.resize(duckdb_zstd::ZSTD_compressBound(input.size()));
+    auto size = duckdb_zstd::ZSTD_compressCCtx(contexts.zstd_compress, &out[0], out.size(), input.data(),
+                                               input.size(), level);
+    if (duckdb_zstd::ZSTD_isError(size)) {
+        throw IOException("Failed to zstd compress the request body: %s", duckdb_zstd::ZSTD_getErrorName(size));
+    }
+    out.resize(size);
+}
+
+static void ZstdDecompress(OpenPromptCodecContexts &contexts, const string &body, string &out) {
+    if (!contexts.zstd_decompress) {
+        contexts.zstd_decompress = duckdb_zstd::ZSTD_createDCtx();
+    } else {
+        duckdb_zstd::ZSTD_DCtx_reset(contexts.zstd_decompress, duckdb_zstd::ZSTD_reset_session_only);
+    }
+    // Servers usually write the content size into the frame header, otherwise the buffer grows as needed
+    auto content_size = duckdb_zstd::ZSTD_getFrameContentSize(body.data(), body.size());
+    bool known_size = content_size != ZSTD_CONTENTSIZE_UNKNOWN && content_size != ZSTD_CONTENTSIZE_ERROR;
+    out.resize(DecodeBufferSize(known_size ? content_size : body.size() * 4, body.size()));
+    duckdb_zstd::ZSTD_inBuffer input {body.data(), body.size(), 0};
+    duckdb_zstd::ZSTD_outBuffer output {&out[0], out.size(), 0};
+    while (true) {
+        auto remaining = duckdb_zstd::ZSTD_decompressStream(contexts.zstd_decompress, &output, &input);
+        if (duckdb_zstd::ZSTD_isError(remaining)) {
+            throw IOException("Corrupt zstd response body: %s", duckdb_zstd::ZSTD_getErrorName(remaining));
+        }
+        if (remaining == 0 && input.pos == input.size) {
+            break;
+        }
+        if (output.pos == output.size) {
+            GrowDecodeBuffer(out);
+            output.dst = &out[0];
+            output.size = out.size();
+            continue;
+        }
+        if (input.pos == input.size) {
+            throw IOException("Truncated zstd response body");
+        }
+    }
+    out.resize(output.pos);
+}
+
+void CompressBody(OpenPromptCompression compression, int level, const string &input, string &out) {
+    auto &contexts = OpenPromptCodecContexts::Get();
+    switch (compression) {
+    case OpenPromptCompression::GZIP:
+        GzipCompress(contexts, level, input, out);
+        break;
+    case OpenPromptCompression::ZSTD:
+        ZstdCompress(contexts, level, input, out);
+        break;
+    default:
+        out = input;
+        break;
+    }
+}
+
+void DecompressBody(const string &encoding, string &body) {
+    auto lencoding = StringUtil::Lower(encoding);
+    StringUtil::Trim(lencoding);
+    if (lencoding.empty() || lencoding == "identity") {
+        return;
+    }
+    string decoded;
+    if (lencoding == "gzip" || lencoding == "x-gzip") {
+        GzipDecompress(body, decoded);
+    } else if (lencoding == "zstd") {
+        ZstdDecompress(OpenPromptCodecContexts::Get(), body, decoded);
+    } else {
+        throw IOException("Unsupported Content-Encoding \"%s\" in response", encoding);
+    }
+    body = std::move(decoded);
+}
+
+} // namespace duckdb
@@ -0,0 +1,321 @@
+#include "open_prompt_embed.hpp"
+#include "open_prompt_sender.hpp"
+#include "open_prompt_settings.hpp"
+
+#include "duckdb/common/exception/binder_exception.hpp"
+#include "duckdb/common/string_map_set.hpp"
+#include "duckdb/common/string_util.hpp"
+#include "duckdb/execution/expression_executor.hpp"
+#include "duckdb/planner/expression/bound_function_expression.hpp"
+#include "duckdb/storage/object_cache.hpp"
+#include "yyjson.hpp"
+
+namespace duckdb {
+
+struct OpenEmbedData : public FunctionData {
+    string api_url;
+    string api_token;
+    string model_name;
+    //! Size of the FLOAT[N] result
+    idx_t dimensions = 0;
+    //! The dimensions were given explicitly and are sent with every request
+    bool send_dimensions = false;
+
+    unique_ptr<FunctionData> Copy() const override {
+        return make_uniq<OpenEmbedData>(*this);
+    }
+    bool Equals(const FunctionData &other_p) const override {
+        auto &other = other_p.Cast<OpenEmbedData>();
+        return api_url == other.api_url && api_token == other.api_token && model_name == other.model_name &&
+               dimensions == other.dimensions && send_dimensions == other.send_dimensions;
+    }
+};
+
+//! Render an embeddings request for `inputs`
+static void RenderEmbeddingRequest(const OpenEmbedData &info, const vector<string_t> &inputs, string &out) {
+    out.clear();
+    out += "{\"model\":";
+    AppendJSONString(out, info.model_name.c_str(), info.model_name.size());
+    if (info.send_dimensions) {
+        out += ",\"dimensions\":";
+        out += std::to_string(info.dimensions);
+    }
+    out += ",\"encoding_format\":\"float\",\"input\":[";
+    for (idx_t i = 0; i < inputs.size(); i++) {
+        if (i > 0) {
+            out += ',';
+        }
+        AppendJSONString(out, inputs[i].GetData(), inputs[i].GetSize());
+    }
+    out += "]}";
+}
+
+//! Calls `callback(index, embedding)` for every entry of an embeddings response, throws when it is malformed.
+//! The body is parsed in place
+template <class FUNC>
+static void ParseEmbeddingResponse(string &body, idx_t input_count, OpenPromptResponse &usage, FUNC &&callback) {
+    unique_ptr<duckdb_yyjson::yyjson_doc, void (*)(duckdb_yyjson::yyjson_doc *)> doc(
+        ReadJSONInsitu(body), &duckdb_yyjson::yyjson_doc_free);
+    if (!doc) {
+        throw std::runtime_error("Failed to parse embeddings response");
+    }
+    auto root = duckdb_yyjson::yyjson_doc_get_root(doc.get());
+    auto data = duckdb_yyjson::yyjson_obj_get(root, "data");
+    if (!duckdb_yyjson::yyjson_is_arr(data)) {
+        throw std::runtime_error("Invalid embeddings response: missing data array");
+    }
+    ParseCompletionUsage(root, usage);
+    duckdb_yyjson::yyjson_arr_iter iter;
+    duckdb_yyjson::yyjson_arr_iter_init(data, &iter);
+    duckdb_yyjson::yyjson_val *entry;
+    idx_t position = 0;
+    while ((entry = duckdb_yyjson::yyjson_arr_iter_next(&iter))) {
+        // Entries carry their input index, fall back to their position when it is missing
+        auto index_val = duckdb_yyjson::yyjson_obj_get(entry, "index");
+        idx_t index = duckdb_yyjson::yyjson_is_uint(index_val) ? duckdb_yyjson::yyjson_get_uint(index_val) : position;
+        position++;
+        auto embedding = duckdb_yyjson::yyjson_obj_get(entry, "embedding");
+        if (index >= input_count || !duckdb_yyjson::yyjson_is_arr(embedding)) {
+            throw std::runtime_error("Invalid embeddings response: malformed data entry");
+        }
+        callback(index, embedding);
+    }
+}
+
+//! Write an embedding into `target`, which holds `dimensions` floats. Returns false when the sizes differ
+static bool WriteEmbedding(duckdb_yyjson::yyjson_val *embedding, idx_t dimensions, float *target) {
+    if (duckdb_yyjson::yyjson_arr_size(embedding) != dimensions) {
+        return false;
+    }
+    duckdb_yyjson::yyjson_arr_iter iter;
+    duckdb_yyjson::yyjson_arr_iter_init(embedding, &iter);
+    duckdb_yyjson::yyjson_val *element;
+    idx_t i = 0;
+    while ((element = duckdb_yyjson::yyjson_arr_iter_next(&iter))) {
+        target[i++] = static_cast<float>(duckdb_yyjson::yyjson_get_num(element));
+    }
+    return true;
+}
+
+static string GetEmbeddingURL(ClientContext &context) {
+    auto url = OpenPromptSettings::GetVariable(context, "openprompt_embedding_url", "");
+    if (!url.empty()) {
+        return url;
+    }
+    // Derived from the chat completions URL(s), e.g. http://localhost:11434/v1/embeddings
+    auto api_url = OpenPromptSettings::GetVariable(context, "openprompt_api_url",
+                                                   "http://localhost:11434/v1/chat/completions");
+    const string suffix = "/chat/completions";
+    auto specs = OpenPromptEndpointSet::ParseList(api_url);
+    for (auto &spec : specs) {
+        if (!StringUtil::EndsWith(spec.url, suffix)) {
+            throw BinderException("open_embed: cannot derive the embeddings URL from \"%s\", set it with "
+                                  "SET VARIABLE openprompt_embedding_url", spec.url);
+        }
+        spec.url = spec.url.substr(0, spec.url.size() - suffix.size()) + "/embeddings";
+    }
+    return OpenPromptEndpointSet::FormatList(specs);
+}
+
+//! Without explicit dimensions a single probe request tells the size of the model's embeddings
+static idx_t ProbeEmbeddingDimensions(ClientContext &context, const OpenEmbedData &info) {
+    OpenPromptSender sender(context, info.api_url, info.api_token);
+    string body;
+    RenderEmbeddingRequest(info, {string_t("dimension probe")}, body);
+    idx_t dimensions = 0;
+    try {
+        auto response = sender.SendOne(body, true);
+        ParseEmbeddingResponse(response.content, 1, response, [&](idx_t, duckdb_yyjson::yyjson_val *embedding) {
+            dimensions = duckdb_yyjson::yyjson_arr_size(embedding);
+        });
+    } catch (std::exception &e) {
+        throw BinderException("open_embed: failed to determine the embedding dimensions of model \"%s\" (%s), "
+                              "pass them with dimensions := N", info.model_name, e.what());
+    }
+    if (dimensions == 0 || dimensions > ArrayType::MAX_ARRAY_SIZE) {
+        throw BinderException("open_embed: model \"%s\" returned an embedding of %llu dimensions", info.model_name,
+                              dimensions);
+    }
+    return dimensions;
+}
+
+//! The embedding size a model returned to a probe, kept per embeddings URL and model so that binding open_embed only
+//! sends a probe the first time
+class OpenEmbedDimensions : public ObjectCacheEntry {
+public:
+    static string ObjectType() {
+        return "open_embed_dimensions";
+    }
+    string GetObjectType() override {
+        return ObjectType();
+    }
+
+    //! 0 until the first probe succeeded
+    atomic<idx_t> dimensions {0};
+};
+
+static idx_t GetEmbeddingDimensions(ClientContext &context, const OpenEmbedData &info) {
+    auto dimensions = OpenPromptSettings::GetUBigInt(context, "openprompt_embedding_dimensions", 0);
+    if (dimensions > ArrayType::MAX_ARRAY_SIZE) {
+        throw BinderException("open_embed: openprompt_embedding_dimensions must be at most %llu",
+                              ArrayType::MAX_ARRAY_SIZE);
+    }
+    if (dimensions > 0) {
+        return dimensions;
+    }
+    auto &cache = ObjectCache::GetObjectCache(context);
+    auto probed = cache.GetOrCreate<OpenEmbedDimensions>(OpenEmbedDimensions::ObjectType() + ":" + info.api_url +
+                                                         "\n" + info.model_name);
+    dimensions = probed->dimensions;
+    if (dimensions == 0) {
+        dimensions = ProbeEmbeddingDimensions(context, info);
+        probed->dimensions = dimensions;
+    }
+    return dimensions;
+}
+
+static unique_ptr<FunctionData> OpenEmbedBind(ClientContext &context, ScalarFunction &bound_function,
+                                              vector<unique_ptr<Expression>> &arguments) {
+    auto res = make_uniq<OpenEmbedData>();
+    res->api_url = GetEmbeddingURL(context);
+    res->api_token = OpenPromptSettings::GetVariable(context, "openprompt_api_token", "");
+    res->model_name = OpenPromptSettings::GetVariable(context, "openprompt_embedding_model", "nomic-embed-text");
+    for (idx_t i = 1; i < arguments.size(); ++i) {
+        auto &argument = *arguments[i];
+        // Every request packs many rows, so the options have to be the same for all of them
+        if (!argument.IsFoldable()) {
+            throw BinderException("open_embed: the model and dimensions arguments must be constant");
+        }
+        auto value = ExpressionExecutor::EvaluateScalar(context, argument);
+        if (value.IsNull()) {
+            continue;
+        }
+        if (argument.alias == "dimensions" || argument.return_type.IsIntegral()) {
+            auto dimensions = value.GetValue<int64_t>();
+            if (dimensions <= 0 || static_cast<idx_t>(dimensions) > ArrayType::MAX_ARRAY_SIZE) {
+                throw BinderException("open_embed: dimensions must be between 1 and %llu",
+                                      ArrayType::MAX_ARRAY_SIZE);
+            }
+            res->dimensions = static_cast<idx_t>(dimensions);
+            res->send_dimensions = true;
+        } else {
+            res->model_name = value.ToString();
+        }
+    }
+    if (!res->send_dimensions) {
+        res->dimensions = GetEmbeddingDimensions(context, *res);
+    }
+    bound_function.return_type = LogicalType::ARRAY(LogicalType::FLOAT, res->dimensions);
+    return std::move(res);
+}
+
+static void OpenEmbedFunction(DataChunk &args, ExpressionState &state, Vector &result) {
+    auto &func_expr = state.expr.Cast<BoundFunctionExpression>();
+    auto &info = func_expr.bind_info->Cast<OpenEmbedData>();
+    auto &context = state.GetContext();
+    idx_t count = args.size();
+
+    UnifiedVectorFormat text_data;
+    args.data[0].ToUnifiedFormat(count, text_data);
+    auto text_entries = UnifiedVectorFormat::GetData<string_t>(text_data);
+
+    result.SetVectorType(VectorType::FLAT_VECTOR);
+    auto &child = ArrayVector::GetEntry(result);
+    auto child_data = FlatVector::GetData<float>(child);
+
+    OpenPromptSender sender(context, info.api_url, info.api_token);
+
+    // Identical texts are only embedded once, the first row holding a text is the one written
+    vector<string_t> inputs;
+    vector<idx_t> input_rows;
+    vector<idx_t> row_inputs(count, DConstants::INVALID_INDEX);
+    string_map_t<idx_t> input_lookup;
+    for (idx_t i = 0; i < count; i++) {
+        auto text_idx = text_data.sel->get_index(i);
+        if (!text_data.validity.RowIsValid(text_idx)) {
+            FlatVector::SetNull(result, i, true);
+            continue;
+        }
+        auto &text = text_entries[text_idx];
+        auto lookup = input_lookup.find(text);
+        if (lookup != input_lookup.end()) {
+            row_inputs[i] = lookup->second;
+            sender.Metrics().RecordDeduplicated();
+            continue;
+        }
+        input_lookup.emplace(text, inputs.size());
+        row_inputs[i] = inputs.size();
+        inputs.push_back(text);
+        input_rows.push_back(i);
+    }
+
+    // Pack the inputs into requests, sent concurrently. Each request writes a disjoint set of rows
+    auto batch_size = MaxValue<idx_t>(OpenPromptSettings::GetUBigInt(context, "openprompt_embedding_batch_size",
+                                                                      256), 1);
+    idx_t batch_count = (inputs.size() + batch_size - 1) / batch_size;
+    // Written concurrently by the request workers, so not a bit-packed vector<bool>
+    vector<uint8_t> input_success(inputs.size(), false);
+    atomic<idx_t> mismatched_dimensions {0};
+    sender.RunConcurrently(batch_count, [&](idx_t batch_idx) {
+        auto batch_start = batch_idx * batch_size;
+        auto batch_end = MinValue<idx_t>(batch_start + batch_size, inputs.size());
+        vector<string_t> batch_inputs(inputs.begin() + batch_start, inputs.begin() + batch_end);
+        try {
+            string body;
+            RenderEmbeddingRequest(info, batch_inputs, body);
+            auto response = sender.SendOne(body, true);
+            ParseEmbeddingResponse(response.content, batch_inputs.size(), response,
+                                   [&](idx_t index, duckdb_yyjson::yyjson_val *embedding) {
+                                       auto input_idx = batch_start + index;
+                                       if (!WriteEmbedding(embedding, info.dimensions,
+                                                           child_data + input_rows[input_idx] * info.dimensions)) {
+                                           mismatched_dimensions = duckdb_yyjson::yyjson_arr_size(embedding);
+                                           return;
+                                       }
+                                       input_success[input_idx] = true;
+                                   });
+            sender.Metrics().RecordResponse(response);
+        } catch (std::exception &) {
+            // The rows of a failed request are NULL, like the rows of open_prompt_struct
+            sender.Metrics().RecordError();
+        }
+    });
+    if (mismatched_dimensions != 0) {
+        // A configuration error rather than a failed request, every row would be affected
+        throw InvalidInputException("open_embed: expected embeddings of %llu dimensions but received %llu",
+                                    info.dimensions, mismatched_dimensions.load());
+    }
+
+    // Failed inputs are NULL, duplicates copy the embedding of the first row with the same text
+    for (idx_t i = 0; i < count; i++) {
+        auto input_idx = row_inputs[i];
+        if (input_idx == DConstants::INVALID_INDEX) {
+            continue;
+        }
+        if (!input_success[input_idx]) {
+            FlatVector::SetNull(result, i, true);
+            continue;
+        }
+        auto source_row = input_rows[input_idx];
+        if (source_row != i) {
+            memcpy(child_data + i * info.dimensions, child_data + source_row * info.dimensions,
+                   info.dimensions * sizeof(float));
+        }
+    }
+}
+
+ScalarFunctionSet GetOpenEmbedFunction() {
+    ScalarFunctionSet open_embed("open_embed");
+    // The array size is only known at bind time, from the dimensions argument or a probe request
+    open_embed.AddFunction(ScalarFunction({LogicalType::VARCHAR}, LogicalType::ANY, OpenEmbedFunction,
+                                          OpenEmbedBind));
+    open_embed.AddFunction(ScalarFunction({LogicalType::VARCHAR, LogicalType::VARCHAR}, LogicalType::ANY,
+                                          OpenEmbedFunction, OpenEmbedBind));
+    open_embed.AddFunction(ScalarFunction({LogicalType::VARCHAR, LogicalType::BIGINT}, LogicalType::ANY,
+                                          OpenEmbedFunction, OpenEmbedBind));
+    open_embed.AddFunction(ScalarFunction({LogicalType::VARCHAR, LogicalType::VARCHAR, LogicalType::BIGINT},
+                                          LogicalType::ANY, OpenEmbedFunction, OpenEmbedBind));
+    return open_embed;
+}
+
+} // namespace duckdb
@@ -0,0 +1,158 @@
+#include "open_prompt_endpoints.hpp"
+
+#include "duckdb/common/string_util.hpp"
+
+namespace duckdb {
+
+vector<OpenPromptEndpointSpec> OpenPromptEndpointSet::ParseList(const string &url_list) {
+    vector<OpenPromptEndpointSpec> specs;
+    for (auto &entry : StringUtil::Split(url_list, ',')) {
+        auto parts = StringUtil::Split(entry, ';');
+        OpenPromptEndpointSpec spec;
+        spec.url = parts.empty() ? string() : parts[0];
+        StringUtil::Trim(spec.url);
+        if (spec.url.empty()) {
+            continue;
+        }
+        for (idx_t i = 1; i < parts.size(); i++) {
+            auto option = parts[i];
+            StringUtil::Trim(option);
+            if (!StringUtil::StartsWith(option, "weight=")) {
+                throw InvalidInputException("Unknown option \"%s\" of endpoint \"%s\"", option, spec.url);
+            }
+            char *end;
+            auto weight_str = option.substr(7);
+            spec.weight = std::strtod(weight_str.c_str(), &end);
+            if (end == weight_str.c_str() || spec.weight <= 0) {
+                throw InvalidInputException("Invalid weight \"%s\" of endpoint \"%s\"", weight_str, spec.url);
+            }
+        }
+        specs.push_back(std::move(spec));
+    }
+    if (specs.empty()) {
+        throw InvalidInputException("No endpoint in \"%s\"", url_list);
+    }
+    return specs;
+}
+
+string OpenPromptEndpointSet::FormatList(const vector<OpenPromptEndpointSpec> &specs) {
+    string result;
+    for (auto &spec : specs) {
+        if (!result.empty()) {
+            result += ", ";
+        }
+        result += spec.url;
+        if (spec.weight != 1) {
+            result += ";weight=" + StringUtil::Format("%g", spec.weight);
+        }
+    }
+    return result;
+}
+
+OpenPromptEndpointSet::OpenPromptEndpointSet(const string &url_list) {
+    for (auto &spec : ParseList(url_list)) {
+        auto backend = make_uniq<OpenPromptBackend>();
+        backend->url = spec.url;
+        backend->endpoint = HTTPEndpoint::Parse(spec.url);
+        backend->weight = spec.weight;
+        backends.push_back(std::move(backend));
+    }
+}
+
+shared_ptr<OpenPromptEndpointSet> OpenPromptEndpointSet::Get(ClientContext &context, const string &url_list) {
+    auto &cache = ObjectCache::GetObjectCache(context);
+    return cache.GetOrCreate<OpenPromptEndpointSet>(ObjectType() + ":" + url_list, url_list);
+}
+
+void OpenPromptEndpointSet::Configure(idx_t max_failures_p, double cooldown_seconds_p) {
+    lock_guard<mutex> guard(lock);
+    max_failures = MaxValue<idx_t>(max_failures_p, 1);
+    cooldown_seconds = cooldown_seconds_p;
+}
+
+OpenPromptBackend &OpenPromptEndpointSet::Acquire(optional_ptr<const OpenPromptBackend> exclude) {
+    lock_guard<mutex> guard(lock);
+    auto now = steady_clock::now();
+    optional_ptr<OpenPromptBackend> best;
+    bool best_healthy = false;
+    double best_load = 0;
+    auto start = next_start++;
+    for (idx_t i = 0; i < backends.size(); i++) {
+        auto &backend = *backends[(start + i) % backends.size()];
+        if (exclude.get() == &backend && backends.size() > 1) {
+            continue;
+        }
+        bool healthy = now >= backend.unhealthy_until;
+        double load = static_cast<double>(backend.outstanding + 1) / backend.weight;
+        if (!best) {
+            best = &backend;
+            best_healthy = healthy;
+            best_load = load;
+            continue;
+        }
+        if (healthy != best_healthy) {
+            if (healthy) {
+                best = &backend;
+                best_healthy = healthy;
+                best_load = load;
+            }
+            continue;
+        }
+        // Among unhealthy backends the one that comes back first is probed, otherwise the least loaded wins
+        bool better = healthy ? load < best_load : backend.unhealthy_until < best->unhealthy_until;
+        if (better) {
+            best = &backend;
+            best_load = load;
+        }
+    }
+    best->outstanding++;
+    best->requests++;
+    return *best;
+}
+
+void OpenPromptEndpointSet::Release(OpenPromptBackend &backend, bool failed) {
+    lock_guard<mutex> guard(lock);
+    backend.outstanding--;
+    if (!failed) {
+        backend.consecutive_failures = 0;
+        return;
+    }
+    backend.failures++;
+    backend.consecutive_failures++;
+    if (backend.consecutive_failures >= max_failures) {
+        // Taken out until the cooldown passed, the next request after that probes it again
+        backend.unhealthy_until = steady_clock::now() + std::chrono::milliseconds(
+                                                            static_cast<int64_t>(cooldown_seconds * 1000));
+        backend.consecutive_failures = 0;
+    }
+}
+
+bool OpenPromptEndpointSet::HasHealthyAlternative(const OpenPromptBackend &backend) {
+    lock_guard<mutex> guard(lock);
+    auto now = steady_clock::now();
+    for (auto &other : backends) {
+        if (other.get() != &backend && now >= other->unhealthy_until) {
+            return true;
+        }
+    }
+    return false;
+}
+
+vector<OpenPromptBackendStats> OpenPromptEndpointSet::GetStats() {
+    lock_guard<mutex> guard(lock);
+    auto now = steady_clock::now();
+    vector<OpenPromptBackendStats> result;
+    for (auto &backend : backends) {
+        OpenPromptBackendStats stats;
+        stats.url = backend->url;
+        stats.weight = backend->weight;
+        stats.outstanding = backend->outstanding;
+        stats.requests = backend->requests;
+        stats.failures = backend->failures;
+        stats.healthy = now >= backend->unhealthy_until;
+        result.push_back(std::move(stats));
+    }
+    return result;
+}
+
+} // namespace duckdb
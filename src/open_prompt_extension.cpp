@@ -2,40 +2,76 @@
 #include "open_prompt_extension.hpp"
 #include "duckdb.hpp"
 #include "duckdb/function/scalar_function.hpp"
+#include "duckdb/function/table_function.hpp"
 #include "duckdb/main/extension_util.hpp"
+#include "duckdb/main/config.hpp"
 #include "duckdb/common/atomic.hpp"
+#include "duckdb/common/string_map_set.hpp"
+#include "duckdb/common/string_util.hpp"
 #include "duckdb/common/exception/http_exception.hpp"
+#include "duckdb/common/exception/binder_exception.hpp"
 #include <duckdb/parser/parsed_data/create_scalar_function_info.hpp>
 
-#define CPPHTTPLIB_OPENSSL_SUPPORT
-#include "httplib.hpp"
+#include "http_client_pool.hpp"
+#include "open_prompt_request.hpp"
+#include "prompt_response_cache.hpp"
+#include "open_prompt_sender.hpp"
+#include "open_prompt_settings.hpp"
+#include "open_prompt_metrics.hpp"
+#include "open_prompt_map.hpp"
+#include "open_prompt_struct.hpp"
+#include "open_prompt_embed.hpp"
+#include "open_prompt_endpoints.hpp"
+#include "open_prompt_template.hpp"
+#include "open_prompt_tokens.hpp"
+#include "open_prompt_jobs.hpp"
+#include "open_prompt_agg.hpp"
 
 #include <string>
 #include <sstream>
 #include <mutex>
 #include <iostream>
 #include <duckdb/planner/expression/bound_function_expression.hpp>
+#include "duckdb/execution/expression_executor.hpp"
 
 #include "yyjson.hpp"
 
 #include<stdio.h>
 
 namespace duckdb {
+
     struct OpenPromptData: FunctionData {
+        //! Indexes of option arguments that are not constant and have to be read from each vector
         idx_t model_idx;
         idx_t json_schema_idx;
         idx_t json_system_prompt_idx;
+        //! Settings and constant arguments, resolved once at bind time
+        string api_url;
+        string api_token;
+        string model_name;
+        string json_schema;
+        string system_prompt;
+        //! Pre-rendered request body, only used when every option argument is constant
+        OpenPromptRequestTemplate request_template;
+        //! open_prompt_template: the prompt is rendered from this template instead of read from the first argument
+        shared_ptr<OpenPromptTextTemplate> prompt_template;
+
+        bool HasConstantOptions() const {
+            return model_idx == 0 && json_schema_idx == 0 && json_system_prompt_idx == 0;
+        }
         unique_ptr<FunctionData> Copy() const {
-            auto res = make_uniq<OpenPromptData>();
-            res->model_idx = model_idx;
-            res->json_schema_idx = json_schema_idx;
-            res->json_system_prompt_idx = json_system_prompt_idx;
-            return res;
+            return make_uniq<OpenPromptData>(*this);
         };
-        bool Equals(const FunctionData &other) const {
-            return model_idx == other.Cast<OpenPromptData>().model_idx &&
-                json_schema_idx == other.Cast<OpenPromptData>().json_schema_idx &&
-                json_system_prompt_idx==other.Cast<OpenPromptData>().json_system_prompt_idx;
+        bool Equals(const FunctionData &other_p) const {
+            auto &other = other_p.Cast<OpenPromptData>();
+            return model_idx == other.model_idx &&
+                json_schema_idx == other.json_schema_idx &&
+                json_system_prompt_idx == other.json_system_prompt_idx &&
+                api_url == other.api_url && api_token == other.api_token &&
+                model_name == other.model_name && json_schema == other.json_schema &&
+                system_prompt == other.system_prompt &&
+                (prompt_template ? other.prompt_template && *prompt_template == *other.prompt_template
+                                 : !other.prompt_template);
         };
         OpenPromptData() {
             model_idx = 0;
@@ -44,102 +80,77 @@ namespace duckdb {
         }
     };
 
+    // Constant option arguments are folded into the bind data, others keep their index
+    static void BindOptionArgument(ClientContext &context, Expression &argument, idx_t i,
+                                   idx_t &argument_idx, string &argument_value) {
+        if (!argument.IsFoldable()) {
+            argument_idx = i;
+            return;
+        }
+        auto value = ExpressionExecutor::EvaluateScalar(context, argument);
+        if (!value.IsNull()) {
+            argument_value = value.ToString();
+        }
+    }
+
     unique_ptr<FunctionData> OpenPromptBind(ClientContext &context, ScalarFunction &bound_function,
                                                            vector<unique_ptr<Expression>> &arguments) {
         auto res = make_uniq<OpenPromptData>();
+        res->api_url = OpenPromptSettings::GetVariable(context, "openprompt_api_url",
+                                                       "http://localhost:11434/v1/chat/completions");
+        res->api_token = OpenPromptSettings::GetVariable(context, "openprompt_api_token", "");
+        res->model_name = OpenPromptSettings::GetVariable(context, "openprompt_model_name", "qwen2.5:0.5b");
         for (idx_t i = 1; i < arguments.size(); ++i) {
-            const auto &argument = arguments[i];
-            if (i == 1 && argument->alias.empty()) {
-                res->model_idx = i;
-            } else if (argument->alias == "json_schema") {
-                res->json_schema_idx = i;
-            } else if (argument->alias == "system_prompt") {
-                res->json_system_prompt_idx = i;
+            auto &argument = *arguments[i];
+            if ((i == 1 && argument.alias.empty()) || argument.alias == "model") {
+                BindOptionArgument(context, argument, i, res->model_idx, res->model_name);
+            } else if (argument.alias == "json_schema") {
+                BindOptionArgument(context, argument, i, res->json_schema_idx, res->json_schema);
+            } else if (argument.alias == "system_prompt") {
+                BindOptionArgument(context, argument, i, res->json_system_prompt_idx, res->system_prompt);
             }
         }
+        if (res->HasConstantOptions()) {
+            res->request_template = OpenPromptRequestTemplate::Create(res->model_name, res->json_schema,
+                                                                      res->system_prompt);
+        }
         return std::move(res);
     }
 
-
-
-static std::pair<duckdb_httplib_openssl::Client, std::string> SetupHttpClient(const std::string &url) {
-    std::string scheme, domain, path;
-    size_t pos = url.find("://");
-    std::string mod_url = url;
-    if (pos != std::string::npos) {
-        scheme = mod_url.substr(0, pos);
-        mod_url.erase(0, pos + 3);
+    static bool IsOptionArgument(const string &alias) {
+        return alias == "model" || alias == "json_schema" || alias == "system_prompt";
     }
 
-    pos = mod_url.find("/");
-    if (pos != std::string::npos) {
-        domain = mod_url.substr(0, pos);
-        path = mod_url.substr(pos);
-    } else {
-        domain = mod_url;
-        path = "/";
+    // open_prompt_template(template, name := value, ...): every named argument that is not an option fills the
+    // placeholder of the same name
+    static unique_ptr<FunctionData> OpenPromptTemplateBind(ClientContext &context, ScalarFunction &bound_function,
+                                                           vector<unique_ptr<Expression>> &arguments) {
+        if (!arguments[0]->IsFoldable()) {
+            throw BinderException("open_prompt_template requires a constant template");
+        }
+        auto template_value = ExpressionExecutor::EvaluateScalar(context, *arguments[0]);
+        if (template_value.IsNull()) {
+            throw BinderException("open_prompt_template requires a non-NULL template");
+        }
+        case_insensitive_map_t<idx_t> placeholder_arguments;
+        for (idx_t i = 1; i < arguments.size(); i++) {
+            auto &alias = arguments[i]->alias;
+            if (alias.empty()) {
+                throw BinderException("open_prompt_template: argument %d needs a name, e.g. a := column", i + 1);
+            }
+            if (!IsOptionArgument(alias)) {
+                placeholder_arguments[alias] = i;
+            }
+        }
+        // Placeholder values of any type are cast to VARCHAR
+        bound_function.varargs = LogicalType::VARCHAR;
+        auto res = OpenPromptBind(context, bound_function, arguments);
+        res->Cast<OpenPromptData>().prompt_template = make_shared_ptr<OpenPromptTextTemplate>(
+            OpenPromptTextTemplate::Parse(template_value.ToString(), placeholder_arguments));
+        return res;
     }
 
-    duckdb_httplib_openssl::Client client(domain.c_str());
-    client.set_read_timeout(10, 0);  // 10 seconds
-    client.set_follow_location(true); // Follow redirects
-
-    return std::make_pair(std::move(client), path);
-}
-
-static void HandleHttpError(const duckdb_httplib_openssl::Result &res, const std::string &request_type) {
-    std::string err_message = "HTTP " + request_type + " request failed. ";
-
-    switch (res.error()) {
-        case duckdb_httplib_openssl::Error::Connection:
-            err_message += "Connection error.";
-            break;
-        case duckdb_httplib_openssl::Error::BindIPAddress:
-            err_message += "Failed to bind IP address.";
-            break;
-        case duckdb_httplib_openssl::Error::Read:
-            err_message += "Error reading response.";
-            break;
-        case duckdb_httplib_openssl::Error::Write:
-            err_message += "Error writing request.";
-            break;
-        case duckdb_httplib_openssl::Error::ExceedRedirectCount:
-            err_message += "Too many redirects.";
-            break;
-        case duckdb_httplib_openssl::Error::Canceled:
-            err_message += "Request was canceled.";
-            break;
-        case duckdb_httplib_openssl::Error::SSLConnection:
-            err_message += "SSL connection failed.";
-            break;
-        case duckdb_httplib_openssl::Error::SSLLoadingCerts:
-            err_message += "Failed to load SSL certificates.";
-            break;
-        case duckdb_httplib_openssl::Error::SSLServerVerification:
-            err_message += "SSL server verification failed.";
-            break;
-        case duckdb_httplib_openssl::Error::UnsupportedMultipartBoundaryChars:
-            err_message += "Unsupported characters in multipart boundary.";
-            break;
-        case duckdb_httplib_openssl::Error::Compression:
-            err_message += "Error during compression.";
-            break;
-        default:
-            err_message += "Unknown error.";
-            break;
-    }
-    throw std::runtime_error(err_message);
-}
 
-// Settings management
-static std::string GetConfigValue(ClientContext &context, const string &var_name, const string &default_value) {
-    Value value;
-    auto &config = ClientConfig::GetConfig(context);
-    if (!config.GetUserVariable(var_name, value) || value.IsNull()) {
-        return default_value;
-    }
-    return value.ToString();
-}
 
 static void SetConfigValue(DataChunk &args, ExpressionState &state, Vector &result, 
                           const string &var_name, const string &value_type) {
@@ -173,151 +184,508 @@ static void SetModelName(DataChunk &args, ExpressionState &state, Vector &result
     SetConfigValue(args, state, result, "openprompt_model_name", "Model name");
 }
 
-// Main Function
-static void OpenPromptRequestFunction(DataChunk &args, ExpressionState &state, Vector &result) {
+//! The requests of one vector of prompts, identical bodies within the vector are only sent once
+struct OpenPromptVectorRequests {
+    //! Rows with a non-NULL prompt, and the request each of them maps to
+    vector<idx_t> pending_rows;
+    vector<idx_t> row_requests;
+    vector<OpenPromptRequest> requests;
+    //! The prompt is a constant, only the first row was sent
+    bool constant_input = false;
+};
+
+// Renders and sends the request of every row, rows with a NULL prompt are set to NULL in `result`
+static void SendVectorRequests(DataChunk &args, ExpressionState &state, Vector &result,
+                               OpenPromptVectorRequests &vector_requests) {
     D_ASSERT(args.data.size() >= 1); // At least prompt required
 
-    UnaryExecutor::Execute<string_t, string_t>(args.data[0], result, args.size(),
-        [&](string_t user_prompt) {
-            auto &func_expr = state.expr.Cast<BoundFunctionExpression>();
-            auto &info = func_expr.bind_info->Cast<OpenPromptData>();
-            auto &context = state.GetContext();
-            // Get configuration with defaults
-            std::string api_url = GetConfigValue(context, "openprompt_api_url", 
-                                               "http://localhost:11434/v1/chat/completions");
-            std::string api_token = GetConfigValue(context, "openprompt_api_token", "");
-            std::string model_name = GetConfigValue(context, "openprompt_model_name", "qwen2.5:0.5b");
-            std::string json_schema;
-            std::string system_prompt;
-
-            if (info.model_idx != 0) {
-                model_name = args.data[info.model_idx].GetValue(0).ToString();
-            }
-            if (info.json_schema_idx != 0) {
-                json_schema = args.data[info.json_schema_idx].GetValue(0).ToString();
-            }
-            if (info.json_system_prompt_idx != 0) {
-                system_prompt = args.data[info.json_system_prompt_idx].GetValue(0).ToString();
-            }
+    auto &func_expr = state.expr.Cast<BoundFunctionExpression>();
+    auto &info = func_expr.bind_info->Cast<OpenPromptData>();
+    auto &context = state.GetContext();
+
+    // Non-constant option arguments are read from the first row, once per vector
+    auto model_name = info.model_name;
+    auto json_schema = info.json_schema;
+    auto system_prompt = info.system_prompt;
+    const OpenPromptRequestTemplate *vector_template = &info.request_template;
+    if (!info.HasConstantOptions()) {
+        if (info.model_idx != 0) {
+            model_name = args.data[info.model_idx].GetValue(0).ToString();
+        }
+        if (info.json_schema_idx != 0) {
+            json_schema = args.data[info.json_schema_idx].GetValue(0).ToString();
+        }
+        if (info.json_system_prompt_idx != 0) {
+            system_prompt = args.data[info.json_system_prompt_idx].GetValue(0).ToString();
+        }
+        // Consecutive vectors usually carry the same options, the template is only rebuilt when they change
+        vector_template = &OpenPromptRequestTemplate::GetCached(model_name, json_schema, system_prompt);
+    }
+    auto &request_template = *vector_template;
 
-            unique_ptr<duckdb_yyjson::yyjson_mut_doc, void (*)(duckdb_yyjson::yyjson_mut_doc*)> doc(
-                    duckdb_yyjson::yyjson_mut_doc_new(nullptr), &duckdb_yyjson::yyjson_mut_doc_free);
-            auto obj = duckdb_yyjson::yyjson_mut_obj(doc.get());
-            duckdb_yyjson::yyjson_mut_doc_set_root(doc.get(), obj);
-            duckdb_yyjson::yyjson_mut_obj_add(obj,
-                duckdb_yyjson::yyjson_mut_str(doc.get(), "model"),
-                duckdb_yyjson::yyjson_mut_str(doc.get(), model_name.c_str())
-                );
-            if (!json_schema.empty()) {
-                auto response_format = duckdb_yyjson::yyjson_mut_obj(doc.get());
-                duckdb_yyjson::yyjson_mut_obj_add(response_format,
-                    duckdb_yyjson::yyjson_mut_str(doc.get(), "type"),
-                    duckdb_yyjson::yyjson_mut_str(doc.get(), "json_object"));
-                auto yyschema = duckdb_yyjson::yyjson_mut_raw(doc.get(), json_schema.c_str());
-                duckdb_yyjson::yyjson_mut_obj_add(response_format,
-                    duckdb_yyjson::yyjson_mut_str(doc.get(), "schema"),
-                    yyschema);
-                duckdb_yyjson::yyjson_mut_obj_add(obj,
-                    duckdb_yyjson::yyjson_mut_str(doc.get(),"response_format"),
-                    response_format);
+    // The prompt is the first argument, or rendered from the placeholder arguments of open_prompt_template
+    auto &prompt_template = info.prompt_template;
+    vector<idx_t> prompt_arguments {0};
+    if (prompt_template) {
+        prompt_arguments = prompt_template->Arguments();
+    }
+    vector_requests.constant_input = true;
+    for (auto argument : prompt_arguments) {
+        if (args.data[argument].GetVectorType() != VectorType::CONSTANT_VECTOR) {
+            vector_requests.constant_input = false;
+        }
+    }
+    idx_t count = vector_requests.constant_input ? 1 : args.size();
+
+    vector<UnifiedVectorFormat> argument_data(args.ColumnCount());
+    for (auto argument : prompt_arguments) {
+        args.data[argument].ToUnifiedFormat(count, argument_data[argument]);
+    }
+    vector<string_t> values(args.ColumnCount());
+
+    result.SetVectorType(VectorType::FLAT_VECTOR);
+
+    OpenPromptSender sender(context, info.api_url, info.api_token);
+
+    // Build every request body up front, identical bodies within the vector are only sent once
+    bool needs_prompts = sender.NeedsPrompts();
+    // Prompts over the input token budget are cut or rejected before anything is sent
+    auto &token_budget = sender.TokenBudget();
+    idx_t system_tokens = 0;
+    idx_t prompt_budget = 0;
+    if (token_budget.Enabled()) {
+        system_tokens = token_budget.estimator.Estimate(system_prompt);
+        prompt_budget = token_budget.max_input_tokens > system_tokens ? token_budget.max_input_tokens - system_tokens
+                                                                       : 0;
+    }
+    string truncated_prompt;
+    auto &pending_rows = vector_requests.pending_rows;
+    auto &row_requests = vector_requests.row_requests;
+    auto &requests = vector_requests.requests;
+    // Keys point into the bodies stored in `requests`, which is never reallocated, so lookups copy nothing
+    string_map_t<idx_t> request_lookup;
+    pending_rows.reserve(count);
+    row_requests.reserve(count);
+    requests.reserve(count);
+    string request_body;
+    for (idx_t i = 0; i < count; i++) {
+        // Like string concatenation, a NULL in any of the prompt's arguments makes the row NULL
+        bool is_null = false;
+        for (auto argument : prompt_arguments) {
+            auto &data = argument_data[argument];
+            auto idx = data.sel->get_index(i);
+            if (!data.validity.RowIsValid(idx)) {
+                is_null = true;
+                break;
             }
-            auto messages = duckdb_yyjson::yyjson_mut_arr(doc.get());
-            string str_messages[2][2] = {
-                {"system", system_prompt},
-                {"user", user_prompt.GetString()}
-            };
-            for (auto message : str_messages) {
-                if (message[1].empty()) {
+            values[argument] = UnifiedVectorFormat::GetData<string_t>(data)[idx];
+        }
+        if (is_null) {
+            FlatVector::SetNull(result, i, true);
+            continue;
+        }
+        const char *prompt = values[0].GetData();
+        idx_t prompt_size = values[0].GetSize();
+        bool render_template = prompt_template != nullptr;
+        if (token_budget.Enabled()) {
+            auto prompt_tokens = render_template ? prompt_template->EstimateTokens(values, token_budget.estimator)
+                                                 : token_budget.estimator.Estimate(prompt, prompt_size);
+            if (prompt_tokens > prompt_budget) {
+                if (token_budget.overflow == OpenPromptOverflowMode::REJECT) {
+                    pending_rows.push_back(i);
+                    row_requests.push_back(requests.size());
+                    requests.emplace_back();
+                    requests.back().completed = true;
+                    requests.back().response = StringUtil::Format(
+                        "Error: Prompt of about %d tokens exceeds openprompt_max_input_tokens (%d)",
+                        system_tokens + prompt_tokens, token_budget.max_input_tokens);
                     continue;
                 }
-                auto yymessage = duckdb_yyjson::yyjson_mut_arr_add_obj(doc.get(),messages);
-                duckdb_yyjson::yyjson_mut_obj_add(yymessage,
-                    duckdb_yyjson::yyjson_mut_str(doc.get(), "role"),
-                    duckdb_yyjson::yyjson_mut_str(doc.get(), message[0].c_str()));
-                duckdb_yyjson::yyjson_mut_obj_add(yymessage,
-                    duckdb_yyjson::yyjson_mut_str(doc.get(), "content"),
-                    duckdb_yyjson::yyjson_mut_str(doc.get(), message[1].c_str()));
+                truncated_prompt = render_template ? prompt_template->Render(values) : string(prompt, prompt_size);
+                truncated_prompt.resize(token_budget.estimator.TruncateLength(
+                    truncated_prompt.c_str(), truncated_prompt.size(), prompt_budget));
+                prompt = truncated_prompt.c_str();
+                prompt_size = truncated_prompt.size();
+                render_template = false;
             }
-            duckdb_yyjson::yyjson_mut_obj_add(obj, duckdb_yyjson::yyjson_mut_str(doc.get(), "messages"),
-                messages);
-            duckdb_yyjson::yyjson_write_err err;
-            auto request_body = duckdb_yyjson::yyjson_mut_write_opts(doc.get(), 0, nullptr, nullptr, &err);
-            if (request_body == nullptr) {
-                throw std::runtime_error(err.msg);
+        }
+        if (render_template) {
+            // Rendered straight into the request body, without an intermediate prompt string
+            request_template.BeginUserMessage(request_body, prompt_template->RenderedSize(values));
+            prompt_template->AppendEscaped(request_body, values);
+            request_template.EndUserMessage(request_body, sender.Streaming());
+        } else {
+            request_template.Render(prompt, prompt_size, request_body, sender.Streaming());
+        }
+        pending_rows.push_back(i);
+        if (sender.Deduplicate()) {
+            auto lookup = request_lookup.find(
+                string_t(request_body.data(), UnsafeNumericCast<uint32_t>(request_body.size())));
+            if (lookup != request_lookup.end()) {
+                row_requests.push_back(lookup->second);
+                sender.Metrics().RecordDeduplicated();
+                continue;
             }
-            string str_request_body(request_body);
-            free(request_body);
+        }
+        row_requests.push_back(requests.size());
+        requests.emplace_back();
+        // The rendered body moves into the request, the scratch buffer is reserved again for the next row
+        auto &stored_body = requests.back().body;
+        stored_body = std::move(request_body);
+        request_body = string();
+        request_body.reserve(stored_body.size());
+        if (sender.Deduplicate()) {
+            request_lookup.emplace(string_t(stored_body.data(), UnsafeNumericCast<uint32_t>(stored_body.size())),
+                                   requests.size() - 1);
+        }
+        if (needs_prompts) {
+            requests.back().prompt = render_template ? prompt_template->Render(values) : string(prompt, prompt_size);
+        }
+    }
 
-            try {
-                auto client_and_path = SetupHttpClient(api_url);
-                auto &client = client_and_path.first;
-                auto &path = client_and_path.second;
-
-                duckdb_httplib_openssl::Headers headers;
-                headers.emplace("Content-Type", "application/json");
-                if (!api_token.empty()) {
-                    headers.emplace("Authorization", "Bearer " + api_token);
-                }
+    sender.Send(requests, model_name, json_schema, system_prompt);
+}
 
-                auto res = client.Post(path.c_str(), headers, str_request_body, "application/json");
-                
-                if (!res) {
-                    HandleHttpError(res, "POST");
-                }
-                
-                if (res->status != 200) {
-                    throw std::runtime_error("HTTP error " + std::to_string(res->status) + ": " + res->reason);
-                }
+// Main Function
+static void OpenPromptRequestFunction(DataChunk &args, ExpressionState &state, Vector &result) {
+    OpenPromptVectorRequests vector_requests;
+    SendVectorRequests(args, state, result, vector_requests);
+    auto &requests = vector_requests.requests;
+    auto result_data = FlatVector::GetData<string_t>(result);
+    // Failed rows are NULL through the validity mask, so that they can be found without scanning the strings
+    auto null_on_error = OpenPromptSettings::GetBoolean(state.GetContext(), "openprompt_null_on_error", false);
+
+    // String heap writes are not thread safe, results are copied into their row slots here.
+    // Rows with the same request share a single copy of the response
+    vector<string_t> response_strings(requests.size());
+    for (idx_t request_idx = 0; request_idx < requests.size(); request_idx++) {
+        if (requests[request_idx].success || !null_on_error) {
+            response_strings[request_idx] = StringVector::AddString(result, requests[request_idx].response);
+        }
+    }
+    for (idx_t i = 0; i < vector_requests.pending_rows.size(); i++) {
+        auto row = vector_requests.pending_rows[i];
+        auto request_idx = vector_requests.row_requests[i];
+        if (!requests[request_idx].success && null_on_error) {
+            FlatVector::SetNull(result, row, true);
+            continue;
+        }
+        result_data[row] = response_strings[request_idx];
+    }
 
-                try {
-                    unique_ptr<duckdb_yyjson::yyjson_doc, void(*)(duckdb_yyjson::yyjson_doc *)> doc(
-                        duckdb_yyjson::yyjson_read(res->body.c_str(), res->body.length(), 0),
-                        &duckdb_yyjson::yyjson_doc_free
-                    );
-                    
-                    if (!doc) {
-                        throw std::runtime_error("Failed to parse JSON response");
-                    }
-
-                    auto root = duckdb_yyjson::yyjson_doc_get_root(doc.get());
-                    if (!root) {
-                        throw std::runtime_error("Invalid JSON response: no root object");
-                    }
-
-                    auto choices = duckdb_yyjson::yyjson_obj_get(root, "choices");
-                    if (!choices || !duckdb_yyjson::yyjson_is_arr(choices)) {
-                        throw std::runtime_error("Invalid response format: missing choices array");
-                    }
-
-                    auto first_choice = duckdb_yyjson::yyjson_arr_get_first(choices);
-                    if (!first_choice) {
-                        throw std::runtime_error("Empty choices array in response");
-                    }
-
-                    auto message = duckdb_yyjson::yyjson_obj_get(first_choice, "message");
-                    if (!message) {
-                        throw std::runtime_error("Missing message in response");
-                    }
-
-                    auto content = duckdb_yyjson::yyjson_obj_get(message, "content");
-                    if (!content) {
-                        throw std::runtime_error("Missing content in response");
-                    }
-
-                    auto content_str = duckdb_yyjson::yyjson_get_str(content);
-                    if (!content_str) {
-                        throw std::runtime_error("Invalid content in response");
-                    }
-
-                    return StringVector::AddString(result, content_str);
-                } catch (std::exception &e) {
-                    throw std::runtime_error("Failed to parse response: " + std::string(e.what()));
-                }
-            } catch (std::exception &e) {
-                // Log error and return error message
-                return StringVector::AddString(result, "Error: " + std::string(e.what()));
-            }
-        });
+    if (vector_requests.constant_input) {
+        result.SetVectorType(VectorType::CONSTANT_VECTOR);
+    }
+}
+
+// Diagnostic variant, every row is a STRUCT(content, error, status, latency_ms, tokens) so that failed rows can be
+// selected with `error IS NOT NULL` and a completion is never mistaken for an error message
+static LogicalType OpenPromptResultType() {
+    child_list_t<LogicalType> children;
+    children.emplace_back("content", LogicalType::VARCHAR);
+    children.emplace_back("error", LogicalType::VARCHAR);
+    children.emplace_back("status", LogicalType::INTEGER);
+    children.emplace_back("latency_ms", LogicalType::DOUBLE);
+    children.emplace_back("tokens", LogicalType::BIGINT);
+    return LogicalType::STRUCT(std::move(children));
+}
+
+static void OpenPromptResultFunction(DataChunk &args, ExpressionState &state, Vector &result) {
+    OpenPromptVectorRequests vector_requests;
+    SendVectorRequests(args, state, result, vector_requests);
+    auto &requests = vector_requests.requests;
+
+    auto &entries = StructVector::GetEntries(result);
+    auto &content = *entries[0];
+    auto &error = *entries[1];
+    auto content_data = FlatVector::GetData<string_t>(content);
+    auto error_data = FlatVector::GetData<string_t>(error);
+    auto status_data = FlatVector::GetData<int32_t>(*entries[2]);
+    auto latency_data = FlatVector::GetData<double>(*entries[3]);
+    auto tokens_data = FlatVector::GetData<int64_t>(*entries[4]);
+    // Rows sharing a request report its tokens once, so that the column sums to the tokens used
+    vector<bool> tokens_reported(requests.size(), false);
+    for (idx_t i = 0; i < vector_requests.pending_rows.size(); i++) {
+        auto row = vector_requests.pending_rows[i];
+        auto request_idx = vector_requests.row_requests[i];
+        auto &request = requests[request_idx];
+        if (request.success) {
+            content_data[row] = StringVector::AddString(content, request.response);
+            FlatVector::SetNull(error, row, true);
+        } else {
+            FlatVector::SetNull(content, row, true);
+            error_data[row] = StringVector::AddString(error, request.ErrorMessage());
+        }
+        if (request.status == 0) {
+            FlatVector::SetNull(*entries[2], row, true);
+        } else {
+            status_data[row] = request.status;
+        }
+        latency_data[row] = request.latency_ms;
+        tokens_data[row] = tokens_reported[request_idx] ? 0 : NumericCast<int64_t>(request.tokens);
+        tokens_reported[request_idx] = true;
+    }
+
+    if (vector_requests.constant_input) {
+        result.SetVectorType(VectorType::CONSTANT_VECTOR);
+    }
+}
+
+// Structured variant, the completion is decoded into a STRUCT derived from the json_schema
+static unique_ptr<FunctionData> OpenPromptStructBind(ClientContext &context, ScalarFunction &bound_function,
+                                                     vector<unique_ptr<Expression>> &arguments) {
+    auto res = OpenPromptBind(context, bound_function, arguments);
+    auto &info = res->Cast<OpenPromptData>();
+    if (info.json_schema_idx != 0 || info.json_schema.empty()) {
+        throw BinderException("open_prompt_struct requires a constant json_schema argument");
+    }
+    bound_function.return_type = JSONSchemaToStructType(info.json_schema);
+    return res;
+}
+
+static void OpenPromptStructFunction(DataChunk &args, ExpressionState &state, Vector &result) {
+    OpenPromptVectorRequests vector_requests;
+    SendVectorRequests(args, state, result, vector_requests);
+    auto &requests = vector_requests.requests;
+
+    // Each completion is parsed once, failed requests and content that is not JSON become NULL
+    vector<unique_ptr<OpenPromptJSONContent>> contents(requests.size());
+    for (idx_t request_idx = 0; request_idx < requests.size(); request_idx++) {
+        if (requests[request_idx].success) {
+            contents[request_idx] = make_uniq<OpenPromptJSONContent>(requests[request_idx].response);
+        }
+    }
+    for (idx_t i = 0; i < vector_requests.pending_rows.size(); i++) {
+        auto &content = contents[vector_requests.row_requests[i]];
+        WriteJSONValue(content ? content->Root() : nullptr, result, vector_requests.pending_rows[i]);
+    }
+
+    if (vector_requests.constant_input) {
+        result.SetVectorType(VectorType::CONSTANT_VECTOR);
+    }
+}
+
+// Pool statistics table function
+struct OpenPromptPoolStatsData : public GlobalTableFunctionState {
+    vector<HTTPClientPoolHostStats> stats;
+    idx_t offset = 0;
+};
+
+static unique_ptr<FunctionData> OpenPromptPoolStatsBind(ClientContext &context, TableFunctionBindInput &input,
+                                                        vector<LogicalType> &return_types, vector<string> &names) {
+    names.emplace_back("host");
+    return_types.emplace_back(LogicalType::VARCHAR);
+    names.emplace_back("idle_connections");
+    return_types.emplace_back(LogicalType::UBIGINT);
+    names.emplace_back("hits");
+    return_types.emplace_back(LogicalType::UBIGINT);
+    names.emplace_back("misses");
+    return_types.emplace_back(LogicalType::UBIGINT);
+    names.emplace_back("evictions");
+    return_types.emplace_back(LogicalType::UBIGINT);
+    return nullptr;
+}
+
+static unique_ptr<GlobalTableFunctionState> OpenPromptPoolStatsInit(ClientContext &context,
+                                                                    TableFunctionInitInput &input) {
+    auto res = make_uniq<OpenPromptPoolStatsData>();
+    res->stats = HTTPClientPool::Get(context)->GetStats();
+    return std::move(res);
+}
+
+static void OpenPromptPoolStatsFunction(ClientContext &context, TableFunctionInput &data_p, DataChunk &output) {
+    auto &data = data_p.global_state->Cast<OpenPromptPoolStatsData>();
+    idx_t count = 0;
+    while (data.offset < data.stats.size() && count < STANDARD_VECTOR_SIZE) {
+        auto &entry = data.stats[data.offset++];
+        output.SetValue(0, count, Value(entry.host));
+        output.SetValue(1, count, Value::UBIGINT(entry.idle_connections));
+        output.SetValue(2, count, Value::UBIGINT(entry.hits));
+        output.SetValue(3, count, Value::UBIGINT(entry.misses));
+        output.SetValue(4, count, Value::UBIGINT(entry.evictions));
+        count++;
+    }
+    output.SetCardinality(count);
+}
+
+// Endpoint statistics table function
+struct OpenPromptEndpointStatsData : public GlobalTableFunctionState {
+    vector<OpenPromptBackendStats> stats;
+    idx_t offset = 0;
+};
+
+static unique_ptr<FunctionData> OpenPromptEndpointStatsBind(ClientContext &context, TableFunctionBindInput &input,
+                                                            vector<LogicalType> &return_types, vector<string> &names) {
+    names.emplace_back("url");
+    return_types.emplace_back(LogicalType::VARCHAR);
+    names.emplace_back("weight");
+    return_types.emplace_back(LogicalType::DOUBLE);
+    names.emplace_back("healthy");
+    return_types.emplace_back(LogicalType::BOOLEAN);
+    names.emplace_back("outstanding");
+    return_types.emplace_back(LogicalType::UBIGINT);
+    names.emplace_back("requests");
+    return_types.emplace_back(LogicalType::UBIGINT);
+    names.emplace_back("failures");
+    return_types.emplace_back(LogicalType::UBIGINT);
+    return nullptr;
+}
+
+static unique_ptr<GlobalTableFunctionState> OpenPromptEndpointStatsInit(ClientContext &context,
+                                                                        TableFunctionInitInput &input) {
+    auto res = make_uniq<OpenPromptEndpointStatsData>();
+    auto api_url = OpenPromptSettings::GetVariable(context, "openprompt_api_url",
+                                                   "http://localhost:11434/v1/chat/completions");
+    res->stats = OpenPromptEndpointSet::Get(context, api_url)->GetStats();
+    return std::move(res);
+}
+
+static void OpenPromptEndpointStatsFunction(ClientContext &context, TableFunctionInput &data_p, DataChunk &output) {
+    auto &data = data_p.global_state->Cast<OpenPromptEndpointStatsData>();
+    idx_t count = 0;
+    while (data.offset < data.stats.size() && count < STANDARD_VECTOR_SIZE) {
+        auto &entry = data.stats[data.offset++];
+        output.SetValue(0, count, Value(entry.url));
+        output.SetValue(1, count, Value::DOUBLE(entry.weight));
+        output.SetValue(2, count, Value::BOOLEAN(entry.healthy));
+        output.SetValue(3, count, Value::UBIGINT(entry.outstanding));
+        output.SetValue(4, count, Value::UBIGINT(entry.requests));
+        output.SetValue(5, count, Value::UBIGINT(entry.failures));
+        count++;
+    }
+    output.SetCardinality(count);
+}
+
+// Response cache functions
+struct OpenPromptCacheStatsData : public GlobalTableFunctionState {
+    vector<PromptResponseCacheStats> stats;
+    idx_t offset = 0;
+};
+
+static unique_ptr<FunctionData> OpenPromptCacheStatsBind(ClientContext &context, TableFunctionBindInput &input,
+                                                         vector<LogicalType> &return_types, vector<string> &names) {
+    names.emplace_back("path");
+    return_types.emplace_back(LogicalType::VARCHAR);
+    names.emplace_back("entries");
+    return_types.emplace_back(LogicalType::UBIGINT);
+    names.emplace_back("bytes");
+    return_types.emplace_back(LogicalType::UBIGINT);
+    names.emplace_back("hits");
+    return_types.emplace_back(LogicalType::UBIGINT);
+    names.emplace_back("misses");
+    return_types.emplace_back(LogicalType::UBIGINT);
+    names.emplace_back("evictions");
+    return_types.emplace_back(LogicalType::UBIGINT);
+    names.emplace_back("expirations");
+    return_types.emplace_back(LogicalType::UBIGINT);
+    names.emplace_back("write_failures");
+    return_types.emplace_back(LogicalType::UBIGINT);
+    names.emplace_back("similar_entries");
+    return_types.emplace_back(LogicalType::UBIGINT);
+    names.emplace_back("approximate_hits");
+    return_types.emplace_back(LogicalType::UBIGINT);
+    return nullptr;
+}
+
+static unique_ptr<GlobalTableFunctionState> OpenPromptCacheStatsInit(ClientContext &context,
+                                                                     TableFunctionInitInput &input) {
+    auto res = make_uniq<OpenPromptCacheStatsData>();
+    auto cache = GetResponseCache(context);
+    if (cache) {
+        res->stats.push_back(cache->GetStats());
+    }
+    return std::move(res);
+}
+
+static void OpenPromptCacheStatsFunction(ClientContext &context, TableFunctionInput &data_p, DataChunk &output) {
+    auto &data = data_p.global_state->Cast<OpenPromptCacheStatsData>();
+    idx_t count = 0;
+    while (data.offset < data.stats.size() && count < STANDARD_VECTOR_SIZE) {
+        auto &entry = data.stats[data.offset++];
+        output.SetValue(0, count, Value(entry.path));
+        output.SetValue(1, count, Value::UBIGINT(entry.entries));
+        output.SetValue(2, count, Value::UBIGINT(entry.bytes));
+        output.SetValue(3, count, Value::UBIGINT(entry.hits));
+        output.SetValue(4, count, Value::UBIGINT(entry.misses));
+        output.SetValue(5, count, Value::UBIGINT(entry.evictions));
+        output.SetValue(6, count, Value::UBIGINT(entry.expirations));
+        output.SetValue(7, count, Value::UBIGINT(entry.write_failures));
+        output.SetValue(8, count, Value::UBIGINT(entry.similar_entries));
+        output.SetValue(9, count, Value::UBIGINT(entry.approximate_hits));
+        count++;
+    }
+    output.SetCardinality(count);
+}
+
+static void OpenPromptCacheClear(DataChunk &args, ExpressionState &state, Vector &result) {
+    auto cache = GetResponseCache(state.GetContext());
+    string message = "Response cache is disabled.";
+    if (cache) {
+        message = "Removed " + std::to_string(cache->Clear()) + " cached responses.";
+    }
+    result.SetVectorType(VectorType::CONSTANT_VECTOR);
+    ConstantVector::GetData<string_t>(result)[0] = StringVector::AddString(result, message);
+}
+
+// Request metrics table function
+struct OpenPromptStatsData : public GlobalTableFunctionState {
+    shared_ptr<OpenPromptStats> stats;
+    bool finished = false;
+};
+
+static unique_ptr<FunctionData> OpenPromptStatsBind(ClientContext &context, TableFunctionBindInput &input,
+                                                    vector<LogicalType> &return_types, vector<string> &names) {
+    for (auto name : {"requests", "errors", "retries", "throttled", "failovers", "hedges", "hedge_wins", "cache_hits",
+                      "deduplicated", "connections_opened", "connections_reused", "bytes_sent", "bytes_received",
+                      "payload_bytes_sent", "payload_bytes_received", "prompt_tokens", "completion_tokens"}) {
+        names.emplace_back(name);
+        return_types.emplace_back(LogicalType::UBIGINT);
+    }
+    for (auto name : {"latency_p50_ms", "latency_p95_ms", "latency_p99_ms", "avg_time_to_first_token_ms"}) {
+        names.emplace_back(name);
+        return_types.emplace_back(LogicalType::DOUBLE);
+    }
+    return nullptr;
+}
+
+static unique_ptr<GlobalTableFunctionState> OpenPromptStatsInit(ClientContext &context,
+                                                                TableFunctionInitInput &input) {
+    auto res = make_uniq<OpenPromptStatsData>();
+    res->stats = OpenPromptStats::Get(context);
+    return std::move(res);
+}
+
+static void OpenPromptStatsFunction(ClientContext &context, TableFunctionInput &data_p, DataChunk &output) {
+    auto &data = data_p.global_state->Cast<OpenPromptStatsData>();
+    if (data.finished) {
+        output.SetCardinality(0);
+        return;
+    }
+    auto &metrics = data.stats->metrics;
+    idx_t counters[] = {metrics.requests, metrics.errors, metrics.retries, metrics.throttled, metrics.failovers,
+                        metrics.hedges, metrics.hedge_wins, metrics.cache_hits, metrics.deduplicated,
+                        metrics.connections_opened, metrics.connections_reused, metrics.bytes_sent,
+                        metrics.bytes_received, metrics.payload_bytes_sent, metrics.payload_bytes_received,
+                        metrics.prompt_tokens, metrics.completion_tokens};
+    idx_t column = 0;
+    for (auto counter : counters) {
+        output.SetValue(column++, 0, Value::UBIGINT(counter));
+    }
+    output.SetValue(column++, 0, Value::DOUBLE(metrics.latency.Percentile(50)));
+    output.SetValue(column++, 0, Value::DOUBLE(metrics.latency.Percentile(95)));
+    output.SetValue(column++, 0, Value::DOUBLE(metrics.latency.Percentile(99)));
+    idx_t streamed_requests = metrics.streamed_requests;
+    output.SetValue(column++, 0, Value::DOUBLE(streamed_requests == 0 ? 0 :
+                                               static_cast<double>(metrics.time_to_first_token_us) /
+                                                   static_cast<double>(streamed_requests) / 1000));
+    output.SetCardinality(1);
+    data.finished = true;
+}
+
+static void OpenPromptStatsReset(DataChunk &args, ExpressionState &state, Vector &result) {
+    OpenPromptStats::Get(state.GetContext())->metrics.Reset();
+    result.SetVectorType(VectorType::CONSTANT_VECTOR);
+    ConstantVector::GetData<string_t>(result)[0] = StringVector::AddString(result, "open_prompt stats reset.");
 }
 
 // LoadInternal function
@@ -342,6 +710,64 @@ static void LoadInternal(DatabaseInstance &instance) {
     
     ExtensionUtil::RegisterFunction(instance, open_prompt);
 
+    // Same arguments as open_prompt, returning the outcome of each request instead of a string
+    ScalarFunctionSet open_prompt_result("open_prompt_result");
+    for (idx_t argument_count = 1; argument_count <= 4; argument_count++) {
+        open_prompt_result.AddFunction(ScalarFunction(vector<LogicalType>(argument_count, LogicalType::VARCHAR),
+                                                      OpenPromptResultType(), OpenPromptResultFunction,
+                                                      OpenPromptBind));
+    }
+    ExtensionUtil::RegisterFunction(instance, open_prompt_result);
+
+    // Placeholder and option arguments are all named, their number is only known at bind time
+    ScalarFunction open_prompt_template("open_prompt_template", {LogicalType::VARCHAR}, LogicalType::VARCHAR,
+                                        OpenPromptRequestFunction, OpenPromptTemplateBind);
+    open_prompt_template.varargs = LogicalType::ANY;
+    ExtensionUtil::RegisterFunction(instance, open_prompt_template);
+
+    // The return type is derived from the json_schema at bind time
+    ScalarFunctionSet open_prompt_struct("open_prompt_struct");
+    open_prompt_struct.AddFunction(ScalarFunction(
+        {LogicalType::VARCHAR, LogicalType::VARCHAR}, LogicalType::ANY, OpenPromptStructFunction,
+        OpenPromptStructBind));
+    open_prompt_struct.AddFunction(ScalarFunction(
+        {LogicalType::VARCHAR, LogicalType::VARCHAR, LogicalType::VARCHAR},
+        LogicalType::ANY, OpenPromptStructFunction,
+        OpenPromptStructBind));
+    open_prompt_struct.AddFunction(ScalarFunction(
+        {LogicalType::VARCHAR, LogicalType::VARCHAR, LogicalType::VARCHAR, LogicalType::VARCHAR},
+        LogicalType::ANY, OpenPromptStructFunction,
+        OpenPromptStructBind));
+    ExtensionUtil::RegisterFunction(instance, open_prompt_struct);
+    ExtensionUtil::RegisterFunction(instance, GetOpenEmbedFunction());
+    ExtensionUtil::RegisterFunction(instance, GetOpenPromptTokenCountFunction());
+    ExtensionUtil::RegisterFunction(instance, GetOpenPromptChunkFunction());
+    ExtensionUtil::RegisterFunction(instance, GetOpenPromptMapFunction());
+    ExtensionUtil::RegisterFunction(instance, GetOpenPromptSubmitFunction());
+    ExtensionUtil::RegisterFunction(instance, GetOpenPromptStatusFunction());
+    ExtensionUtil::RegisterFunction(instance, GetOpenPromptCollectFunction());
+    ExtensionUtil::RegisterFunction(instance, GetOpenPromptCancelFunction());
+    ExtensionUtil::RegisterFunction(instance, GetOpenPromptAggFunction());
+
+    // Register settings
+    OpenPromptSettings::Register(DBConfig::GetConfig(instance));
+
+    ExtensionUtil::RegisterFunction(instance, TableFunction(
+        "open_prompt_cache_stats", {}, OpenPromptCacheStatsFunction, OpenPromptCacheStatsBind,
+        OpenPromptCacheStatsInit));
+    ExtensionUtil::RegisterFunction(instance, ScalarFunction(
+        "open_prompt_cache_clear", {}, LogicalType::VARCHAR, OpenPromptCacheClear));
+    ExtensionUtil::RegisterFunction(instance, TableFunction(
+        "open_prompt_stats", {}, OpenPromptStatsFunction, OpenPromptStatsBind, OpenPromptStatsInit));
+    ExtensionUtil::RegisterFunction(instance, ScalarFunction(
+        "open_prompt_stats_reset", {}, LogicalType::VARCHAR, OpenPromptStatsReset));
+    ExtensionUtil::RegisterFunction(instance, TableFunction(
+        "open_prompt_endpoint_stats", {}, OpenPromptEndpointStatsFunction, OpenPromptEndpointStatsBind,
+        OpenPromptEndpointStatsInit));
+    ExtensionUtil::RegisterFunction(instance, TableFunction(
+        "open_prompt_pool_stats", {}, OpenPromptPoolStatsFunction, OpenPromptPoolStatsBind,
+        OpenPromptPoolStatsInit));
+
     // Register setting functions
     ExtensionUtil::RegisterFunction(instance, ScalarFunction(
         "set_api_token", {LogicalType::VARCHAR}, LogicalType::VARCHAR, SetApiToken));
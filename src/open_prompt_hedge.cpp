@@ -0,0 +1,212 @@
+#include "open_prompt_hedge.hpp"
+
+#include <algorithm>
+
+namespace duckdb {
+
+//! New latencies before the delay is recomputed
+static constexpr idx_t DELAY_UPDATE_INTERVAL = 16;
+//! Requests after which the budget counters are halved
+static constexpr idx_t BUDGET_DECAY_INTERVAL = 10000;
+
+shared_ptr<OpenPromptHedgePolicy> OpenPromptHedgePolicy::Get(ClientContext &context, const string &url_list) {
+    auto &cache = ObjectCache::GetObjectCache(context);
+    return cache.GetOrCreate<OpenPromptHedgePolicy>(ObjectType() + ":" + url_list);
+}
+
+void OpenPromptHedgePolicy::Record(double latency_ms) {
+    lock_guard<mutex> guard(lock);
+    if (window.size() < WINDOW_SIZE) {
+        window.push_back(latency_ms);
+    } else {
+        window[next] = latency_ms;
+    }
+    next = (next + 1) % WINDOW_SIZE;
+    records_since_update++;
+}
+
+void OpenPromptHedgePolicy::RecordRequest() {
+    lock_guard<mutex> guard(lock);
+    requests++;
+    if (requests >= BUDGET_DECAY_INTERVAL) {
+        requests /= 2;
+        hedges /= 2;
+    }
+}
+
+double OpenPromptHedgePolicy::Delay(double percentile) {
+    lock_guard<mutex> guard(lock);
+    if (window.size() < MIN_SAMPLES) {
+        return -1;
+    }
+    if (records_since_update >= DELAY_UPDATE_INTERVAL || percentile != cached_percentile) {
+        auto sorted = window;
+        auto rank = static_cast<idx_t>(MinValue(MaxValue(percentile, 0.0), 100.0) / 100 *
+                                       static_cast<double>(sorted.size() - 1));
+        std::nth_element(sorted.begin(), sorted.begin() + NumericCast<int64_t>(rank), sorted.end());
+        cached_delay = sorted[rank];
+        cached_percentile = percentile;
+        records_since_update = 0;
+    }
+    return cached_delay;
+}
+
+bool OpenPromptHedgePolicy::TryHedge(double budget_percent) {
+    lock_guard<mutex> guard(lock);
+    if (static_cast<double>(hedges + 1) * 100 > budget_percent * static_cast<double>(requests)) {
+        return false;
+    }
+    hedges++;
+    return true;
+}
+
+bool OpenPromptHedgeRace::Register(idx_t attempt, duckdb_httplib_openssl::Client &client) {
+    lock_guard<mutex> guard(lock);
+    if (stopped[attempt]) {
+        return false;
+    }
+    clients[attempt] = &client;
+    return true;
+}
+
+bool OpenPromptHedgeRace::Unregister(idx_t attempt) {
+    lock_guard<mutex> guard(lock);
+    clients[attempt] = nullptr;
+    return stopped[attempt];
+}
+
+bool OpenPromptHedgeRace::Stopped(idx_t attempt) {
+    lock_guard<mutex> guard(lock);
+    return stopped[attempt];
+}
+
+bool OpenPromptHedgeRace::Finish(idx_t attempt, OpenPromptResponse *attempt_response) {
+    bool won = false;
+    {
+        lock_guard<mutex> guard(lock);
+        if (attempt_response && !decided) {
+            decided = true;
+            winner = attempt;
+            won = true;
+            if (attempt == HEDGE) {
+                response = std::move(*attempt_response);
+            }
+            // The other attempt is cut off, or never sent when it has not started yet
+            auto other = 1 - attempt;
+            stopped[other] = true;
+            if (clients[other]) {
+                clients[other]->stop();
+            }
+        }
+        finished[attempt] = true;
+    }
+    cv.notify_all();
+    return won;
+}
+
+bool OpenPromptHedgeRace::StartHedge() {
+    lock_guard<mutex> guard(lock);
+    hedge_running = hedge_pending && !finished[PRIMARY];
+    hedge_pending = false;
+    return hedge_running;
+}
+
+void OpenPromptHedgeRace::HedgeFinished() {
+    {
+        lock_guard<mutex> guard(lock);
+        hedge_running = false;
+    }
+    cv.notify_all();
+}
+
+void OpenPromptHedgeRace::CancelHedge() {
+    std::unique_lock<mutex> guard(lock);
+    hedge_pending = false;
+    cv.wait(guard, [&]() { return !hedge_running; });
+}
+
+bool OpenPromptHedgeRace::HedgeWon() {
+    lock_guard<mutex> guard(lock);
+    return decided && winner == HEDGE;
+}
+
+OpenPromptHedgeScheduler::~OpenPromptHedgeScheduler() {
+    {
+        lock_guard<mutex> guard(lock);
+        shutdown = true;
+    }
+    timer_wakeup.notify_all();
+    hedge_ready.notify_all();
+    if (timer_thread.joinable()) {
+        timer_thread.join();
+    }
+    for (auto &runner : runners) {
+        runner.join();
+    }
+}
+
+shared_ptr<OpenPromptHedgeScheduler> OpenPromptHedgeScheduler::Get(ClientContext &context) {
+    auto &cache = ObjectCache::GetObjectCache(context);
+    return cache.GetOrCreate<OpenPromptHedgeScheduler>(ObjectType());
+}
+
+void OpenPromptHedgeScheduler::Schedule(shared_ptr<OpenPromptHedgeRace> race, double delay_ms,
+                                        std::function<void()> hedge) {
+    auto deadline = steady_clock::now() + std::chrono::microseconds(static_cast<int64_t>(delay_ms * 1000));
+    {
+        lock_guard<mutex> guard(lock);
+        if (!timer_thread.joinable()) {
+            timer_thread = std::thread([this]() { TimerLoop(); });
+        }
+        timers.emplace(deadline, PendingHedge {std::move(race), std::move(hedge)});
+    }
+    timer_wakeup.notify_one();
+}
+
+void OpenPromptHedgeScheduler::TimerLoop() {
+    std::unique_lock<mutex> guard(lock);
+    while (!shutdown) {
+        if (timers.empty()) {
+            timer_wakeup.wait(guard);
+            continue;
+        }
+        auto next = timers.begin();
+        if (steady_clock::now() < next->first) {
+            timer_wakeup.wait_until(guard, next->first);
+            continue;
+        }
+        auto pending = std::move(next->second);
+        timers.erase(next);
+        // Hedges of primaries that finished within the delay are dropped here, without ever using a runner
+        if (!pending.race->StartHedge()) {
+            continue;
+        }
+        ready.push_back(std::move(pending));
+        if (idle_runners == 0) {
+            runners.emplace_back([this]() { RunnerLoop(); });
+            idle_runners++;
+        }
+        hedge_ready.notify_one();
+    }
+}
+
+void OpenPromptHedgeScheduler::RunnerLoop() {
+    std::unique_lock<mutex> guard(lock);
+    while (true) {
+        hedge_ready.wait(guard, [&]() { return shutdown || !ready.empty(); });
+        if (ready.empty()) {
+            return;
+        }
+        auto pending = std::move(ready.front());
+        ready.pop_front();
+        idle_runners--;
+        guard.unlock();
+        pending.hedge();
+        pending.race->HedgeFinished();
+        pending.race.reset();
+        guard.lock();
+        idle_runners++;
+    }
+}
+
+} // namespace duckdb
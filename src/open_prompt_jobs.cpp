@@ -0,0 +1,567 @@
+#include "open_prompt_jobs.hpp"
+#include "open_prompt_sender.hpp"
+#include "open_prompt_settings.hpp"
+
+#include "duckdb/catalog/catalog.hpp"
+#include "duckdb/catalog/catalog_entry/table_catalog_entry.hpp"
+#include "duckdb/common/error_data.hpp"
+#include "duckdb/common/exception/binder_exception.hpp"
+#include "duckdb/common/string_util.hpp"
+#include "duckdb/common/types/timestamp.hpp"
+#include "duckdb/common/vector_operations/unary_executor.hpp"
+#include "duckdb/main/appender.hpp"
+#include "duckdb/main/connection.hpp"
+#include "duckdb/parser/keyword_helper.hpp"
+#include "duckdb/parser/parser.hpp"
+#include "duckdb/parser/statement/select_statement.hpp"
+#include "duckdb/parser/tableref/subqueryref.hpp"
+#include "duckdb/storage/object_cache.hpp"
+
+#include <thread>
+
+namespace duckdb {
+
+//! A job submitted in this process
+struct OpenPromptJob {
+    string job_id;
+    string model_name;
+    string json_schema;
+    string system_prompt;
+    idx_t total_rows = 0;
+    //! Settings and variables of the submitting connection, the API token is only ever kept here
+    case_insensitive_map_t<Value> set_variables;
+    case_insensitive_map_t<Value> user_variables;
+    atomic<bool> running {true};
+    atomic<bool> cancelled {false};
+
+    //! Make the worker's connection known, so that a cancel can interrupt the requests in flight
+    void Attach(ClientContext &context_p) {
+        lock_guard<mutex> guard(lock);
+        context = &context_p;
+    }
+    void Detach() {
+        lock_guard<mutex> guard(lock);
+        context = nullptr;
+    }
+    void Cancel() {
+        lock_guard<mutex> guard(lock);
+        cancelled = true;
+        if (context) {
+            context->interrupted = true;
+        }
+    }
+    void SetError(const string &message) {
+        lock_guard<mutex> guard(lock);
+        error = message;
+    }
+    string GetError() {
+        lock_guard<mutex> guard(lock);
+        return error;
+    }
+
+private:
+    mutex lock;
+    optional_ptr<ClientContext> context;
+    //! Why the worker stopped, empty unless it failed
+    string error;
+};
+
+struct OpenPromptJobState {
+    string job_id;
+    string state;
+    string error;
+};
+
+//! The jobs submitted in this process, keyed by job id. Every job runs on a thread owned by the manager that only
+//! holds a weak reference to the database between batches. Closing the database destroys the manager, which cancels
+//! the jobs and joins their threads
+class OpenPromptJobManager : public ObjectCacheEntry {
+public:
+    ~OpenPromptJobManager() override;
+
+    static string ObjectType() {
+        return "open_prompt_job_manager";
+    }
+    string GetObjectType() override {
+        return ObjectType();
+    }
+
+    static shared_ptr<OpenPromptJobManager> Get(ClientContext &context) {
+        auto &cache = ObjectCache::GetObjectCache(context);
+        return cache.GetOrCreate<OpenPromptJobManager>(ObjectType());
+    }
+
+    bool IsRunning(const string &job_id) {
+        lock_guard<mutex> guard(lock);
+        auto entry = jobs.find(job_id);
+        return entry != jobs.end() && entry->second->running;
+    }
+    //! Start a job that is not running, the thread of a previous run of it is joined first
+    void Start(DatabaseInstance &db, shared_ptr<OpenPromptJob> job);
+    //! Returns false when the job is not running
+    bool Cancel(const string &job_id) {
+        lock_guard<mutex> guard(lock);
+        auto entry = jobs.find(job_id);
+        if (entry == jobs.end() || !entry->second->running) {
+            return false;
+        }
+        entry->second->Cancel();
+        return true;
+    }
+    vector<OpenPromptJobState> GetStates() {
+        lock_guard<mutex> guard(lock);
+        vector<OpenPromptJobState> result;
+        for (auto &entry : jobs) {
+            auto &job = *entry.second;
+            OpenPromptJobState state;
+            state.job_id = job.job_id;
+            state.error = job.GetError();
+            if (job.running) {
+                state.state = job.cancelled ? "cancelling" : "running";
+            } else {
+                state.state = job.cancelled ? "cancelled" : state.error.empty() ? "finished" : "failed";
+            }
+            result.push_back(std::move(state));
+        }
+        return result;
+    }
+
+    //! Held while a job is set up, so that the same job is never submitted twice at once
+    mutex submit_lock;
+
+private:
+    mutex lock;
+    unordered_map<string, shared_ptr<OpenPromptJob>> jobs;
+    unordered_map<string, std::thread> threads;
+};
+
+//! Run a statement on `con`, throwing its error
+static unique_ptr<MaterializedResult> RunQuery(Connection &con, const string &sql, vector<Value> params = {}) {
+    auto prepared = con.Prepare(sql);
+    if (prepared->HasError()) {
+        prepared->error.Throw();
+    }
+    auto result = prepared->Execute(params, false);
+    if (result->HasError()) {
+        result->ThrowError();
+    }
+    return unique_ptr_cast<QueryResult, MaterializedResult>(std::move(result));
+}
+
+static void CreateJobTables(Connection &con) {
+    RunQuery(con, "CREATE TABLE IF NOT EXISTS open_prompt_jobs(job_id VARCHAR, source_table VARCHAR, "
+                  "source_column VARCHAR, model VARCHAR, json_schema VARCHAR, system_prompt VARCHAR, "
+                  "total_rows BIGINT, submitted_at TIMESTAMP)");
+    RunQuery(con, "CREATE TABLE IF NOT EXISTS open_prompt_job_inputs(job_id VARCHAR, row_id BIGINT, "
+                  "source_key VARCHAR, prompt VARCHAR)");
+    RunQuery(con, "CREATE TABLE IF NOT EXISTS open_prompt_job_results(job_id VARCHAR, row_id BIGINT, "
+                  "success BOOLEAN, response VARCHAR, completed_at TIMESTAMP)");
+}
+
+static bool JobTablesExist(ClientContext &context) {
+    for (auto name : {"open_prompt_jobs", "open_prompt_job_inputs", "open_prompt_job_results"}) {
+        if (!Catalog::GetEntry<TableCatalogEntry>(context, INVALID_CATALOG, INVALID_SCHEMA, name,
+                                                  OnEntryNotFound::RETURN_NULL)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static string QuoteLiteral(const string &str) {
+    return KeywordHelper::WriteQuoted(str, '\'');
+}
+
+//! Quote every part of a possibly qualified name
+static string QuoteName(const string &name) {
+    string result;
+    for (auto &part : StringUtil::Split(name, '.')) {
+        if (!result.empty()) {
+            result += '.';
+        }
+        result += KeywordHelper::WriteOptionallyQuoted(part);
+    }
+    return result;
+}
+
+//! Send the rows of the job from row id `begin` on that have no result yet, until a batch of row ids with such rows
+//! was completed. The batch is committed right away, which is what allows a job to resume. Returns the row id the
+//! next batch starts at
+static idx_t ProcessBatch(Connection &con, OpenPromptJob &job, idx_t begin) {
+    auto &context = *con.context;
+    auto api_url = OpenPromptSettings::GetVariable(context, "openprompt_api_url",
+                                                   "http://localhost:11434/v1/chat/completions");
+    auto api_token = OpenPromptSettings::GetVariable(context, "openprompt_api_token", "");
+    auto batch_size = MaxValue<idx_t>(OpenPromptSettings::GetUBigInt(context, "openprompt_job_batch_size", 1024), 1);
+    auto request_template = OpenPromptRequestTemplate::Create(job.model_name, job.json_schema, job.system_prompt);
+
+    auto select = con.Prepare("SELECT row_id, prompt FROM open_prompt_job_inputs WHERE job_id = $1 AND row_id >= $2 "
+                              "AND row_id < $3 AND row_id NOT IN (SELECT row_id FROM open_prompt_job_results "
+                              "WHERE job_id = $1 AND row_id >= $2 AND row_id < $3) ORDER BY row_id");
+    if (select->HasError()) {
+        select->error.Throw();
+    }
+    string request_body;
+    for (; begin < job.total_rows && !job.cancelled; begin += batch_size) {
+        vector<Value> params {Value(job.job_id), Value::BIGINT(NumericCast<int64_t>(begin)),
+                              Value::BIGINT(NumericCast<int64_t>(begin + batch_size))};
+        auto result = select->Execute(params, false);
+        if (result->HasError()) {
+            result->ThrowError();
+        }
+        auto &rows = result->Cast<MaterializedResult>();
+        if (rows.RowCount() == 0) {
+            continue;
+        }
+
+        // Identical prompts within the batch are sent once, rows with a NULL prompt get a NULL response
+        OpenPromptSender sender(context, api_url, api_token);
+        vector<idx_t> row_requests(rows.RowCount(), DConstants::INVALID_INDEX);
+        vector<OpenPromptRequest> requests;
+        unordered_map<string, idx_t> request_lookup;
+        for (idx_t row = 0; row < rows.RowCount(); row++) {
+            auto prompt = rows.GetValue(1, row);
+            if (prompt.IsNull()) {
+                continue;
+            }
+            auto &prompt_str = StringValue::Get(prompt);
+            request_template.Render(prompt_str.c_str(), prompt_str.size(), request_body, sender.Streaming());
+            auto lookup = request_lookup.find(request_body);
+            if (lookup != request_lookup.end()) {
+                row_requests[row] = lookup->second;
+                continue;
+            }
+            row_requests[row] = requests.size();
+            request_lookup.emplace(request_body, requests.size());
+            requests.emplace_back();
+            requests.back().body = request_body;
+            if (sender.NeedsPrompts()) {
+                requests.back().prompt = prompt_str;
+            }
+        }
+        sender.Send(requests, job.model_name, job.json_schema, job.system_prompt);
+        if (job.cancelled) {
+            // Requests cut short by the cancel are not recorded, they are sent again when the job is resumed
+            break;
+        }
+
+        Appender appender(con, "open_prompt_job_results");
+        auto completed_at = Value::TIMESTAMP(Timestamp::GetCurrentTimestamp());
+        for (idx_t row = 0; row < rows.RowCount(); row++) {
+            appender.BeginRow();
+            appender.Append(Value(job.job_id));
+            appender.Append(rows.GetValue(0, row));
+            if (row_requests[row] == DConstants::INVALID_INDEX) {
+                appender.Append(Value::BOOLEAN(true));
+                appender.Append(Value(LogicalType::VARCHAR));
+            } else {
+                auto &request = requests[row_requests[row]];
+                appender.Append(Value::BOOLEAN(request.success));
+                appender.Append(Value(request.response));
+            }
+            appender.Append(completed_at);
+            appender.EndRow();
+        }
+        appender.Close();
+        return begin + batch_size;
+    }
+    return begin;
+}
+
+static void RunJob(weak_ptr<DatabaseInstance> weak_db, shared_ptr<OpenPromptJob> job) {
+    try {
+        // The database is only held while a batch runs, so that closing it is not held up by the job
+        idx_t begin = 0;
+        while (begin < job->total_rows && !job->cancelled) {
+            auto db = weak_db.lock();
+            if (!db) {
+                break;
+            }
+            Connection con(*db);
+            auto &config = ClientConfig::GetConfig(*con.context);
+            config.set_variables = job->set_variables;
+            config.user_variables = job->user_variables;
+            // Detached before the connection is destroyed, also when the job fails
+            struct DetachGuard {
+                OpenPromptJob &job;
+                ~DetachGuard() {
+                    job.Detach();
+                }
+            } guard {*job};
+            job->Attach(*con.context);
+            begin = ProcessBatch(con, *job, begin);
+        }
+    } catch (std::exception &e) {
+        if (!job->cancelled) {
+            job->SetError(ErrorData(e).Message());
+        }
+    }
+    job->running = false;
+}
+
+OpenPromptJobManager::~OpenPromptJobManager() {
+    for (auto &entry : jobs) {
+        entry.second->Cancel();
+    }
+    for (auto &entry : threads) {
+        if (entry.second.get_id() == std::this_thread::get_id()) {
+            // The database was closed while this job ran its last batch, the thread ends right after
+            entry.second.detach();
+        } else if (entry.second.joinable()) {
+            entry.second.join();
+        }
+    }
+}
+
+void OpenPromptJobManager::Start(DatabaseInstance &db, shared_ptr<OpenPromptJob> job) {
+    lock_guard<mutex> guard(lock);
+    auto &thread = threads[job->job_id];
+    if (thread.joinable()) {
+        thread.join();
+    }
+    jobs[job->job_id] = job;
+    thread = std::thread(RunJob, weak_ptr<DatabaseInstance>(db.shared_from_this()), std::move(job));
+}
+
+// open_prompt_submit table function
+struct OpenPromptSubmitData : public TableFunctionData {
+    string job_id;
+    string source_table;
+    string source_column;
+    //! Column identifying the source rows in open_prompt_collect, the rowid by default
+    string source_key;
+    string model_name;
+    string json_schema;
+    string system_prompt;
+};
+
+struct OpenPromptSubmitState : public GlobalTableFunctionState {
+    bool finished = false;
+};
+
+static unique_ptr<FunctionData> OpenPromptSubmitBind(ClientContext &context, TableFunctionBindInput &input,
+                                                     vector<LogicalType> &return_types, vector<string> &names) {
+    auto res = make_uniq<OpenPromptSubmitData>();
+    if (input.inputs[0].IsNull() || input.inputs[1].IsNull()) {
+        throw BinderException("open_prompt_submit requires a table and a column name");
+    }
+    res->source_table = input.inputs[0].ToString();
+    res->source_column = input.inputs[1].ToString();
+    res->job_id = res->source_table + "." + res->source_column;
+    res->source_key = "rowid";
+    res->model_name = OpenPromptSettings::GetVariable(context, "openprompt_model_name", "qwen2.5:0.5b");
+    for (auto &kv : input.named_parameters) {
+        if (kv.second.IsNull()) {
+            continue;
+        }
+        if (kv.first == "job") {
+            res->job_id = kv.second.ToString();
+        } else if (kv.first == "key") {
+            res->source_key = kv.second.ToString();
+        } else if (kv.first == "model") {
+            res->model_name = kv.second.ToString();
+        } else if (kv.first == "json_schema") {
+            res->json_schema = kv.second.ToString();
+        } else if (kv.first == "system_prompt") {
+            res->system_prompt = kv.second.ToString();
+        }
+    }
+    names.emplace_back("job_id");
+    return_types.emplace_back(LogicalType::VARCHAR);
+    names.emplace_back("state");
+    return_types.emplace_back(LogicalType::VARCHAR);
+    names.emplace_back("total_rows");
+    return_types.emplace_back(LogicalType::BIGINT);
+    names.emplace_back("completed_rows");
+    return_types.emplace_back(LogicalType::BIGINT);
+    return std::move(res);
+}
+
+//! Completed rows are the rows answered successfully, as reported by open_prompt_status. Failed rows are counted
+//! separately and sent again by the next submit
+static const char *const COMPLETED_ROWS_QUERY =
+    "SELECT count(*) FILTER (WHERE success) FROM open_prompt_job_results WHERE job_id = $1";
+
+static unique_ptr<GlobalTableFunctionState> OpenPromptSubmitInit(ClientContext &context,
+                                                                 TableFunctionInitInput &input) {
+    return make_uniq<OpenPromptSubmitState>();
+}
+
+static void OpenPromptSubmitFunction(ClientContext &context, TableFunctionInput &data_p, DataChunk &output) {
+    auto &state = data_p.global_state->Cast<OpenPromptSubmitState>();
+    if (state.finished) {
+        output.SetCardinality(0);
+        return;
+    }
+    state.finished = true;
+    auto &bind_data = data_p.bind_data->Cast<OpenPromptSubmitData>();
+    auto &db = DatabaseInstance::GetDatabase(context);
+    auto manager = OpenPromptJobManager::Get(context);
+    lock_guard<mutex> submit_guard(manager->submit_lock);
+
+    auto emit = [&](const string &job_state, idx_t total_rows, idx_t completed_rows) {
+        output.SetValue(0, 0, Value(bind_data.job_id));
+        output.SetValue(1, 0, Value(job_state));
+        output.SetValue(2, 0, Value::BIGINT(NumericCast<int64_t>(total_rows)));
+        output.SetValue(3, 0, Value::BIGINT(NumericCast<int64_t>(completed_rows)));
+        output.SetCardinality(1);
+    };
+
+    // The job tables are written by their own connections, committed independently of the submitting query
+    Connection con(db);
+    CreateJobTables(con);
+    auto job = make_shared_ptr<OpenPromptJob>();
+    job->job_id = bind_data.job_id;
+    auto existing = RunQuery(con,
+                             "SELECT source_table, source_column, model, json_schema, system_prompt, total_rows "
+                             "FROM open_prompt_jobs WHERE job_id = $1",
+                             {Value(job->job_id)});
+    if (existing->RowCount() > 0) {
+        // A resumed job keeps the prompts and options it was submitted with
+        if (existing->GetValue(0, 0).ToString() != bind_data.source_table ||
+            existing->GetValue(1, 0).ToString() != bind_data.source_column) {
+            throw InvalidInputException("open_prompt_submit: job \"%s\" was submitted for %s.%s, pass another job name",
+                                        job->job_id, existing->GetValue(0, 0).ToString(),
+                                        existing->GetValue(1, 0).ToString());
+        }
+        job->model_name = existing->GetValue(2, 0).ToString();
+        job->json_schema = existing->GetValue(3, 0).ToString();
+        job->system_prompt = existing->GetValue(4, 0).ToString();
+        job->total_rows = existing->GetValue(5, 0).GetValue<int64_t>();
+        if (manager->IsRunning(job->job_id)) {
+            auto completed = RunQuery(con, COMPLETED_ROWS_QUERY, {Value(job->job_id)});
+            emit("running", job->total_rows, completed->GetValue(0, 0).GetValue<int64_t>());
+            return;
+        }
+        // Rows that failed before are sent again
+        RunQuery(con, "DELETE FROM open_prompt_job_results WHERE job_id = $1 AND NOT success", {Value(job->job_id)});
+    } else {
+        job->model_name = bind_data.model_name;
+        job->json_schema = bind_data.json_schema;
+        job->system_prompt = bind_data.system_prompt;
+        con.BeginTransaction();
+        try {
+            auto inserted = RunQuery(con,
+                                     "INSERT INTO open_prompt_job_inputs SELECT $1, row_number() OVER () - 1, CAST(" +
+                                         QuoteName(bind_data.source_key) + " AS VARCHAR), CAST(" +
+                                         QuoteName(bind_data.source_column) + " AS VARCHAR) FROM " +
+                                         QuoteName(bind_data.source_table),
+                                     {Value(job->job_id)});
+            job->total_rows = inserted->GetValue(0, 0).GetValue<int64_t>();
+            RunQuery(con, "INSERT INTO open_prompt_jobs VALUES ($1, $2, $3, $4, $5, $6, $7, current_timestamp)",
+                     {Value(job->job_id), Value(bind_data.source_table), Value(bind_data.source_column),
+                      Value(job->model_name), Value(job->json_schema), Value(job->system_prompt),
+                      Value::BIGINT(NumericCast<int64_t>(job->total_rows))});
+            con.Commit();
+        } catch (...) {
+            if (con.HasActiveTransaction()) {
+                con.Rollback();
+            }
+            throw;
+        }
+    }
+
+    auto completed = RunQuery(con, COMPLETED_ROWS_QUERY, {Value(job->job_id)});
+    idx_t completed_rows = completed->GetValue(0, 0).GetValue<int64_t>();
+    if (completed_rows >= job->total_rows) {
+        emit("finished", job->total_rows, completed_rows);
+        return;
+    }
+    auto &client_config = ClientConfig::GetConfig(context);
+    job->set_variables = client_config.set_variables;
+    job->user_variables = client_config.user_variables;
+    manager->Start(db, job);
+    emit("running", job->total_rows, completed_rows);
+}
+
+TableFunction GetOpenPromptSubmitFunction() {
+    TableFunction function("open_prompt_submit", {LogicalType::VARCHAR, LogicalType::VARCHAR},
+                           OpenPromptSubmitFunction, OpenPromptSubmitBind, OpenPromptSubmitInit);
+    function.named_parameters["job"] = LogicalType::VARCHAR;
+    function.named_parameters["key"] = LogicalType::VARCHAR;
+    function.named_parameters["model"] = LogicalType::VARCHAR;
+    function.named_parameters["json_schema"] = LogicalType::VARCHAR;
+    function.named_parameters["system_prompt"] = LogicalType::VARCHAR;
+    return function;
+}
+
+//! Parse a SELECT into the subquery a table function is replaced with
+static unique_ptr<TableRef> ParseSubquery(const string &sql) {
+    Parser parser;
+    parser.ParseQuery(sql);
+    D_ASSERT(parser.statements.size() == 1);
+    auto select = unique_ptr_cast<SQLStatement, SelectStatement>(std::move(parser.statements[0]));
+    return make_uniq<SubqueryRef>(std::move(select));
+}
+
+// open_prompt_status table function
+static unique_ptr<TableRef> OpenPromptStatusBindReplace(ClientContext &context, TableFunctionBindInput &input) {
+    if (!JobTablesExist(context)) {
+        return ParseSubquery("SELECT NULL::VARCHAR AS job_id, NULL::VARCHAR AS source_table, "
+                             "NULL::VARCHAR AS source_column, NULL::VARCHAR AS model, NULL::VARCHAR AS state, "
+                             "NULL::BIGINT AS total_rows, NULL::BIGINT AS completed_rows, "
+                             "NULL::BIGINT AS failed_rows, NULL::VARCHAR AS error, "
+                             "NULL::TIMESTAMP AS submitted_at, NULL::TIMESTAMP AS last_completed_at WHERE false");
+    }
+    // Jobs of this process report their own state, the others were interrupted unless every row has a result
+    string states = "SELECT NULL::VARCHAR AS job_id, NULL::VARCHAR AS state, NULL::VARCHAR AS error WHERE false";
+    for (auto &job_state : OpenPromptJobManager::Get(context)->GetStates()) {
+        states += " UNION ALL SELECT " + QuoteLiteral(job_state.job_id) + ", " + QuoteLiteral(job_state.state) +
+                  ", " + (job_state.error.empty() ? string("NULL") : QuoteLiteral(job_state.error));
+    }
+    return ParseSubquery(
+        "SELECT j.job_id, j.source_table, j.source_column, j.model, "
+        "coalesce(s.state, CASE WHEN coalesce(r.completed_rows + r.failed_rows, 0) >= j.total_rows "
+        "THEN 'finished' ELSE 'interrupted' END) AS state, j.total_rows, "
+        "coalesce(r.completed_rows, 0) AS completed_rows, coalesce(r.failed_rows, 0) AS failed_rows, s.error, "
+        "j.submitted_at, r.last_completed_at "
+        "FROM open_prompt_jobs j "
+        "LEFT JOIN (SELECT job_id, count(*) FILTER (WHERE success) AS completed_rows, "
+        "count(*) FILTER (WHERE NOT success) AS failed_rows, max(completed_at) AS last_completed_at "
+        "FROM open_prompt_job_results GROUP BY job_id) r USING (job_id) "
+        "LEFT JOIN (" + states + ") s USING (job_id) ORDER BY j.submitted_at");
+}
+
+TableFunction GetOpenPromptStatusFunction() {
+    TableFunction function("open_prompt_status", {}, nullptr);
+    function.bind_replace = OpenPromptStatusBindReplace;
+    return function;
+}
+
+// open_prompt_collect table function
+static unique_ptr<TableRef> OpenPromptCollectBindReplace(ClientContext &context, TableFunctionBindInput &input) {
+    if (input.inputs[0].IsNull()) {
+        throw BinderException("open_prompt_collect requires a job name");
+    }
+    if (!JobTablesExist(context)) {
+        throw BinderException("open_prompt_collect: no job was submitted, see open_prompt_submit");
+    }
+    return ParseSubquery("SELECT i.row_id, i.source_key AS key, i.prompt, r.response, r.success, r.completed_at "
+                         "FROM open_prompt_job_inputs i JOIN open_prompt_job_results r USING (job_id, row_id) "
+                         "WHERE i.job_id = " +
+                         QuoteLiteral(input.inputs[0].ToString()));
+}
+
+TableFunction GetOpenPromptCollectFunction() {
+    TableFunction function("open_prompt_collect", {LogicalType::VARCHAR}, nullptr);
+    function.bind_replace = OpenPromptCollectBindReplace;
+    return function;
+}
+
+static void OpenPromptCancelFunction(DataChunk &args, ExpressionState &state, Vector &result) {
+    auto manager = OpenPromptJobManager::Get(state.GetContext());
+    UnaryExecutor::Execute<string_t, string_t>(args.data[0], result, args.size(), [&](string_t job_id) {
+        auto job_str = job_id.GetString();
+        if (!manager->Cancel(job_str)) {
+            return StringVector::AddString(result, "Job " + job_str + " is not running.");
+        }
+        return StringVector::AddString(result, "Cancelling job " + job_str + ", completed rows are kept.");
+    });
+}
+
+ScalarFunction GetOpenPromptCancelFunction() {
+    return ScalarFunction("open_prompt_cancel", {LogicalType::VARCHAR}, LogicalType::VARCHAR,
+                          OpenPromptCancelFunction);
+}
+
+} // namespace duckdb
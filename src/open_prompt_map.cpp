@@ -0,0 +1,334 @@
+#include "open_prompt_map.hpp"
+#include "open_prompt_sender.hpp"
+#include "open_prompt_settings.hpp"
+
+#include "duckdb/common/exception/binder_exception.hpp"
+#include "duckdb/common/string_util.hpp"
+#include "duckdb/common/vector_operations/vector_operations.hpp"
+
+#include <condition_variable>
+#include <deque>
+
+namespace duckdb {
+
+struct OpenPromptMapData : public TableFunctionData {
+    //! Index of the prompt column in the input table
+    idx_t prompt_idx;
+    idx_t input_column_count;
+    string api_url;
+    string api_token;
+    string model_name;
+    string json_schema;
+    string system_prompt;
+    OpenPromptRequestTemplate request_template;
+    //! openprompt_null_on_error: failed rows are NULL instead of the error message
+    bool null_on_error = false;
+};
+
+//! A row of the input whose request is queued, in flight or completed
+struct OpenPromptMapRow {
+    //! The input chunk the row came from, kept alive until every row of it was emitted
+    shared_ptr<DataChunk> chunk;
+    idx_t row;
+    bool is_null = false;
+    OpenPromptRequest request;
+};
+
+//! Per-thread state: the rows of the input chunks seen so far, sent by tasks on the database's worker pool
+struct OpenPromptMapLocalState : public LocalTableFunctionState {
+    OpenPromptMapLocalState(ClientContext &context, const OpenPromptMapData &bind_data, idx_t window_p)
+        : sender(context, bind_data.api_url, bind_data.api_token), worker_pool(OpenPromptWorkerPool::Get(context)),
+          window(window_p) {
+    }
+    ~OpenPromptMapLocalState() override {
+        // Tasks hold on to this state, queued rows are abandoned and the requests in flight are waited for
+        std::unique_lock<mutex> guard(lock);
+        shutdown = true;
+        cv.wait(guard, [&]() { return senders == 0; });
+    }
+
+    //! Queue a request for every row of `input`, rows with a NULL prompt complete immediately
+    void Enqueue(ClientContext &context, const OpenPromptMapData &bind_data, DataChunk &input);
+    //! Block until a full vector of rows completed, or, unless draining, until the window has room for more input.
+    //! Returns false when draining and nothing is left to wait for
+    bool Wait(bool draining);
+    //! Move up to a vector of completed rows into `output`
+    void Emit(const OpenPromptMapData &bind_data, DataChunk &output);
+    //! Whether the queue is short enough to accept the next input chunk
+    bool HasRoom() {
+        lock_guard<mutex> guard(lock);
+        return queued.size() < window;
+    }
+
+    OpenPromptSender sender;
+    shared_ptr<OpenPromptWorkerPool> worker_pool;
+    idx_t window;
+    //! Whether the current input chunk has already been queued, the same chunk is passed again after
+    //! HAVE_MORE_OUTPUT
+    bool input_consumed = false;
+
+private:
+    //! Send queued rows until none are left, runs as a task on the worker pool
+    void SendQueued();
+
+    mutex lock;
+    //! Signalled whenever a row completes or a task exits
+    std::condition_variable cv;
+    std::deque<unique_ptr<OpenPromptMapRow>> queued;
+    std::deque<unique_ptr<OpenPromptMapRow>> completed;
+    idx_t in_flight = 0;
+    //! Tasks of this state submitted to the worker pool that have not exited yet, at most `window`
+    idx_t senders = 0;
+    bool shutdown = false;
+};
+
+void OpenPromptMapLocalState::Enqueue(ClientContext &context, const OpenPromptMapData &bind_data, DataChunk &input) {
+    auto chunk = make_shared_ptr<DataChunk>();
+    chunk->Initialize(Allocator::Get(context), input.GetTypes(), MaxValue<idx_t>(input.size(), 1));
+    input.Copy(*chunk);
+
+    UnifiedVectorFormat prompt_data;
+    chunk->data[bind_data.prompt_idx].ToUnifiedFormat(chunk->size(), prompt_data);
+    auto prompt_entries = UnifiedVectorFormat::GetData<string_t>(prompt_data);
+
+    // Prompts over the input token budget are cut or rejected before anything is sent, as in open_prompt
+    auto &token_budget = sender.TokenBudget();
+    idx_t system_tokens = 0;
+    idx_t prompt_budget = 0;
+    if (token_budget.Enabled()) {
+        system_tokens = token_budget.estimator.Estimate(bind_data.system_prompt);
+        prompt_budget = token_budget.max_input_tokens > system_tokens ? token_budget.max_input_tokens - system_tokens
+                                                                       : 0;
+    }
+
+    vector<unique_ptr<OpenPromptMapRow>> rows;
+    rows.reserve(chunk->size());
+    for (idx_t i = 0; i < chunk->size(); i++) {
+        auto row = make_uniq<OpenPromptMapRow>();
+        row->chunk = chunk;
+        row->row = i;
+        auto prompt_idx = prompt_data.sel->get_index(i);
+        if (!prompt_data.validity.RowIsValid(prompt_idx)) {
+            row->is_null = true;
+        } else {
+            auto &user_prompt = prompt_entries[prompt_idx];
+            auto prompt = user_prompt.GetData();
+            idx_t prompt_size = user_prompt.GetSize();
+            auto prompt_tokens = token_budget.Enabled() ? token_budget.estimator.Estimate(prompt, prompt_size) : 0;
+            if (prompt_tokens > prompt_budget && token_budget.overflow == OpenPromptOverflowMode::REJECT) {
+                row->request.completed = true;
+                row->request.response =
+                    StringUtil::Format("Error: Prompt of about %d tokens exceeds openprompt_max_input_tokens (%d)",
+                                       system_tokens + prompt_tokens, token_budget.max_input_tokens);
+                rows.push_back(std::move(row));
+                continue;
+            }
+            if (prompt_tokens > prompt_budget) {
+                prompt_size = token_budget.estimator.TruncateLength(prompt, prompt_size, prompt_budget);
+            }
+            bind_data.request_template.Render(prompt, prompt_size, row->request.body, sender.Streaming());
+            if (sender.NeedsPrompts()) {
+                row->request.prompt = string(prompt, prompt_size);
+            }
+        }
+        rows.push_back(std::move(row));
+    }
+
+    {
+        lock_guard<mutex> guard(lock);
+        for (auto &row : rows) {
+            if (row->is_null || row->request.completed) {
+                completed.push_back(std::move(row));
+            } else {
+                queued.push_back(std::move(row));
+            }
+        }
+        // A task keeps taking queued rows, so a small input never occupies the whole window
+        while (senders < window && senders < queued.size()) {
+            senders++;
+            worker_pool->Submit([this]() { SendQueued(); });
+        }
+    }
+    cv.notify_all();
+}
+
+void OpenPromptMapLocalState::SendQueued() {
+    while (true) {
+        unique_ptr<OpenPromptMapRow> row;
+        {
+            lock_guard<mutex> guard(lock);
+            if (shutdown || queued.empty()) {
+                senders--;
+                // Notified under the lock, the destructor may free the state as soon as it is released
+                cv.notify_all();
+                return;
+            }
+            row = std::move(queued.front());
+            queued.pop_front();
+            in_flight++;
+        }
+        // Never throws, failures are recorded in the response
+        sender.SendRequest(row->request);
+        {
+            lock_guard<mutex> guard(lock);
+            in_flight--;
+            completed.push_back(std::move(row));
+        }
+        cv.notify_all();
+    }
+}
+
+bool OpenPromptMapLocalState::Wait(bool draining) {
+    std::unique_lock<mutex> guard(lock);
+    cv.wait(guard, [&]() {
+        if (completed.size() >= STANDARD_VECTOR_SIZE) {
+            return true;
+        }
+        if (draining) {
+            return queued.empty() && in_flight == 0;
+        }
+        return queued.size() < window;
+    });
+    return !completed.empty() || !queued.empty() || in_flight > 0;
+}
+
+void OpenPromptMapLocalState::Emit(const OpenPromptMapData &bind_data, DataChunk &output) {
+    vector<unique_ptr<OpenPromptMapRow>> rows;
+    {
+        lock_guard<mutex> guard(lock);
+        while (!completed.empty() && rows.size() < STANDARD_VECTOR_SIZE) {
+            rows.push_back(std::move(completed.front()));
+            completed.pop_front();
+        }
+    }
+    // String heap writes are not thread safe, only the executing thread writes the output.
+    // Consecutive rows of the same input chunk are copied column by column through a selection vector
+    SelectionVector sel(STANDARD_VECTOR_SIZE);
+    for (idx_t run_start = 0; run_start < rows.size();) {
+        auto &chunk = *rows[run_start]->chunk;
+        idx_t run_end = run_start;
+        while (run_end < rows.size() && rows[run_end]->chunk.get() == &chunk) {
+            sel.set_index(run_end - run_start, rows[run_end]->row);
+            run_end++;
+        }
+        for (idx_t col_idx = 0; col_idx < bind_data.input_column_count; col_idx++) {
+            VectorOperations::Copy(chunk.data[col_idx], output.data[col_idx], sel, run_end - run_start, 0,
+                                   run_start);
+        }
+        run_start = run_end;
+    }
+    auto &response_vector = output.data[bind_data.input_column_count];
+    auto response_data = FlatVector::GetData<string_t>(response_vector);
+    for (idx_t out_idx = 0; out_idx < rows.size(); out_idx++) {
+        auto &row = *rows[out_idx];
+        if (row.is_null || (!row.request.success && bind_data.null_on_error)) {
+            FlatVector::SetNull(response_vector, out_idx, true);
+        } else {
+            response_data[out_idx] = StringVector::AddString(response_vector, row.request.response);
+        }
+    }
+    output.SetCardinality(rows.size());
+}
+
+static unique_ptr<FunctionData> OpenPromptMapBind(ClientContext &context, TableFunctionBindInput &input,
+                                                  vector<LogicalType> &return_types, vector<string> &names) {
+    auto res = make_uniq<OpenPromptMapData>();
+    if (input.inputs.size() < 2 || input.inputs[1].IsNull()) {
+        throw BinderException("open_prompt_map requires the name of the prompt column");
+    }
+    auto column_name = input.inputs[1].ToString();
+    res->prompt_idx = DConstants::INVALID_INDEX;
+    for (idx_t i = 0; i < input.input_table_names.size(); i++) {
+        if (StringUtil::CIEquals(input.input_table_names[i], column_name)) {
+            res->prompt_idx = i;
+            break;
+        }
+    }
+    if (res->prompt_idx == DConstants::INVALID_INDEX) {
+        throw BinderException("open_prompt_map: column \"%s\" not found in the input table", column_name);
+    }
+    if (input.input_table_types[res->prompt_idx].id() != LogicalTypeId::VARCHAR) {
+        throw BinderException("open_prompt_map: column \"%s\" must be of type VARCHAR", column_name);
+    }
+
+    res->api_url = OpenPromptSettings::GetVariable(context, "openprompt_api_url",
+                                                   "http://localhost:11434/v1/chat/completions");
+    res->api_token = OpenPromptSettings::GetVariable(context, "openprompt_api_token", "");
+    res->model_name = OpenPromptSettings::GetVariable(context, "openprompt_model_name", "qwen2.5:0.5b");
+    for (auto &kv : input.named_parameters) {
+        if (kv.second.IsNull()) {
+            continue;
+        }
+        if (kv.first == "model") {
+            res->model_name = kv.second.ToString();
+        } else if (kv.first == "json_schema") {
+            res->json_schema = kv.second.ToString();
+        } else if (kv.first == "system_prompt") {
+            res->system_prompt = kv.second.ToString();
+        }
+    }
+    res->request_template = OpenPromptRequestTemplate::Create(res->model_name, res->json_schema, res->system_prompt);
+    res->null_on_error = OpenPromptSettings::GetBoolean(context, "openprompt_null_on_error", false);
+
+    res->input_column_count = input.input_table_types.size();
+    return_types = input.input_table_types;
+    names = input.input_table_names;
+    return_types.emplace_back(LogicalType::VARCHAR);
+    names.emplace_back("response");
+    return std::move(res);
+}
+
+static unique_ptr<LocalTableFunctionState> OpenPromptMapInitLocal(ExecutionContext &context,
+                                                                  TableFunctionInitInput &input,
+                                                                  GlobalTableFunctionState *global_state) {
+    auto &bind_data = input.bind_data->Cast<OpenPromptMapData>();
+    auto window = MaxValue<idx_t>(OpenPromptSettings::GetUBigInt(context.client, "openprompt_map_window", 64), 1);
+    return make_uniq<OpenPromptMapLocalState>(context.client, bind_data, window);
+}
+
+static OperatorResultType OpenPromptMapFunction(ExecutionContext &context, TableFunctionInput &data_p,
+                                                DataChunk &input, DataChunk &output) {
+    auto &bind_data = data_p.bind_data->Cast<OpenPromptMapData>();
+    auto &state = data_p.local_state->Cast<OpenPromptMapLocalState>();
+    if (!state.input_consumed) {
+        state.Enqueue(context.client, bind_data, input);
+        state.input_consumed = true;
+    }
+    state.Wait(false);
+    if (context.client.interrupted) {
+        throw InterruptException();
+    }
+    state.Emit(bind_data, output);
+    if (state.HasRoom()) {
+        state.input_consumed = false;
+        return OperatorResultType::NEED_MORE_INPUT;
+    }
+    return OperatorResultType::HAVE_MORE_OUTPUT;
+}
+
+static OperatorFinalizeResultType OpenPromptMapFinal(ExecutionContext &context, TableFunctionInput &data_p,
+                                                     DataChunk &output) {
+    auto &bind_data = data_p.bind_data->Cast<OpenPromptMapData>();
+    auto &state = data_p.local_state->Cast<OpenPromptMapLocalState>();
+    if (!state.Wait(true)) {
+        return OperatorFinalizeResultType::FINISHED;
+    }
+    if (context.client.interrupted) {
+        throw InterruptException();
+    }
+    state.Emit(bind_data, output);
+    return OperatorFinalizeResultType::HAVE_MORE_OUTPUT;
+}
+
+TableFunction GetOpenPromptMapFunction() {
+    TableFunction function("open_prompt_map", {LogicalType::TABLE, LogicalType::VARCHAR}, nullptr,
+                           OpenPromptMapBind, nullptr, OpenPromptMapInitLocal);
+    function.in_out_function = OpenPromptMapFunction;
+    function.in_out_function_final = OpenPromptMapFinal;
+    function.named_parameters["model"] = LogicalType::VARCHAR;
+    function.named_parameters["json_schema"] = LogicalType::VARCHAR;
+    function.named_parameters["system_prompt"] = LogicalType::VARCHAR;
+    return function;
+}
+
+} // namespace duckdb
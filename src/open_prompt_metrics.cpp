@@ -0,0 +1,173 @@
+#include "open_prompt_metrics.hpp"
+#include "http_state.hpp"
+#include "open_prompt_request.hpp"
+
+#include <cmath>
+
+namespace duckdb {
+
+idx_t OpenPromptLatencyHistogram::BucketIndex(double latency_ms) {
+    if (latency_ms < 1) {
+        return 0;
+    }
+    auto bucket = static_cast<idx_t>(std::floor(4 * std::log2(latency_ms))) + 1;
+    return MinValue<idx_t>(bucket, BUCKET_COUNT - 1);
+}
+
+double OpenPromptLatencyHistogram::BucketUpperBound(idx_t bucket) {
+    return std::pow(2.0, static_cast<double>(bucket) / 4);
+}
+
+void OpenPromptLatencyHistogram::Record(double latency_ms) {
+    buckets[BucketIndex(latency_ms)]++;
+}
+
+idx_t OpenPromptLatencyHistogram::Count() const {
+    idx_t count = 0;
+    for (idx_t i = 0; i < BUCKET_COUNT; i++) {
+        count += buckets[i].load();
+    }
+    return count;
+}
+
+double OpenPromptLatencyHistogram::Percentile(double p) const {
+    idx_t counts[BUCKET_COUNT];
+    idx_t total = 0;
+    for (idx_t i = 0; i < BUCKET_COUNT; i++) {
+        counts[i] = buckets[i].load();
+        total += counts[i];
+    }
+    if (total == 0) {
+        return 0;
+    }
+    auto rank = static_cast<idx_t>(std::ceil(p / 100 * static_cast<double>(total)));
+    rank = MaxValue<idx_t>(rank, 1);
+    idx_t seen = 0;
+    for (idx_t i = 0; i < BUCKET_COUNT; i++) {
+        seen += counts[i];
+        if (seen >= rank) {
+            return BucketUpperBound(i);
+        }
+    }
+    return BucketUpperBound(BUCKET_COUNT - 1);
+}
+
+void OpenPromptLatencyHistogram::Reset() {
+    for (idx_t i = 0; i < BUCKET_COUNT; i++) {
+        buckets[i] = 0;
+    }
+}
+
+void OpenPromptMetrics::Reset() {
+    requests = 0;
+    errors = 0;
+    retries = 0;
+    throttled = 0;
+    failovers = 0;
+    hedges = 0;
+    hedge_wins = 0;
+    cache_hits = 0;
+    deduplicated = 0;
+    connections_opened = 0;
+    connections_reused = 0;
+    bytes_sent = 0;
+    bytes_received = 0;
+    payload_bytes_sent = 0;
+    payload_bytes_received = 0;
+    prompt_tokens = 0;
+    completion_tokens = 0;
+    streamed_requests = 0;
+    time_to_first_token_us = 0;
+    latency.Reset();
+}
+
+shared_ptr<OpenPromptStats> OpenPromptStats::Get(ClientContext &context) {
+    auto &cache = ObjectCache::GetObjectCache(context);
+    return cache.GetOrCreate<OpenPromptStats>(ObjectType());
+}
+
+OpenPromptMetricsRecorder::OpenPromptMetricsRecorder(ClientContext &context)
+    : query_state(HTTPState::TryGetState(context)), database_stats(OpenPromptStats::Get(context)) {
+}
+
+template <class FUNC>
+void OpenPromptMetricsRecorder::Apply(FUNC &&func) {
+    if (query_state) {
+        func(query_state->open_prompt_metrics);
+    }
+    if (database_stats) {
+        func(database_stats->metrics);
+    }
+}
+
+void OpenPromptMetricsRecorder::RecordRequest(idx_t bytes_sent, idx_t bytes_received, double latency_ms,
+                                              bool reused_connection) {
+    if (query_state) {
+        query_state->post_count++;
+        query_state->total_bytes_sent += bytes_sent;
+        query_state->total_bytes_received += bytes_received;
+    }
+    Apply([&](OpenPromptMetrics &metrics) {
+        metrics.requests++;
+        metrics.bytes_sent += bytes_sent;
+        metrics.bytes_received += bytes_received;
+        metrics.latency.Record(latency_ms);
+        if (reused_connection) {
+            metrics.connections_reused++;
+        } else {
+            metrics.connections_opened++;
+        }
+    });
+}
+
+void OpenPromptMetricsRecorder::RecordPayload(idx_t bytes_sent, idx_t bytes_received) {
+    Apply([&](OpenPromptMetrics &metrics) {
+        metrics.payload_bytes_sent += bytes_sent;
+        metrics.payload_bytes_received += bytes_received;
+    });
+}
+
+void OpenPromptMetricsRecorder::RecordResponse(const OpenPromptResponse &response) {
+    Apply([&](OpenPromptMetrics &metrics) {
+        metrics.prompt_tokens += response.prompt_tokens;
+        metrics.completion_tokens += response.completion_tokens;
+        if (response.time_to_first_token_ms > 0) {
+            metrics.streamed_requests++;
+            metrics.time_to_first_token_us += static_cast<idx_t>(response.time_to_first_token_ms * 1000);
+        }
+    });
+}
+
+void OpenPromptMetricsRecorder::RecordError() {
+    Apply([&](OpenPromptMetrics &metrics) { metrics.errors++; });
+}
+
+void OpenPromptMetricsRecorder::RecordRetry() {
+    Apply([&](OpenPromptMetrics &metrics) { metrics.retries++; });
+}
+
+void OpenPromptMetricsRecorder::RecordThrottled() {
+    Apply([&](OpenPromptMetrics &metrics) { metrics.throttled++; });
+}
+
+void OpenPromptMetricsRecorder::RecordFailover() {
+    Apply([&](OpenPromptMetrics &metrics) { metrics.failovers++; });
+}
+
+void OpenPromptMetricsRecorder::RecordHedge() {
+    Apply([&](OpenPromptMetrics &metrics) { metrics.hedges++; });
+}
+
+void OpenPromptMetricsRecorder::RecordHedgeWin() {
+    Apply([&](OpenPromptMetrics &metrics) { metrics.hedge_wins++; });
+}
+
+void OpenPromptMetricsRecorder::RecordCacheHit() {
+    Apply([&](OpenPromptMetrics &metrics) { metrics.cache_hits++; });
+}
+
+void OpenPromptMetricsRecorder::RecordDeduplicated() {
+    Apply([&](OpenPromptMetrics &metrics) { metrics.deduplicated++; });
+}
+
+} // namespace duckdb
@@ -0,0 +1,96 @@
+#include "open_prompt_rate_limiter.hpp"
+
+namespace duckdb {
+
+static constexpr double MIN_RATE_FACTOR = 0.05;
+//! Longest a waiting request sleeps before it re-checks for interrupts
+static constexpr auto MAX_WAIT = std::chrono::milliseconds(100);
+
+shared_ptr<OpenPromptRateLimiter> OpenPromptRateLimiter::Get(ClientContext &context) {
+    auto &cache = ObjectCache::GetObjectCache(context);
+    return cache.GetOrCreate<OpenPromptRateLimiter>(ObjectType());
+}
+
+void OpenPromptRateLimiter::Configure(const OpenPromptRateLimits &limits_p) {
+    lock_guard<mutex> guard(lock);
+    if (limits.max_inflight != limits_p.max_inflight) {
+        // A new ceiling restarts the additive increase from it
+        inflight_limit = limits_p.max_inflight;
+    }
+    limits = limits_p;
+}
+
+void OpenPromptRateLimiter::RefillLocked(steady_clock::time_point now) {
+    double elapsed = std::chrono::duration<double>(now - last_refill).count();
+    last_refill = now;
+    // Buckets hold at most one second of requests and one minute of tokens
+    if (limits.requests_per_second > 0) {
+        double rate = limits.requests_per_second * rate_factor;
+        request_tokens = MinValue<double>(request_tokens + elapsed * rate, MaxValue<double>(rate, 1));
+    }
+    if (limits.tokens_per_minute > 0) {
+        double rate = limits.tokens_per_minute * rate_factor;
+        prompt_tokens = MinValue<double>(prompt_tokens + elapsed * rate / 60, rate);
+    }
+}
+
+bool OpenPromptRateLimiter::Acquire(idx_t estimated_tokens, const atomic<bool> &interrupted) {
+    std::unique_lock<mutex> guard(lock);
+    while (true) {
+        if (interrupted) {
+            return false;
+        }
+        auto now = steady_clock::now();
+        RefillLocked(now);
+        // A prompt larger than a full bucket would wait forever, it only needs the bucket to be full
+        double tokens_needed = MinValue<double>(estimated_tokens, limits.tokens_per_minute * rate_factor);
+        bool paused = now < paused_until;
+        bool inflight_ok = inflight < static_cast<idx_t>(MaxValue<double>(inflight_limit, 1));
+        bool requests_ok = limits.requests_per_second <= 0 || request_tokens >= 1;
+        bool tokens_ok = limits.tokens_per_minute <= 0 || prompt_tokens >= tokens_needed;
+        if (!paused && inflight_ok && requests_ok && tokens_ok) {
+            if (limits.requests_per_second > 0) {
+                request_tokens -= 1;
+            }
+            if (limits.tokens_per_minute > 0) {
+                prompt_tokens -= tokens_needed;
+            }
+            inflight++;
+            return true;
+        }
+        auto wake = now + MAX_WAIT;
+        if (paused && paused_until < wake) {
+            wake = paused_until;
+        }
+        cv.wait_until(guard, wake);
+    }
+}
+
+void OpenPromptRateLimiter::Release(bool throttled) {
+    {
+        lock_guard<mutex> guard(lock);
+        inflight--;
+        if (throttled) {
+            // Multiplicative decrease
+            inflight_limit = MaxValue<double>(inflight_limit / 2, 1);
+            rate_factor = MaxValue<double>(rate_factor / 2, MIN_RATE_FACTOR);
+        } else {
+            // Additive increase, roughly one extra request per window of successes
+            inflight_limit = MinValue<double>(inflight_limit + 1 / MaxValue<double>(inflight_limit, 1),
+                                              limits.max_inflight);
+            rate_factor = MinValue<double>(rate_factor + 0.01, 1);
+        }
+    }
+    cv.notify_all();
+}
+
+void OpenPromptRateLimiter::Pause(double seconds) {
+    lock_guard<mutex> guard(lock);
+    auto until = steady_clock::now() +
+                 std::chrono::duration_cast<steady_clock::duration>(std::chrono::duration<double>(seconds));
+    if (until > paused_until) {
+        paused_until = until;
+    }
+}
+
+} // namespace duckdb
@@ -0,0 +1,269 @@
+#include "open_prompt_request.hpp"
+
+#include "yyjson.hpp"
+
+namespace duckdb {
+
+//! For every byte, the character following the backslash when it has to be escaped, 'u' for \u00XX, 0 otherwise
+struct JSONEscapeTable {
+    char escape[256];
+
+    JSONEscapeTable() {
+        for (idx_t c = 0; c < 256; c++) {
+            escape[c] = c < 0x20 ? 'u' : 0;
+        }
+        escape[static_cast<unsigned char>('"')] = '"';
+        escape[static_cast<unsigned char>('\\')] = '\\';
+        escape[static_cast<unsigned char>('\n')] = 'n';
+        escape[static_cast<unsigned char>('\r')] = 'r';
+        escape[static_cast<unsigned char>('\t')] = 't';
+        escape[static_cast<unsigned char>('\b')] = 'b';
+        escape[static_cast<unsigned char>('\f')] = 'f';
+    }
+};
+
+static const JSONEscapeTable JSON_ESCAPES;
+
+void AppendJSONEscaped(string &out, const char *str, idx_t len) {
+    static const char *HEX_DIGITS = "0123456789abcdef";
+    out.reserve(out.size() + len);
+    // Runs of characters that need no escaping are appended in one go
+    idx_t run_start = 0;
+    for (idx_t i = 0; i < len; i++) {
+        auto c = static_cast<unsigned char>(str[i]);
+        auto escape = JSON_ESCAPES.escape[c];
+        if (escape == 0) {
+            continue;
+        }
+        out.append(str + run_start, i - run_start);
+        out += '\\';
+        out += escape;
+        if (escape == 'u') {
+            out += "00";
+            out += HEX_DIGITS[c >> 4];
+            out += HEX_DIGITS[c & 0xF];
+        }
+        run_start = i + 1;
+    }
+    out.append(str + run_start, len - run_start);
+}
+
+void AppendJSONString(string &out, const char *str, idx_t len) {
+    out.reserve(out.size() + len + 2);
+    out += '"';
+    AppendJSONEscaped(out, str, len);
+    out += '"';
+}
+
+//! The validated "content" string of the first choice
+static duckdb_yyjson::yyjson_val *GetCompletionContent(duckdb_yyjson::yyjson_val *root) {
+    auto choices = duckdb_yyjson::yyjson_obj_get(root, "choices");
+    if (!choices || !duckdb_yyjson::yyjson_is_arr(choices)) {
+        throw std::runtime_error("Invalid response format: missing choices array");
+    }
+
+    auto first_choice = duckdb_yyjson::yyjson_arr_get_first(choices);
+    if (!first_choice) {
+        throw std::runtime_error("Empty choices array in response");
+    }
+
+    auto message = duckdb_yyjson::yyjson_obj_get(first_choice, "message");
+    if (!message) {
+        throw std::runtime_error("Missing message in response");
+    }
+
+    auto content = duckdb_yyjson::yyjson_obj_get(message, "content");
+    if (!content) {
+        throw std::runtime_error("Missing content in response");
+    }
+
+    if (!duckdb_yyjson::yyjson_get_str(content)) {
+        throw std::runtime_error("Invalid content in response");
+    }
+    return content;
+}
+
+string ParseCompletionContent(duckdb_yyjson::yyjson_val *root) {
+    auto content = GetCompletionContent(root);
+    return string(duckdb_yyjson::yyjson_get_str(content), duckdb_yyjson::yyjson_get_len(content));
+}
+
+void ParseCompletionUsage(duckdb_yyjson::yyjson_val *root, OpenPromptResponse &response) {
+    auto usage = duckdb_yyjson::yyjson_obj_get(root, "usage");
+    if (!usage || !duckdb_yyjson::yyjson_is_obj(usage)) {
+        return;
+    }
+    auto prompt_tokens = duckdb_yyjson::yyjson_obj_get(usage, "prompt_tokens");
+    if (duckdb_yyjson::yyjson_is_uint(prompt_tokens)) {
+        response.prompt_tokens = duckdb_yyjson::yyjson_get_uint(prompt_tokens);
+    }
+    auto completion_tokens = duckdb_yyjson::yyjson_obj_get(usage, "completion_tokens");
+    if (duckdb_yyjson::yyjson_is_uint(completion_tokens)) {
+        response.completion_tokens = duckdb_yyjson::yyjson_get_uint(completion_tokens);
+    }
+}
+
+duckdb_yyjson::yyjson_doc *ReadJSONInsitu(string &body) {
+    // Documents larger than this use the default allocator rather than growing the per-thread memory for good
+    static constexpr idx_t MAX_POOL_SIZE = 64 * 1024 * 1024;
+    thread_local vector<char> pool_memory;
+    thread_local duckdb_yyjson::yyjson_alc pool_allocator;
+
+    auto len = body.size();
+    // Insitu parsing needs zeroed padding after the data, which is not part of the JSON text
+    body.append(YYJSON_PADDING_SIZE, '\0');
+    const duckdb_yyjson::yyjson_alc *allocator = nullptr;
+    auto required = duckdb_yyjson::yyjson_read_max_memory_usage(len, duckdb_yyjson::YYJSON_READ_INSITU);
+    if (required > 0 && required <= MAX_POOL_SIZE) {
+        if (pool_memory.size() < required) {
+            pool_memory.resize(required);
+        }
+        if (duckdb_yyjson::yyjson_alc_pool_init(&pool_allocator, pool_memory.data(), pool_memory.size())) {
+            allocator = &pool_allocator;
+        }
+    }
+    auto doc = duckdb_yyjson::yyjson_read_opts(&body[0], len, duckdb_yyjson::YYJSON_READ_INSITU, allocator, nullptr);
+    body.resize(len);
+    return doc;
+}
+
+OpenPromptResponse ParseCompletionResponse(string &&body) {
+    try {
+        OpenPromptResponse response;
+        response.bytes_received = body.size();
+        unique_ptr<duckdb_yyjson::yyjson_doc, void(*)(duckdb_yyjson::yyjson_doc *)> doc(
+            ReadJSONInsitu(body),
+            &duckdb_yyjson::yyjson_doc_free
+        );
+
+        if (!doc) {
+            throw std::runtime_error("Failed to parse JSON response");
+        }
+
+        auto root = duckdb_yyjson::yyjson_doc_get_root(doc.get());
+        if (!root) {
+            throw std::runtime_error("Invalid JSON response: no root object");
+        }
+
+        auto content = GetCompletionContent(root);
+        ParseCompletionUsage(root, response);
+        // The content was unescaped in place inside the body, move it to the front and keep the allocation
+        auto content_str = duckdb_yyjson::yyjson_get_str(content);
+        auto content_len = duckdb_yyjson::yyjson_get_len(content);
+        doc.reset();
+        memmove(&body[0], content_str, content_len);
+        body.resize(content_len);
+        response.content = std::move(body);
+        return response;
+    } catch (std::exception &e) {
+        throw std::runtime_error("Failed to parse response: " + std::string(e.what()));
+    }
+}
+
+OpenPromptRequestTemplate OpenPromptRequestTemplate::Create(const string &model_name, const string &json_schema,
+                                                            const string &system_prompt) {
+    unique_ptr<duckdb_yyjson::yyjson_mut_doc, void (*)(duckdb_yyjson::yyjson_mut_doc*)> doc(
+            duckdb_yyjson::yyjson_mut_doc_new(nullptr), &duckdb_yyjson::yyjson_mut_doc_free);
+    auto obj = duckdb_yyjson::yyjson_mut_obj(doc.get());
+    duckdb_yyjson::yyjson_mut_doc_set_root(doc.get(), obj);
+    duckdb_yyjson::yyjson_mut_obj_add(obj,
+        duckdb_yyjson::yyjson_mut_str(doc.get(), "model"),
+        duckdb_yyjson::yyjson_mut_strn(doc.get(), model_name.c_str(), model_name.size())
+        );
+    if (!json_schema.empty()) {
+        auto response_format = duckdb_yyjson::yyjson_mut_obj(doc.get());
+        duckdb_yyjson::yyjson_mut_obj_add(response_format,
+            duckdb_yyjson::yyjson_mut_str(doc.get(), "type"),
+            duckdb_yyjson::yyjson_mut_str(doc.get(), "json_object"));
+        auto yyschema = duckdb_yyjson::yyjson_mut_rawn(doc.get(), json_schema.c_str(), json_schema.size());
+        duckdb_yyjson::yyjson_mut_obj_add(response_format,
+            duckdb_yyjson::yyjson_mut_str(doc.get(), "schema"),
+            yyschema);
+        duckdb_yyjson::yyjson_mut_obj_add(obj,
+            duckdb_yyjson::yyjson_mut_str(doc.get(),"response_format"),
+            response_format);
+    }
+    auto messages = duckdb_yyjson::yyjson_mut_arr(doc.get());
+    if (!system_prompt.empty()) {
+        auto yymessage = duckdb_yyjson::yyjson_mut_arr_add_obj(doc.get(), messages);
+        duckdb_yyjson::yyjson_mut_obj_add(yymessage,
+            duckdb_yyjson::yyjson_mut_str(doc.get(), "role"),
+            duckdb_yyjson::yyjson_mut_str(doc.get(), "system"));
+        duckdb_yyjson::yyjson_mut_obj_add(yymessage,
+            duckdb_yyjson::yyjson_mut_str(doc.get(), "content"),
+            duckdb_yyjson::yyjson_mut_strn(doc.get(), system_prompt.c_str(), system_prompt.size()));
+    }
+    // "messages" is added last so that the user message can be spliced in right before the closing "]}"
+    duckdb_yyjson::yyjson_mut_obj_add(obj, duckdb_yyjson::yyjson_mut_str(doc.get(), "messages"),
+        messages);
+    duckdb_yyjson::yyjson_write_err err;
+    size_t len;
+    auto request_body = duckdb_yyjson::yyjson_mut_write_opts(doc.get(), 0, nullptr, &len, &err);
+    if (request_body == nullptr) {
+        throw std::runtime_error(err.msg);
+    }
+    OpenPromptRequestTemplate result;
+    D_ASSERT(len >= 2);
+    result.prefix = string(request_body, len - 2);
+    result.has_system_message = !system_prompt.empty();
+    free(request_body);
+    return result;
+}
+
+const OpenPromptRequestTemplate &OpenPromptRequestTemplate::GetCached(const string &model_name,
+                                                                     const string &json_schema,
+                                                                     const string &system_prompt) {
+    struct CachedTemplate {
+        bool initialized = false;
+        string model_name;
+        string json_schema;
+        string system_prompt;
+        OpenPromptRequestTemplate request_template;
+    };
+    thread_local CachedTemplate cached;
+    if (!cached.initialized || cached.model_name != model_name || cached.json_schema != json_schema ||
+        cached.system_prompt != system_prompt) {
+        cached.request_template = Create(model_name, json_schema, system_prompt);
+        cached.model_name = model_name;
+        cached.json_schema = json_schema;
+        cached.system_prompt = system_prompt;
+        cached.initialized = true;
+    }
+    return cached.request_template;
+}
+
+//! Close the "messages" array and the body. Servers that support it report the token usage in a final chunk of
+//! the stream
+static void AppendBodyEnd(string &out, bool stream) {
+    out += stream ? "],\"stream\":true,\"stream_options\":{\"include_usage\":true}}" : "]}";
+}
+
+void OpenPromptRequestTemplate::Render(const char *user_prompt, idx_t user_prompt_len, string &out,
+                                       bool stream) const {
+    if (user_prompt_len == 0) {
+        out.clear();
+        out += prefix;
+        AppendBodyEnd(out, stream);
+        return;
+    }
+    BeginUserMessage(out, user_prompt_len);
+    AppendJSONEscaped(out, user_prompt, user_prompt_len);
+    EndUserMessage(out, stream);
+}
+
+void OpenPromptRequestTemplate::BeginUserMessage(string &out, idx_t content_size) const {
+    out.clear();
+    out.reserve(prefix.size() + content_size + 48);
+    out += prefix;
+    if (has_system_message) {
+        out += ',';
+    }
+    out += "{\"role\":\"user\",\"content\":\"";
+}
+
+void OpenPromptRequestTemplate::EndUserMessage(string &out, bool stream) const {
+    out += "\"}";
+    AppendBodyEnd(out, stream);
+}
+
+} // namespace duckdb
@@ -0,0 +1,687 @@
+#include "open_prompt_sender.hpp"
+#include "open_prompt_settings.hpp"
+
+#include "duckdb/common/chrono.hpp"
+#include "yyjson.hpp"
+
+#include <cmath>
+#include <random>
+
+namespace duckdb {
+
+shared_ptr<PromptResponseCache> GetResponseCache(ClientContext &context) {
+    auto cache_path = OpenPromptSettings::GetString(context, "openprompt_cache_path");
+    if (cache_path.empty()) {
+        return nullptr;
+    }
+    auto cache = PromptResponseCache::Get(context, cache_path);
+    cache->Configure(OpenPromptSettings::GetUBigInt(context, "openprompt_cache_ttl", 0),
+                     OpenPromptSettings::GetUBigInt(context, "openprompt_cache_max_bytes", 256 * 1024 * 1024));
+    return cache;
+}
+
+//! Replace `response` with the error message, reusing its allocation
+static void SetErrorResponse(string &response, const char *message) {
+    response.assign("Error: ").append(message);
+}
+
+//! Roughly four bytes per token, good enough to stay under a tokens-per-minute quota
+static idx_t EstimateRequestTokens(const string &body) {
+    return body.size() / 4 + 1;
+}
+
+//! Largest response buffer reserved from Content-Length, larger bodies grow as they arrive
+static constexpr idx_t MAX_RESERVED_RESPONSE_SIZE = 16 * 1024 * 1024;
+
+//! Request bodies below this size are sent uncompressed
+static constexpr idx_t MIN_COMPRESSED_BODY_SIZE = 1024;
+
+static double ElapsedMilliseconds(steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(steady_clock::now() - start).count();
+}
+
+//! HTTP status of a failed request, 0 when no response was received
+static int32_t ErrorStatus(const std::exception &e) {
+    auto http_error = dynamic_cast<const OpenPromptHTTPError *>(&e);
+    return http_error ? http_error->status : 0;
+}
+
+OpenPromptSender::OpenPromptSender(ClientContext &context_p, const string &api_url_p, const string &api_token_p)
+    : context(context_p), api_url(api_url_p), api_token(api_token_p), recorder(context_p) {
+    endpoints = OpenPromptEndpointSet::Get(context, api_url);
+    endpoints->Configure(OpenPromptSettings::GetUBigInt(context, "openprompt_endpoint_max_failures", 3),
+                         OpenPromptSettings::GetDouble(context, "openprompt_endpoint_cooldown", 10));
+    pool = HTTPClientPool::Get(context);
+    worker_pool = OpenPromptWorkerPool::Get(context);
+    pool->Configure(OpenPromptSettings::GetUBigInt(context, "openprompt_http_pool_max_per_host", 64),
+                    OpenPromptSettings::GetUBigInt(context, "openprompt_http_idle_timeout", 30));
+    response_cache = GetResponseCache(context);
+    cache_matcher.Configure(context);
+    deduplicate = OpenPromptSettings::GetBoolean(context, "openprompt_deduplicate", true);
+    if (deduplicate) {
+        query_state = OpenPromptQueryState::Get(context);
+    }
+    max_concurrency = MaxValue<idx_t>(OpenPromptSettings::GetUBigInt(context, "openprompt_max_concurrency", 1), 1);
+    batch_mode = ParseBatchMode(OpenPromptSettings::GetString(context, "openprompt_batch_mode"));
+
+    stream_options.enabled = batch_mode == OpenPromptBatchMode::NONE &&
+                             OpenPromptSettings::GetBoolean(context, "openprompt_stream", false);
+    stream_options.max_chars = OpenPromptSettings::GetUBigInt(context, "openprompt_max_chars", 0);
+    stream_options.stop_pattern = OpenPromptSettings::GetString(context, "openprompt_stop_pattern");
+
+    OpenPromptRateLimits limits;
+    limits.requests_per_second = OpenPromptSettings::GetDouble(context, "openprompt_requests_per_second", 0);
+    limits.tokens_per_minute = OpenPromptSettings::GetDouble(context, "openprompt_tokens_per_minute", 0);
+    limits.max_inflight = MaxValue<idx_t>(OpenPromptSettings::GetUBigInt(context, "openprompt_max_inflight", 256), 1);
+    limiter = OpenPromptRateLimiter::Get(context);
+    limiter->Configure(limits);
+
+    retry_options.max_retries = OpenPromptSettings::GetUBigInt(context, "openprompt_max_retries", 3);
+    retry_options.base_delay_ms = OpenPromptSettings::GetUBigInt(context, "openprompt_retry_base_delay_ms", 500);
+    retry_options.max_delay_ms = OpenPromptSettings::GetUBigInt(context, "openprompt_retry_max_delay_ms", 30000);
+
+    batch_options.batch_size = OpenPromptSettings::GetUBigInt(context, "openprompt_batch_size", 64);
+    batch_options.poll_interval_seconds = OpenPromptSettings::GetUBigInt(context, "openprompt_batch_poll_interval", 10);
+    batch_options.timeout_seconds = OpenPromptSettings::GetUBigInt(context, "openprompt_batch_timeout", 86400);
+
+    token_budget.max_input_tokens = OpenPromptSettings::GetUBigInt(context, "openprompt_max_input_tokens", 0);
+    token_budget.overflow = ParseOverflowMode(OpenPromptSettings::GetString(context, "openprompt_input_overflow"));
+    token_budget.estimator =
+        OpenPromptTokenEstimator(OpenPromptSettings::GetDouble(context, "openprompt_chars_per_token", 4));
+
+    hedge_percentile = OpenPromptSettings::GetDouble(context, "openprompt_hedge_percentile", 0);
+    hedge_budget_percent = OpenPromptSettings::GetDouble(context, "openprompt_hedge_budget", 5);
+    if (hedge_percentile > 0 && hedge_budget_percent > 0) {
+        hedge_policy = OpenPromptHedgePolicy::Get(context, api_url);
+        hedge_scheduler = OpenPromptHedgeScheduler::Get(context);
+    }
+
+    compression = ParseCompression(OpenPromptSettings::GetString(context, "openprompt_compression"));
+    compression_level = NumericCast<int>(
+        MinValue<idx_t>(OpenPromptSettings::GetUBigInt(context, "openprompt_compression_level", 3), 19));
+}
+
+// Sends a single completion request and returns the message content, throws on failure
+OpenPromptResponse OpenPromptSender::PerformRequest(const HTTPEndpoint &endpoint, const string &body, bool raw_body,
+                                                    optional_ptr<OpenPromptHedgeRace> race, idx_t attempt) {
+    auto client = pool->Acquire(endpoint);
+    bool reused = client.Reused();
+    auto start_time = steady_clock::now();
+
+    duckdb_httplib_openssl::Headers headers;
+    headers.emplace("Content-Type", "application/json");
+    if (!api_token.empty()) {
+        headers.emplace("Authorization", "Bearer " + api_token);
+    }
+    // Small bodies are not worth the CPU time, the compressed size is what counts as bytes sent
+    string compressed_body;
+    bool compress = compression != OpenPromptCompression::NONE && body.size() >= MIN_COMPRESSED_BODY_SIZE;
+    if (compress) {
+        CompressBody(compression, compression_level, body, compressed_body);
+        headers.emplace("Content-Encoding", CompressionEncoding(compression));
+    }
+    auto &sent_body = compress ? compressed_body : body;
+
+    if (stream_options.enabled && !raw_body) {
+        // Event streams are read as they arrive, so only the request body is compressed
+        OpenPromptResponse response;
+        try {
+            response = PerformStreamingRequest(client, endpoint, headers, sent_body, stream_options);
+        } catch (OpenPromptHTTPError &e) {
+            // Transport errors never got a response
+            if (e.status != 0) {
+                recorder.RecordRequest(sent_body.size(), 0, ElapsedMilliseconds(start_time), reused);
+                recorder.RecordPayload(body.size(), 0);
+            }
+            throw;
+        } catch (std::exception &) {
+            recorder.RecordRequest(sent_body.size(), 0, ElapsedMilliseconds(start_time), reused);
+            recorder.RecordPayload(body.size(), 0);
+            throw;
+        }
+        recorder.RecordRequest(sent_body.size(), response.bytes_received, ElapsedMilliseconds(start_time), reused);
+        recorder.RecordPayload(body.size(), response.bytes_received);
+        recorder.RecordResponse(response);
+        return response;
+    }
+    if (compression != OpenPromptCompression::NONE) {
+        headers.emplace("Accept-Encoding", AcceptedEncodings());
+    }
+
+    // The body is received into a buffer sized from Content-Length, which is then parsed in place and becomes the
+    // content, instead of growing httplib's response body and copying the completion out of it
+    string response_body;
+    duckdb_httplib_openssl::Request req;
+    req.method = "POST";
+    req.path = endpoint.path;
+    req.headers = std::move(headers);
+    // The body is kept by the caller for retries, so it is sent from there rather than copied into the request
+    SetRequestBody(req, sent_body);
+    req.response_handler = [&](const duckdb_httplib_openssl::Response &response) {
+        auto content_length = response.get_header_value("Content-Length");
+        // Content-Length is only a hint, a bogus value must not reserve gigabytes up front
+        if (!content_length.empty()) {
+            auto announced = MinValue<idx_t>(std::strtoull(content_length.c_str(), nullptr, 10),
+                                             MAX_RESERVED_RESPONSE_SIZE);
+            response_body.reserve(announced + YYJSON_PADDING_SIZE);
+        }
+        return true;
+    };
+    req.content_receiver = [&](const char *data, size_t data_length, uint64_t, uint64_t) {
+        response_body.append(data, data_length);
+        return true;
+    };
+    if (race && !race->Register(attempt, *client)) {
+        throw OpenPromptHTTPError("Request was answered by another attempt", 0, false);
+    }
+    auto res = client->send(req);
+    if (race && race->Unregister(attempt)) {
+        // The connection was shut down because the other attempt won
+        client.Discard();
+    }
+
+    if (!res) {
+        // The connection is in an unknown state, do not hand it to the next request
+        client.Discard();
+        HandleHttpError(res, "POST");
+    }
+    recorder.RecordRequest(sent_body.size(), response_body.size(), ElapsedMilliseconds(start_time), reused);
+
+    if (res->status != 200) {
+        recorder.RecordPayload(body.size(), response_body.size());
+        HandleHttpStatus(*res);
+    }
+    // The pool's clients leave Content-Encoding to us, httplib is built without zlib
+    DecompressBody(res->get_header_value("Content-Encoding"), response_body);
+    recorder.RecordPayload(body.size(), response_body.size());
+
+    if (raw_body) {
+        OpenPromptResponse response;
+        response.bytes_received = response_body.size();
+        response.content = std::move(response_body);
+        return response;
+    }
+    auto response = ParseCompletionResponse(std::move(response_body));
+    recorder.RecordResponse(response);
+    return response;
+}
+
+//! 429 Too Many Requests and 503 Service Unavailable ask to back off, they do not mean that the backend is broken
+static bool IsThrottled(int status) {
+    return status == 429 || status == 503;
+}
+
+OpenPromptResponse OpenPromptSender::PerformHedgedRequest(const OpenPromptBackend &backend, const string &body,
+                                                          bool raw_body) {
+    hedge_policy->RecordRequest();
+    auto delay_ms = hedge_policy->Delay(hedge_percentile);
+    auto start_time = steady_clock::now();
+    if (delay_ms < 0) {
+        // Too few latencies were observed to tell a slow request from a normal one
+        auto response = PerformRequest(backend.endpoint, body, raw_body);
+        hedge_policy->Record(ElapsedMilliseconds(start_time));
+        return response;
+    }
+
+    auto race = make_shared_ptr<OpenPromptHedgeRace>();
+    // Sent once the delay expired while the primary is still running, within the budget and to another backend
+    // when the list has one. The scheduler is shared by the database and may hold the hedge past this call, but it
+    // only runs it before CancelHedge returned, so the captured references stay valid
+    hedge_scheduler->Schedule(race, delay_ms, [&]() {
+        if (!hedge_policy->TryHedge(hedge_budget_percent)) {
+            return;
+        }
+        recorder.RecordHedge();
+        auto &hedge_backend = endpoints->Acquire(&backend);
+        auto hedge_start = steady_clock::now();
+        OpenPromptResponse hedge_response;
+        bool success = false;
+        bool acquired = false;
+        bool backend_failed = false;
+        bool throttled = false;
+        try {
+            acquired = limiter->Acquire(EstimateRequestTokens(body), context.interrupted);
+            if (acquired) {
+                hedge_response = PerformRequest(hedge_backend.endpoint, body, raw_body, race.get(),
+                                                OpenPromptHedgeRace::HEDGE);
+                success = true;
+            }
+        } catch (OpenPromptHTTPError &e) {
+            throttled = IsThrottled(e.status);
+            backend_failed = (e.status == 0 || (e.status >= 500 && !throttled)) &&
+                             !race->Stopped(OpenPromptHedgeRace::HEDGE);
+        } catch (std::exception &) {
+        }
+        if (acquired) {
+            limiter->Release(throttled);
+        }
+        endpoints->Release(hedge_backend, backend_failed);
+        if (success) {
+            hedge_policy->Record(ElapsedMilliseconds(hedge_start));
+        }
+        if (race->Finish(OpenPromptHedgeRace::HEDGE, success ? &hedge_response : nullptr)) {
+            recorder.RecordHedgeWin();
+        }
+    });
+
+    OpenPromptResponse response;
+    std::exception_ptr error;
+    try {
+        response = PerformRequest(backend.endpoint, body, raw_body, race.get(), OpenPromptHedgeRace::PRIMARY);
+        hedge_policy->Record(ElapsedMilliseconds(start_time));
+    } catch (...) {
+        error = std::current_exception();
+    }
+    bool primary_won = race->Finish(OpenPromptHedgeRace::PRIMARY, error ? nullptr : &response);
+    // A hedge that lost was cut off, so this only waits long when the primary failed and the hedge is still running
+    race->CancelHedge();
+    if (primary_won) {
+        return response;
+    }
+    if (race->HedgeWon()) {
+        return std::move(race->response);
+    }
+    std::rethrow_exception(error);
+}
+
+// Sends a request through the rate limiter, retrying transient failures with jittered exponential backoff
+OpenPromptResponse OpenPromptSender::SendOne(const string &body, bool raw_body) {
+    thread_local std::mt19937 random_engine(std::random_device {}());
+    idx_t estimated_tokens = EstimateRequestTokens(body);
+    optional_ptr<const OpenPromptBackend> failed_backend;
+    idx_t failovers = 0;
+    for (idx_t retries = 0;;) {
+        if (!limiter->Acquire(estimated_tokens, context.interrupted)) {
+            throw InterruptException();
+        }
+        auto &backend = endpoints->Acquire(failed_backend);
+        double delay_ms = 0;
+        try {
+            // Streamed responses are not hedged, their latency is dominated by the completion length
+            auto response = hedge_policy && !(stream_options.enabled && !raw_body)
+                                ? PerformHedgedRequest(backend, body, raw_body)
+                                : PerformRequest(backend.endpoint, body, raw_body);
+            endpoints->Release(backend, false);
+            limiter->Release(false);
+            return response;
+        } catch (OpenPromptHTTPError &e) {
+            // Connection errors and server errors count against the backend, throttling does not. A throttled
+            // request waits for Retry-After like any retry, and only then moves on to another backend
+            bool throttled = IsThrottled(e.status);
+            bool backend_failed = e.status == 0 || (e.status >= 500 && !throttled);
+            endpoints->Release(backend, backend_failed);
+            limiter->Release(throttled);
+            if (throttled) {
+                recorder.RecordThrottled();
+            }
+            if (!e.transient) {
+                throw;
+            }
+            // The row fails over to another healthy backend right away, at most once per other backend and
+            // without using up a retry
+            if (backend_failed && failovers + 1 < endpoints->Size() && endpoints->HasHealthyAlternative(backend)) {
+                failovers++;
+                failed_backend = &backend;
+                recorder.RecordFailover();
+                continue;
+            }
+            if (retries >= retry_options.max_retries) {
+                throw;
+            }
+            recorder.RecordRetry();
+            if (e.retry_after_seconds > 0) {
+                limiter->Pause(e.retry_after_seconds);
+            }
+            // Full jitter: a uniform delay up to the exponential backoff ceiling
+            double ceiling = MinValue<double>(retry_options.max_delay_ms,
+                                              retry_options.base_delay_ms * std::pow(2.0, static_cast<double>(retries)));
+            delay_ms = MaxValue<double>(std::uniform_real_distribution<double>(0, ceiling)(random_engine),
+                                        e.retry_after_seconds * 1000);
+            retries++;
+            failed_backend = &backend;
+        } catch (...) {
+            endpoints->Release(backend, false);
+            limiter->Release(false);
+            throw;
+        }
+        auto wake = steady_clock::now() + std::chrono::milliseconds(static_cast<int64_t>(delay_ms));
+        while (steady_clock::now() < wake) {
+            if (context.interrupted) {
+                throw InterruptException();
+            }
+            std::this_thread::sleep_for(MinValue(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                                     wake - steady_clock::now()),
+                                                 std::chrono::milliseconds(100)));
+        }
+    }
+}
+
+bool OpenPromptSender::SendAndRecord(OpenPromptRequest &request) {
+    auto start_time = steady_clock::now();
+    bool cacheable = false;
+    try {
+        auto response = SendOne(request.body);
+        request.response = std::move(response.content);
+        request.status = 200;
+        request.tokens = response.prompt_tokens + response.completion_tokens;
+        request.success = true;
+        // A completion cut short by a stop condition is not the answer to the request itself
+        cacheable = !response.truncated;
+    } catch (std::exception &e) {
+        request.status = ErrorStatus(e);
+        SetErrorResponse(request.response, e.what());
+        recorder.RecordError();
+    }
+    request.latency_ms = ElapsedMilliseconds(start_time);
+    return cacheable;
+}
+
+bool OpenPromptSender::FindCached(const string &cache_key, OpenPromptRequest &request) {
+    bool found = response_cache->Find(cache_key, request.response);
+    if (!found && cache_matcher.Approximate() && !request.prompt.empty()) {
+        found = response_cache->FindSimilar(cache_matcher.Context(api_url, request.body, request.prompt),
+                                            cache_matcher.Fingerprint(request.prompt), cache_matcher.MaxDistance(),
+                                            request.response);
+    }
+    if (found) {
+        request.success = true;
+        request.status = 200;
+        recorder.RecordCacheHit();
+    }
+    return found;
+}
+
+void OpenPromptSender::InsertCached(const string &cache_key, const OpenPromptRequest &request) {
+    response_cache->Insert(cache_key, request.response);
+    if (cache_matcher.Approximate() && !request.prompt.empty()) {
+        response_cache->InsertSimilar(cache_key, cache_matcher.Context(api_url, request.body, request.prompt),
+                                      cache_matcher.Fingerprint(request.prompt));
+    }
+}
+
+void OpenPromptSender::SendRequest(OpenPromptRequest &request) {
+    // A request another row of the query already sent is waited for instead of sent again, as in Send
+    string dedup_key;
+    shared_ptr<OpenPromptSharedResponse> shared_response;
+    if (query_state) {
+        dedup_key = PromptResponseCache::ComputeKey(api_url, request.body);
+        bool is_owner;
+        shared_response = query_state->Claim(dedup_key, is_owner);
+        if (!is_owner) {
+            recorder.RecordDeduplicated();
+            shared_response->Wait();
+            request.success = shared_response->success;
+            request.response = shared_response->response;
+            request.status = shared_response->status;
+            request.latency_ms = shared_response->latency_ms;
+            return;
+        }
+    }
+    string cache_key;
+    bool from_cache = false;
+    if (response_cache) {
+        cache_key = query_state && !cache_matcher.Normalizes()
+                        ? dedup_key
+                        : cache_matcher.Key(api_url, request.body, request.prompt);
+        from_cache = FindCached(cache_key, request);
+    }
+    if (!from_cache && SendAndRecord(request) && response_cache) {
+        InsertCached(cache_key, request);
+    }
+    if (shared_response) {
+        query_state->Complete(dedup_key, *shared_response, request.success, request.response, request.status,
+                              request.latency_ms);
+    }
+}
+
+void OpenPromptSender::Send(vector<OpenPromptRequest> &requests, const string &model_name,
+                            const string &json_schema, const string &system_prompt) {
+    if (batch_mode == OpenPromptBatchMode::MULTI_PROMPT && !json_schema.empty()) {
+        throw InvalidInputException("openprompt_batch_mode 'multi_prompt' does not support json_schema, completions "
+                                    "endpoints have no response_format");
+    }
+    idx_t request_count = requests.size();
+    // Deduplication within the query only shares responses of identical bodies, the cache may match more loosely
+    vector<string> dedup_keys(request_count);
+    vector<string> cache_keys(request_count);
+    vector<shared_ptr<OpenPromptSharedResponse>> shared_responses(request_count);
+    vector<bool> owned(request_count, true);
+    // Written concurrently by the request workers, so not a bit-packed vector<bool>
+    vector<uint8_t> finished(request_count, false);
+    vector<uint8_t> cacheable(request_count, true);
+
+    // Publish the outcome of a request this thread is responsible for
+    auto finish_request = [&](idx_t request_idx, bool from_cache) {
+        auto &request = requests[request_idx];
+        if (request.success && response_cache && !from_cache && cacheable[request_idx]) {
+            InsertCached(cache_keys[request_idx], request);
+        }
+        if (shared_responses[request_idx]) {
+            query_state->Complete(dedup_keys[request_idx], *shared_responses[request_idx], request.success,
+                                  request.response, request.status, request.latency_ms);
+        }
+        finished[request_idx] = true;
+    };
+
+    // Requests already sent by another vector of this query are waited for instead of sent again,
+    // and cached responses skip the network entirely
+    vector<idx_t> send_requests;
+    for (idx_t request_idx = 0; request_idx < request_count; request_idx++) {
+        auto &request = requests[request_idx];
+        if (request.completed) {
+            finished[request_idx] = true;
+            continue;
+        }
+        if (query_state) {
+            dedup_keys[request_idx] = PromptResponseCache::ComputeKey(api_url, request.body);
+        }
+        if (response_cache) {
+            cache_keys[request_idx] = query_state && !cache_matcher.Normalizes()
+                                          ? dedup_keys[request_idx]
+                                          : cache_matcher.Key(api_url, request.body, request.prompt);
+        }
+        if (query_state) {
+            bool is_owner;
+            shared_responses[request_idx] = query_state->Claim(dedup_keys[request_idx], is_owner);
+            if (!is_owner) {
+                owned[request_idx] = false;
+                recorder.RecordDeduplicated();
+                continue;
+            }
+        }
+        if (response_cache && FindCached(cache_keys[request_idx], request)) {
+            finish_request(request_idx, true);
+            continue;
+        }
+        send_requests.push_back(request_idx);
+    }
+
+    // Send a request on its own, on a request worker
+    auto send_single = [&](idx_t request_idx) {
+        cacheable[request_idx] = SendAndRecord(requests[request_idx]);
+        finish_request(request_idx, false);
+    };
+
+    try {
+        if (batch_mode == OpenPromptBatchMode::NONE) {
+            RunConcurrently(send_requests.size(), [&](idx_t task_idx) { send_single(send_requests[task_idx]); });
+        } else if (batch_mode == OpenPromptBatchMode::PACKED) {
+            // Consecutive prompts share a request up to openprompt_batch_size prompts and the input token budget
+            // With a json_schema every pack asks for an object holding one schema-conforming answer per prompt
+            bool structured = !json_schema.empty();
+            auto &estimator = token_budget.estimator;
+            auto overhead_tokens =
+                estimator.Estimate(PackedSystemPrompt(system_prompt, batch_options.batch_size, structured)) +
+                estimator.Estimate(json_schema);
+            vector<idx_t> pack_starts;
+            idx_t pack_tokens = 0;
+            for (idx_t task_idx = 0; task_idx < send_requests.size(); task_idx++) {
+                // Quotes and separators of the JSON array add a few tokens per prompt
+                auto prompt_tokens = estimator.Estimate(requests[send_requests[task_idx]].prompt) + 3;
+                if (pack_starts.empty() || task_idx - pack_starts.back() >= batch_options.batch_size ||
+                    (token_budget.Enabled() && pack_tokens + prompt_tokens > token_budget.max_input_tokens)) {
+                    pack_starts.push_back(task_idx);
+                    pack_tokens = overhead_tokens;
+                }
+                pack_tokens += prompt_tokens;
+            }
+            pack_starts.push_back(send_requests.size());
+            RunConcurrently(pack_starts.size() - 1, [&](idx_t pack_idx) {
+                auto pack_begin = pack_starts[pack_idx];
+                auto pack_end = pack_starts[pack_idx + 1];
+                auto pack_size = pack_end - pack_begin;
+                if (pack_size > 1) {
+                    vector<reference<const string>> prompts;
+                    for (idx_t task_idx = pack_begin; task_idx < pack_end; task_idx++) {
+                        prompts.push_back(requests[send_requests[task_idx]].prompt);
+                    }
+                    vector<string> answers;
+                    auto start_time = steady_clock::now();
+                    try {
+                        auto packed_template = OpenPromptRequestTemplate::Create(
+                            model_name, structured ? PackedJSONSchema(json_schema, pack_size) : string(),
+                            PackedSystemPrompt(system_prompt, pack_size, structured));
+                        auto packed_prompt = RenderPackedPrompt(prompts);
+                        string body;
+                        packed_template.Render(packed_prompt.c_str(), packed_prompt.size(), body);
+                        auto response = SendOne(body);
+                        if (!response.truncated && ParsePackedAnswers(response.content, pack_size, answers)) {
+                            // The rows of the pack share its latency and split its token usage
+                            auto latency_ms = ElapsedMilliseconds(start_time);
+                            auto tokens = response.prompt_tokens + response.completion_tokens;
+                            for (idx_t i = 0; i < pack_size; i++) {
+                                auto &request = requests[send_requests[pack_begin + i]];
+                                request.response = std::move(answers[i]);
+                                request.success = true;
+                                request.status = 200;
+                                request.latency_ms = latency_ms;
+                                request.tokens = tokens / pack_size + (i < tokens % pack_size ? 1 : 0);
+                                finish_request(send_requests[pack_begin + i], false);
+                            }
+                            return;
+                        }
+                    } catch (std::exception &e) {
+                        // The packed request failed as a whole, every row reports the same error
+                        for (idx_t task_idx = pack_begin; task_idx < pack_end; task_idx++) {
+                            auto request_idx = send_requests[task_idx];
+                            requests[request_idx].status = ErrorStatus(e);
+                            requests[request_idx].latency_ms = ElapsedMilliseconds(start_time);
+                            SetErrorResponse(requests[request_idx].response, e.what());
+                            recorder.RecordError();
+                            finish_request(request_idx, false);
+                        }
+                        return;
+                    }
+                }
+                // A single prompt, or an answer that could not be split per prompt: the rows are sent one by one
+                for (idx_t task_idx = pack_begin; task_idx < pack_end; task_idx++) {
+                    send_single(send_requests[task_idx]);
+                }
+            });
+        } else if (batch_mode == OpenPromptBatchMode::MULTI_PROMPT) {
+            // Consecutive prompts share a completions request of up to openprompt_batch_size prompts, the requests
+            // go through SendOne like any other
+            auto batch_size = MaxValue<idx_t>(batch_options.batch_size, 1);
+            auto batch_count = (send_requests.size() + batch_size - 1) / batch_size;
+            RunConcurrently(batch_count, [&](idx_t batch_idx) {
+                auto batch_begin = batch_idx * batch_size;
+                auto batch_end = MinValue<idx_t>(batch_begin + batch_size, send_requests.size());
+                vector<reference<const string>> prompts;
+                for (idx_t task_idx = batch_begin; task_idx < batch_end; task_idx++) {
+                    prompts.push_back(requests[send_requests[task_idx]].prompt);
+                }
+                vector<OpenPromptBatchResult> batch_results;
+                int32_t error_status = 0;
+                auto start_time = steady_clock::now();
+                try {
+                    string body;
+                    RenderMultiPromptBody(model_name, system_prompt, prompts, body);
+                    auto response = SendOne(body, true);
+                    ParseMultiPromptResponse(response, prompts.size(), batch_results);
+                    recorder.RecordResponse(response);
+                    // The rows of the request split its token usage, as in packed mode
+                    auto tokens = response.prompt_tokens + response.completion_tokens;
+                    for (idx_t i = 0; i < batch_results.size(); i++) {
+                        batch_results[i].tokens =
+                            tokens / batch_results.size() + (i < tokens % batch_results.size() ? 1 : 0);
+                    }
+                } catch (std::exception &e) {
+                    // The request failed as a whole, every row reports the same error
+                    error_status = ErrorStatus(e);
+                    batch_results.assign(prompts.size(), OpenPromptBatchResult());
+                    for (auto &batch_result : batch_results) {
+                        SetErrorResponse(batch_result.response, e.what());
+                    }
+                }
+                auto latency_ms = ElapsedMilliseconds(start_time);
+                for (idx_t task_idx = batch_begin; task_idx < batch_end; task_idx++) {
+                    auto request_idx = send_requests[task_idx];
+                    auto &request = requests[request_idx];
+                    auto &batch_result = batch_results[task_idx - batch_begin];
+                    request.success = batch_result.success;
+                    request.response = std::move(batch_result.response);
+                    request.status = request.success ? 200 : error_status;
+                    request.latency_ms = latency_ms;
+                    request.tokens = batch_result.tokens;
+                    if (!request.success) {
+                        recorder.RecordError();
+                    }
+                    finish_request(request_idx, false);
+                }
+            });
+        } else if (!send_requests.empty()) {
+            vector<OpenPromptBatchResult> batch_results;
+            auto start_time = steady_clock::now();
+            vector<string> batch_bodies;
+            for (auto request_idx : send_requests) {
+                batch_bodies.push_back(requests[request_idx].body);
+            }
+            try {
+                SendBatchAPIRequests(context, *pool, recorder, endpoints->Primary().url, api_token, batch_bodies,
+                                     batch_options, batch_results);
+            } catch (std::runtime_error &e) {
+                // The batch as a whole failed, every row reports the same error
+                batch_results.assign(send_requests.size(), OpenPromptBatchResult());
+                for (auto &batch_result : batch_results) {
+                    SetErrorResponse(batch_result.response, e.what());
+                }
+            }
+            for (idx_t task_idx = 0; task_idx < send_requests.size(); task_idx++) {
+                auto request_idx = send_requests[task_idx];
+                auto &request = requests[request_idx];
+                request.success = batch_results[task_idx].success;
+                request.response = std::move(batch_results[task_idx].response);
+                // Batch results carry no per-row status, rows share the latency of the batch
+                request.status = request.success ? 200 : 0;
+                request.latency_ms = ElapsedMilliseconds(start_time);
+                request.tokens = batch_results[task_idx].tokens;
+                if (!request.success) {
+                    recorder.RecordError();
+                }
+                finish_request(request_idx, false);
+            }
+        }
+    } catch (...) {
+        // Never leave other threads waiting on a request that will not be sent
+        for (auto request_idx : send_requests) {
+            if (!finished[request_idx] && shared_responses[request_idx]) {
+                query_state->Complete(dedup_keys[request_idx], *shared_responses[request_idx], false,
+                                      "Error: Request was not sent");
+            }
+        }
+        throw;
+    }
+
+    for (idx_t request_idx = 0; request_idx < request_count; request_idx++) {
+        if (!owned[request_idx]) {
+            auto &shared_response = *shared_responses[request_idx];
+            shared_response.Wait();
+            requests[request_idx].success = shared_response.success;
+            requests[request_idx].response = shared_response.response;
+            requests[request_idx].status = shared_response.status;
+            requests[request_idx].latency_ms = shared_response.latency_ms;
+        }
+    }
+}
+
+} // namespace duckdb
@@ -0,0 +1,181 @@
+#include "open_prompt_settings.hpp"
+
+#include "duckdb/main/config.hpp"
+
+namespace duckdb {
+
+void OpenPromptSettings::Register(DBConfig &config) {
+    config.AddExtensionOption("openprompt_max_concurrency",
+                              "Maximum number of in-flight open_prompt requests per vector",
+                              LogicalType::UBIGINT, Value::UBIGINT(8));
+    config.AddExtensionOption("openprompt_map_window",
+                              "Maximum number of in-flight requests per thread of open_prompt_map",
+                              LogicalType::UBIGINT, Value::UBIGINT(64));
+    config.AddExtensionOption("openprompt_embedding_batch_size",
+                              "Maximum number of texts per open_embed request",
+                              LogicalType::UBIGINT, Value::UBIGINT(256));
+    config.AddExtensionOption("openprompt_embedding_dimensions",
+                              "Size of the embeddings of the embedding model, 0 probes it once per URL and model",
+                              LogicalType::UBIGINT, Value::UBIGINT(0));
+    config.AddExtensionOption("openprompt_endpoint_max_failures",
+                              "Consecutive connection errors or 5xx responses after which an endpoint is taken out",
+                              LogicalType::UBIGINT, Value::UBIGINT(3));
+    config.AddExtensionOption("openprompt_endpoint_cooldown",
+                              "Seconds an endpoint that kept failing is left out before it is tried again",
+                              LogicalType::DOUBLE, Value::DOUBLE(10));
+    config.AddExtensionOption("openprompt_http_pool_max_per_host",
+                              "Maximum number of connections open at once per host, requests over it wait",
+                              LogicalType::UBIGINT, Value::UBIGINT(64));
+    config.AddExtensionOption("openprompt_http_idle_timeout",
+                              "Seconds an idle keep-alive connection is kept before it is closed",
+                              LogicalType::UBIGINT, Value::UBIGINT(30));
+    config.AddExtensionOption("openprompt_stream",
+                              "Request server-sent event streams so generation can be stopped early",
+                              LogicalType::BOOLEAN, Value::BOOLEAN(false));
+    config.AddExtensionOption("openprompt_max_chars",
+                              "When streaming, stop reading a completion after this many characters, 0 for no limit",
+                              LogicalType::UBIGINT, Value::UBIGINT(0));
+    config.AddExtensionOption("openprompt_stop_pattern",
+                              "When streaming, stop reading a completion once it contains this string",
+                              LogicalType::VARCHAR, Value(""));
+    config.AddExtensionOption("openprompt_requests_per_second",
+                              "Requests per second across all open_prompt calls of the database, 0 for unlimited",
+                              LogicalType::DOUBLE, Value::DOUBLE(0));
+    config.AddExtensionOption("openprompt_tokens_per_minute",
+                              "Estimated prompt tokens per minute across all open_prompt calls, 0 for unlimited",
+                              LogicalType::DOUBLE, Value::DOUBLE(0));
+    config.AddExtensionOption("openprompt_max_inflight",
+                              "Ceiling of the adaptive number of in-flight requests across all threads",
+                              LogicalType::UBIGINT, Value::UBIGINT(256));
+    config.AddExtensionOption("openprompt_max_retries",
+                              "Retries of requests that failed with a transient error (connection errors, 408, 429, 5xx)",
+                              LogicalType::UBIGINT, Value::UBIGINT(3));
+    config.AddExtensionOption("openprompt_retry_base_delay_ms",
+                              "Base delay of the jittered exponential backoff between retries",
+                              LogicalType::UBIGINT, Value::UBIGINT(500));
+    config.AddExtensionOption("openprompt_retry_max_delay_ms",
+                              "Maximum delay between retries",
+                              LogicalType::UBIGINT, Value::UBIGINT(30000));
+    config.AddExtensionOption("openprompt_deduplicate",
+                              "Send identical open_prompt requests only once per query",
+                              LogicalType::BOOLEAN, Value::BOOLEAN(true));
+    config.AddExtensionOption("openprompt_batch_mode",
+                              "How open_prompt requests are sent: none, batch_api, multi_prompt or packed",
+                              LogicalType::VARCHAR, Value("none"));
+    config.AddExtensionOption("openprompt_batch_size",
+                              "Maximum number of prompts per multi_prompt or packed request",
+                              LogicalType::UBIGINT, Value::UBIGINT(64));
+    config.AddExtensionOption("openprompt_max_input_tokens",
+                              "Estimated input tokens per request including the system prompt, 0 for no limit",
+                              LogicalType::UBIGINT, Value::UBIGINT(0));
+    config.AddExtensionOption("openprompt_input_overflow",
+                              "What happens to prompts over openprompt_max_input_tokens: error or truncate",
+                              LogicalType::VARCHAR, Value("error"));
+    config.AddExtensionOption("openprompt_chars_per_token",
+                              "Letters and digits per token of the local token estimator",
+                              LogicalType::DOUBLE, Value::DOUBLE(4));
+    config.AddExtensionOption("openprompt_hedge_percentile",
+                              "Latency percentile of the recent requests after which a duplicate request is sent, "
+                              "0 to disable hedging",
+                              LogicalType::DOUBLE, Value::DOUBLE(0));
+    config.AddExtensionOption("openprompt_hedge_budget",
+                              "Duplicate requests sent for hedging, in percent of all requests",
+                              LogicalType::DOUBLE, Value::DOUBLE(5));
+    config.AddExtensionOption("openprompt_compression",
+                              "Content-Encoding of request bodies: none, gzip or zstd. Compressed responses are "
+                              "accepted when set",
+                              LogicalType::VARCHAR, Value("none"));
+    config.AddExtensionOption("openprompt_compression_level",
+                              "Compression level, 1-9 for gzip and 1-19 for zstd",
+                              LogicalType::UBIGINT, Value::UBIGINT(3));
+    config.AddExtensionOption("openprompt_null_on_error",
+                              "Return NULL for failed requests instead of the error message",
+                              LogicalType::BOOLEAN, Value::BOOLEAN(false));
+    config.AddExtensionOption("openprompt_job_batch_size",
+                              "Rows a background job sends and commits at a time",
+                              LogicalType::UBIGINT, Value::UBIGINT(1024));
+    config.AddExtensionOption("openprompt_batch_poll_interval",
+                              "Seconds between Batch API status checks",
+                              LogicalType::UBIGINT, Value::UBIGINT(10));
+    config.AddExtensionOption("openprompt_batch_timeout",
+                              "Seconds to wait for a Batch API batch before it is cancelled",
+                              LogicalType::UBIGINT, Value::UBIGINT(86400));
+    config.AddExtensionOption("openprompt_agg_chunk_tokens",
+                              "Estimated input tokens of each open_prompt_agg request",
+                              LogicalType::UBIGINT, Value::UBIGINT(4000));
+    config.AddExtensionOption("openprompt_cache_path",
+                              "Path of the persistent open_prompt response cache, empty to disable caching",
+                              LogicalType::VARCHAR, Value(""));
+    config.AddExtensionOption("openprompt_cache_ttl",
+                              "Seconds a cached response stays valid, 0 to never expire",
+                              LogicalType::UBIGINT, Value::UBIGINT(0));
+    config.AddExtensionOption("openprompt_cache_max_bytes",
+                              "Size limit of the response cache, least recently used entries are evicted first",
+                              LogicalType::UBIGINT, Value::UBIGINT(256 * 1024 * 1024));
+    config.AddExtensionOption("openprompt_cache_normalize",
+                              "Ignore case and differences in whitespace when matching requests with the cache",
+                              LogicalType::BOOLEAN, Value::BOOLEAN(false));
+    config.AddExtensionOption("openprompt_cache_strip_patterns",
+                              "Regular expressions removed from request bodies before they are matched with the cache",
+                              LogicalType::LIST(LogicalType::VARCHAR), Value::LIST(LogicalType::VARCHAR, {}));
+    config.AddExtensionOption("openprompt_cache_similarity",
+                              "Reuse the cached response of a prompt at least this similar (0-1), 0 to match exactly",
+                              LogicalType::DOUBLE, Value::DOUBLE(0));
+}
+
+idx_t OpenPromptSettings::GetUBigInt(ClientContext &context, const string &setting_name, idx_t default_value) {
+    Value value;
+    if (!context.TryGetCurrentSetting(setting_name, value) || value.IsNull()) {
+        return default_value;
+    }
+    return value.GetValue<uint64_t>();
+}
+
+double OpenPromptSettings::GetDouble(ClientContext &context, const string &setting_name, double default_value) {
+    Value value;
+    if (!context.TryGetCurrentSetting(setting_name, value) || value.IsNull()) {
+        return default_value;
+    }
+    return value.GetValue<double>();
+}
+
+bool OpenPromptSettings::GetBoolean(ClientContext &context, const string &setting_name, bool default_value) {
+    Value value;
+    if (!context.TryGetCurrentSetting(setting_name, value) || value.IsNull()) {
+        return default_value;
+    }
+    return BooleanValue::Get(value);
+}
+
+string OpenPromptSettings::GetString(ClientContext &context, const string &setting_name) {
+    Value value;
+    if (!context.TryGetCurrentSetting(setting_name, value) || value.IsNull()) {
+        return string();
+    }
+    return value.ToString();
+}
+
+vector<string> OpenPromptSettings::GetStringList(ClientContext &context, const string &setting_name) {
+    vector<string> result;
+    Value value;
+    if (!context.TryGetCurrentSetting(setting_name, value) || value.IsNull()) {
+        return result;
+    }
+    for (auto &child : ListValue::GetChildren(value)) {
+        if (!child.IsNull()) {
+            result.push_back(child.ToString());
+        }
+    }
+    return result;
+}
+
+string OpenPromptSettings::GetVariable(ClientContext &context, const string &var_name, const string &default_value) {
+    Value value;
+    auto &config = ClientConfig::GetConfig(context);
+    if (!config.GetUserVariable(var_name, value) || value.IsNull()) {
+        return default_value;
+    }
+    return value.ToString();
+}
+
+} // namespace duckdb
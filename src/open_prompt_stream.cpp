@@ -0,0 +1,188 @@
+#include "open_prompt_stream.hpp"
+
+#include "yyjson.hpp"
+
+namespace duckdb {
+
+OpenPromptStreamDecoder::OpenPromptStreamDecoder(const OpenPromptStreamOptions &options_p)
+    : options(options_p), start_time(steady_clock::now()) {
+}
+
+bool OpenPromptStreamDecoder::Feed(const char *data, idx_t len) {
+    if (stopped) {
+        return false;
+    }
+    response.bytes_received += len;
+    if (done) {
+        // Whatever follows [DONE] is drained, so that the connection can be reused
+        return true;
+    }
+    buffer.append(data, len);
+    idx_t line_start = 0;
+    while (true) {
+        auto line_end = buffer.find('\n', line_start);
+        if (line_end == string::npos) {
+            break;
+        }
+        auto line_len = line_end - line_start;
+        if (line_len > 0 && buffer[line_end - 1] == '\r') {
+            line_len--;
+        }
+        // Only "data:" fields carry content, comments, event names and blank separators are skipped
+        if (line_len >= 5 && buffer.compare(line_start, 5, "data:") == 0) {
+            auto payload_start = line_start + 5;
+            if (payload_start < line_start + line_len && buffer[payload_start] == ' ') {
+                payload_start++;
+            }
+            HandleEvent(buffer.data() + payload_start, line_start + line_len - payload_start);
+            if (stopped) {
+                return false;
+            }
+            if (done) {
+                buffer.clear();
+                return true;
+            }
+        }
+        line_start = line_end + 1;
+    }
+    buffer.erase(0, line_start);
+    return true;
+}
+
+void OpenPromptStreamDecoder::HandleEvent(const char *data, idx_t len) {
+    if (len == 6 && memcmp(data, "[DONE]", 6) == 0) {
+        done = true;
+        return;
+    }
+    unique_ptr<duckdb_yyjson::yyjson_doc, void (*)(duckdb_yyjson::yyjson_doc *)> doc(
+        duckdb_yyjson::yyjson_read(data, len, 0), &duckdb_yyjson::yyjson_doc_free);
+    if (!doc) {
+        throw std::runtime_error("Failed to parse streamed chunk");
+    }
+    auto root = duckdb_yyjson::yyjson_doc_get_root(doc.get());
+    auto error = duckdb_yyjson::yyjson_obj_get(root, "error");
+    if (error) {
+        auto message = duckdb_yyjson::yyjson_get_str(duckdb_yyjson::yyjson_obj_get(error, "message"));
+        throw std::runtime_error("Stream error: " + string(message ? message : "unknown"));
+    }
+    ParseCompletionUsage(root, response);
+    auto choices = duckdb_yyjson::yyjson_obj_get(root, "choices");
+    auto first_choice = duckdb_yyjson::yyjson_arr_get_first(choices);
+    auto delta = duckdb_yyjson::yyjson_obj_get(first_choice, "delta");
+    auto content = duckdb_yyjson::yyjson_obj_get(delta, "content");
+    auto content_str = duckdb_yyjson::yyjson_get_str(content);
+    if (!content_str) {
+        // Role announcements and the final chunk carry no content
+        return;
+    }
+    auto content_len = duckdb_yyjson::yyjson_get_len(content);
+    if (content_len == 0) {
+        return;
+    }
+    if (token_count == 0) {
+        first_token_time = steady_clock::now();
+    }
+    token_count++;
+    auto previous_size = response.content.size();
+    response.content.append(content_str, content_len);
+    ApplyStopConditions(previous_size);
+}
+
+void OpenPromptStreamDecoder::ApplyStopConditions(idx_t previous_size) {
+    auto &content = response.content;
+    if (!options.stop_pattern.empty()) {
+        // The pattern may straddle the previous chunk, only the new tail has to be searched
+        auto search_start = previous_size >= options.stop_pattern.size() ? previous_size - options.stop_pattern.size() + 1 : 0;
+        auto pos = content.find(options.stop_pattern, search_start);
+        if (pos != string::npos) {
+            content.resize(pos);
+            response.truncated = true;
+        }
+    }
+    if (options.max_chars > 0 && content.size() >= options.max_chars) {
+        if (content.size() > options.max_chars) {
+            // Back up to the start of the code point the limit falls into, so that no UTF-8 sequence is split
+            auto length = options.max_chars;
+            while (length > 0 && (static_cast<uint8_t>(content[length]) & 0xC0) == 0x80) {
+                length--;
+            }
+            content.resize(length);
+        }
+        response.truncated = true;
+    }
+    stopped = response.truncated;
+}
+
+OpenPromptResponse &OpenPromptStreamDecoder::Finalize() {
+    if (token_count > 0) {
+        auto end_time = steady_clock::now();
+        response.time_to_first_token_ms =
+            std::chrono::duration<double, std::milli>(first_token_time - start_time).count();
+        double generation_seconds = std::chrono::duration<double>(end_time - first_token_time).count();
+        if (token_count > 1 && generation_seconds > 0) {
+            response.tokens_per_second = static_cast<double>(token_count - 1) / generation_seconds;
+        }
+    }
+    return response;
+}
+
+OpenPromptResponse PerformStreamingRequest(PooledHTTPClient &client, const HTTPEndpoint &endpoint,
+                                           const duckdb_httplib_openssl::Headers &headers, const string &body,
+                                           const OpenPromptStreamOptions &options) {
+    OpenPromptStreamDecoder decoder(options);
+    int status = 0;
+    string stream_error;
+
+    duckdb_httplib_openssl::Request req;
+    req.method = "POST";
+    req.path = endpoint.path;
+    req.headers = headers;
+    req.headers.emplace("Accept", "text/event-stream");
+    SetRequestBody(req, body);
+    req.response_handler = [&](const duckdb_httplib_openssl::Response &response) {
+        status = response.status;
+        return true;
+    };
+    req.content_receiver = [&](const char *data, size_t data_length, uint64_t, uint64_t) {
+        if (status != 200) {
+            // Error bodies are drained, the status is reported below
+            return true;
+        }
+        // Exceptions must not unwind through httplib, they are rethrown once the request returned
+        try {
+            return decoder.Feed(data, data_length);
+        } catch (std::exception &e) {
+            stream_error = e.what();
+            return false;
+        }
+    };
+
+    auto res = client->send(req);
+    if (!stream_error.empty()) {
+        client.Discard();
+        throw std::runtime_error(stream_error);
+    }
+    if (decoder.Stopped()) {
+        // Reading was cut off by a stop condition, the rest of the response is still on the socket
+        client.Discard();
+        return decoder.Finalize();
+    }
+    if (decoder.Done()) {
+        // The body was read to its end after [DONE], so the connection goes back to the pool
+        if (!res) {
+            client.Discard();
+        }
+        return decoder.Finalize();
+    }
+    if (!res) {
+        client.Discard();
+        HandleHttpError(res, "POST");
+    }
+    if (res->status != 200) {
+        HandleHttpStatus(*res);
+    }
+    // The server closed the stream without [DONE], keep what was received
+    return decoder.Finalize();
+}
+
+} // namespace duckdb
@@ -0,0 +1,215 @@
+#include "open_prompt_struct.hpp"
+
+#include "duckdb/common/exception/binder_exception.hpp"
+#include "yyjson.hpp"
+
+namespace duckdb {
+
+using duckdb_yyjson::yyjson_val;
+
+//! The "type" of a schema node, the first non-null entry when it is a list of types
+static string GetSchemaType(yyjson_val *schema) {
+    auto type = duckdb_yyjson::yyjson_obj_get(schema, "type");
+    if (duckdb_yyjson::yyjson_is_str(type)) {
+        return duckdb_yyjson::yyjson_get_str(type);
+    }
+    if (duckdb_yyjson::yyjson_is_arr(type)) {
+        duckdb_yyjson::yyjson_arr_iter iter;
+        duckdb_yyjson::yyjson_arr_iter_init(type, &iter);
+        yyjson_val *entry;
+        while ((entry = duckdb_yyjson::yyjson_arr_iter_next(&iter))) {
+            auto entry_str = duckdb_yyjson::yyjson_get_str(entry);
+            if (entry_str && string(entry_str) != "null") {
+                return entry_str;
+            }
+        }
+    }
+    if (duckdb_yyjson::yyjson_obj_get(schema, "properties")) {
+        return "object";
+    }
+    if (duckdb_yyjson::yyjson_obj_get(schema, "enum")) {
+        return "string";
+    }
+    return string();
+}
+
+static LogicalType SchemaNodeToLogicalType(yyjson_val *schema) {
+    auto type = GetSchemaType(schema);
+    if (type == "string") {
+        return LogicalType::VARCHAR;
+    }
+    if (type == "integer") {
+        return LogicalType::BIGINT;
+    }
+    if (type == "number") {
+        return LogicalType::DOUBLE;
+    }
+    if (type == "boolean") {
+        return LogicalType::BOOLEAN;
+    }
+    if (type == "array") {
+        auto items = duckdb_yyjson::yyjson_obj_get(schema, "items");
+        if (!duckdb_yyjson::yyjson_is_obj(items)) {
+            return LogicalType::LIST(LogicalType::VARCHAR);
+        }
+        return LogicalType::LIST(SchemaNodeToLogicalType(items));
+    }
+    if (type == "object") {
+        auto properties = duckdb_yyjson::yyjson_obj_get(schema, "properties");
+        if (!duckdb_yyjson::yyjson_is_obj(properties) || duckdb_yyjson::yyjson_obj_size(properties) == 0) {
+            // A free-form object has no fixed set of fields, keep its JSON text
+            return LogicalType::VARCHAR;
+        }
+        child_list_t<LogicalType> children;
+        duckdb_yyjson::yyjson_obj_iter iter;
+        duckdb_yyjson::yyjson_obj_iter_init(properties, &iter);
+        yyjson_val *key;
+        while ((key = duckdb_yyjson::yyjson_obj_iter_next(&iter))) {
+            string name(duckdb_yyjson::yyjson_get_str(key), duckdb_yyjson::yyjson_get_len(key));
+            auto child_schema = duckdb_yyjson::yyjson_obj_iter_get_val(key);
+            children.emplace_back(name, SchemaNodeToLogicalType(child_schema));
+        }
+        return LogicalType::STRUCT(std::move(children));
+    }
+    // anyOf, oneOf, $ref and untyped nodes
+    return LogicalType::VARCHAR;
+}
+
+LogicalType JSONSchemaToStructType(const string &json_schema) {
+    unique_ptr<duckdb_yyjson::yyjson_doc, void (*)(duckdb_yyjson::yyjson_doc *)> doc(
+        duckdb_yyjson::yyjson_read(json_schema.c_str(), json_schema.size(), 0), &duckdb_yyjson::yyjson_doc_free);
+    if (!doc) {
+        throw BinderException("open_prompt_struct: json_schema is not valid JSON");
+    }
+    auto root = duckdb_yyjson::yyjson_doc_get_root(doc.get());
+    // Accept the {"name": ..., "schema": {...}} wrapper of the json_schema response format as well
+    auto wrapped = duckdb_yyjson::yyjson_obj_get(root, "schema");
+    if (duckdb_yyjson::yyjson_is_obj(wrapped) && !duckdb_yyjson::yyjson_obj_get(root, "properties")) {
+        root = wrapped;
+    }
+    auto type = SchemaNodeToLogicalType(root);
+    if (type.id() != LogicalTypeId::STRUCT) {
+        throw BinderException("open_prompt_struct: json_schema must describe an object with properties");
+    }
+    return type;
+}
+
+//! The JSON text of a value, for VARCHAR columns that received something other than a string
+static string WriteJSONText(yyjson_val *val) {
+    size_t len;
+    auto json = duckdb_yyjson::yyjson_val_write(val, 0, &len);
+    if (!json) {
+        return string();
+    }
+    string result(json, len);
+    free(json);
+    return result;
+}
+
+void WriteJSONValue(yyjson_val *val, Vector &result, idx_t row) {
+    if (!val || duckdb_yyjson::yyjson_is_null(val)) {
+        FlatVector::SetNull(result, row, true);
+        return;
+    }
+    auto &type = result.GetType();
+    switch (type.id()) {
+    case LogicalTypeId::VARCHAR: {
+        auto data = FlatVector::GetData<string_t>(result);
+        if (duckdb_yyjson::yyjson_is_str(val)) {
+            data[row] = StringVector::AddString(result, duckdb_yyjson::yyjson_get_str(val),
+                                                duckdb_yyjson::yyjson_get_len(val));
+        } else {
+            data[row] = StringVector::AddString(result, WriteJSONText(val));
+        }
+        break;
+    }
+    case LogicalTypeId::BIGINT: {
+        auto data = FlatVector::GetData<int64_t>(result);
+        if (duckdb_yyjson::yyjson_is_sint(val)) {
+            data[row] = duckdb_yyjson::yyjson_get_sint(val);
+        } else if (duckdb_yyjson::yyjson_is_uint(val) &&
+                   duckdb_yyjson::yyjson_get_uint(val) <= static_cast<uint64_t>(NumericLimits<int64_t>::Maximum())) {
+            data[row] = static_cast<int64_t>(duckdb_yyjson::yyjson_get_uint(val));
+        } else if (duckdb_yyjson::yyjson_is_real(val)) {
+            // Models sometimes answer 3.0 for an integer
+            double num = duckdb_yyjson::yyjson_get_real(val);
+            if (num < static_cast<double>(NumericLimits<int64_t>::Minimum()) ||
+                num > static_cast<double>(NumericLimits<int64_t>::Maximum())) {
+                FlatVector::SetNull(result, row, true);
+            } else {
+                data[row] = static_cast<int64_t>(num);
+            }
+        } else {
+            FlatVector::SetNull(result, row, true);
+        }
+        break;
+    }
+    case LogicalTypeId::DOUBLE: {
+        if (duckdb_yyjson::yyjson_is_num(val)) {
+            FlatVector::GetData<double>(result)[row] = duckdb_yyjson::yyjson_get_num(val);
+        } else {
+            FlatVector::SetNull(result, row, true);
+        }
+        break;
+    }
+    case LogicalTypeId::BOOLEAN: {
+        if (duckdb_yyjson::yyjson_is_bool(val)) {
+            FlatVector::GetData<bool>(result)[row] = duckdb_yyjson::yyjson_get_bool(val);
+        } else {
+            FlatVector::SetNull(result, row, true);
+        }
+        break;
+    }
+    case LogicalTypeId::LIST: {
+        if (!duckdb_yyjson::yyjson_is_arr(val)) {
+            FlatVector::SetNull(result, row, true);
+            break;
+        }
+        auto length = duckdb_yyjson::yyjson_arr_size(val);
+        auto offset = ListVector::GetListSize(result);
+        ListVector::Reserve(result, offset + length);
+        auto &list_entry = FlatVector::GetData<list_entry_t>(result)[row];
+        list_entry.offset = offset;
+        list_entry.length = length;
+        auto &child = ListVector::GetEntry(result);
+        duckdb_yyjson::yyjson_arr_iter iter;
+        duckdb_yyjson::yyjson_arr_iter_init(val, &iter);
+        yyjson_val *element;
+        idx_t child_row = offset;
+        while ((element = duckdb_yyjson::yyjson_arr_iter_next(&iter))) {
+            WriteJSONValue(element, child, child_row++);
+        }
+        ListVector::SetListSize(result, offset + length);
+        break;
+    }
+    case LogicalTypeId::STRUCT: {
+        if (!duckdb_yyjson::yyjson_is_obj(val)) {
+            FlatVector::SetNull(result, row, true);
+            break;
+        }
+        auto &child_types = StructType::GetChildTypes(type);
+        auto &children = StructVector::GetEntries(result);
+        for (idx_t i = 0; i < child_types.size(); i++) {
+            auto &name = child_types[i].first;
+            WriteJSONValue(duckdb_yyjson::yyjson_obj_getn(val, name.c_str(), name.size()), *children[i], row);
+        }
+        break;
+    }
+    default:
+        throw InternalException("open_prompt_struct: unsupported type %s", type.ToString());
+    }
+}
+
+OpenPromptJSONContent::OpenPromptJSONContent(const string &content)
+    : doc(duckdb_yyjson::yyjson_read(content.c_str(), content.size(), 0)) {
+}
+
+OpenPromptJSONContent::~OpenPromptJSONContent() {
+    duckdb_yyjson::yyjson_doc_free(doc);
+}
+
+yyjson_val *OpenPromptJSONContent::Root() const {
+    return doc ? duckdb_yyjson::yyjson_doc_get_root(doc) : nullptr;
+}
+
+} // namespace duckdb
@@ -0,0 +1,121 @@
+#include "open_prompt_template.hpp"
+#include "open_prompt_request.hpp"
+
+#include "duckdb/common/exception/binder_exception.hpp"
+
+namespace duckdb {
+
+static bool IsPlaceholderChar(char c, bool first) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || (!first && c >= '0' && c <= '9');
+}
+
+OpenPromptTextTemplate OpenPromptTextTemplate::Parse(const string &text,
+                                                     const case_insensitive_map_t<idx_t> &arguments) {
+    OpenPromptTextTemplate result;
+    result.text = text;
+    string literal;
+    auto flush_literal = [&]() {
+        if (literal.empty()) {
+            return;
+        }
+        Segment segment;
+        AppendJSONEscaped(segment.escaped_literal, literal.c_str(), literal.size());
+        segment.literal = std::move(literal);
+        result.literal_size += segment.literal.size();
+        result.segments.push_back(std::move(segment));
+        literal.clear();
+    };
+    for (idx_t i = 0; i < text.size(); i++) {
+        auto c = text[i];
+        if ((c == '{' || c == '}') && i + 1 < text.size() && text[i + 1] == c) {
+            literal += c;
+            i++;
+            continue;
+        }
+        if (c != '{') {
+            literal += c;
+            continue;
+        }
+        // "{name}" is a placeholder, any other brace is literal text, e.g. a JSON example in the prompt
+        idx_t end = i + 1;
+        while (end < text.size() && IsPlaceholderChar(text[end], end == i + 1)) {
+            end++;
+        }
+        if (end == i + 1 || end >= text.size() || text[end] != '}') {
+            literal += c;
+            continue;
+        }
+        auto name = text.substr(i + 1, end - i - 1);
+        auto entry = arguments.find(name);
+        if (entry == arguments.end()) {
+            throw BinderException("open_prompt_template: no argument for placeholder {%s}, pass it as %s := <value>",
+                                  name, name);
+        }
+        flush_literal();
+        Segment segment;
+        segment.argument = entry->second;
+        result.segments.push_back(std::move(segment));
+        if (std::find(result.arguments.begin(), result.arguments.end(), entry->second) == result.arguments.end()) {
+            result.arguments.push_back(entry->second);
+        }
+        i = end;
+    }
+    flush_literal();
+    for (auto &entry : arguments) {
+        if (std::find(result.arguments.begin(), result.arguments.end(), entry.second) == result.arguments.end()) {
+            throw BinderException("open_prompt_template: argument \"%s\" is not used by the template", entry.first);
+        }
+    }
+    return result;
+}
+
+idx_t OpenPromptTextTemplate::RenderedSize(const vector<string_t> &values) const {
+    idx_t size = literal_size;
+    for (auto &segment : segments) {
+        if (segment.argument != DConstants::INVALID_INDEX) {
+            size += values[segment.argument].GetSize();
+        }
+    }
+    return size;
+}
+
+idx_t OpenPromptTextTemplate::EstimateTokens(const vector<string_t> &values,
+                                             const OpenPromptTokenEstimator &estimator) const {
+    idx_t tokens = 0;
+    for (auto &segment : segments) {
+        if (segment.argument == DConstants::INVALID_INDEX) {
+            tokens += estimator.Estimate(segment.literal);
+        } else {
+            auto &value = values[segment.argument];
+            tokens += estimator.Estimate(value.GetData(), value.GetSize());
+        }
+    }
+    return tokens;
+}
+
+void OpenPromptTextTemplate::AppendEscaped(string &out, const vector<string_t> &values) const {
+    for (auto &segment : segments) {
+        if (segment.argument == DConstants::INVALID_INDEX) {
+            out += segment.escaped_literal;
+        } else {
+            auto &value = values[segment.argument];
+            AppendJSONEscaped(out, value.GetData(), value.GetSize());
+        }
+    }
+}
+
+string OpenPromptTextTemplate::Render(const vector<string_t> &values) const {
+    string result;
+    result.reserve(RenderedSize(values));
+    for (auto &segment : segments) {
+        if (segment.argument == DConstants::INVALID_INDEX) {
+            result += segment.literal;
+        } else {
+            auto &value = values[segment.argument];
+            result.append(value.GetData(), value.GetSize());
+        }
+    }
+    return result;
+}
+
+} // namespace duckdb
@@ -0,0 +1,204 @@
+#include "open_prompt_tokens.hpp"
+#include "open_prompt_settings.hpp"
+
+#include "duckdb/common/string_util.hpp"
+#include "duckdb/common/vector_operations/binary_executor.hpp"
+#include "duckdb/common/vector_operations/ternary_executor.hpp"
+#include "duckdb/common/vector_operations/unary_executor.hpp"
+#include "duckdb/planner/expression/bound_function_expression.hpp"
+
+#include <cmath>
+
+namespace duckdb {
+
+OpenPromptTokenEstimator::OpenPromptTokenEstimator(double chars_per_token_p)
+    : chars_per_token(chars_per_token_p > 0 ? chars_per_token_p : 4) {
+}
+
+static bool IsWordChar(unsigned char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9');
+}
+
+static bool IsSpace(unsigned char c) {
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\f' || c == '\v';
+}
+
+idx_t OpenPromptTokenEstimator::Scan(const char *str, idx_t len, idx_t max_tokens, idx_t &tokens) const {
+    tokens = 0;
+    // Tokens counted for the current run of word characters, and its length so far
+    idx_t run_tokens = 0;
+    idx_t run_length = 0;
+    for (idx_t i = 0; i < len; i++) {
+        auto c = static_cast<unsigned char>(str[i]);
+        idx_t added = 0;
+        if (IsWordChar(c)) {
+            run_length++;
+            auto new_run_tokens = static_cast<idx_t>(std::ceil(static_cast<double>(run_length) / chars_per_token));
+            added = new_run_tokens - run_tokens;
+            run_tokens = new_run_tokens;
+        } else {
+            run_length = 0;
+            run_tokens = 0;
+            // Continuation bytes belong to the code point that was already counted
+            added = IsSpace(c) || (c & 0xC0) == 0x80 ? 0 : 1;
+        }
+        if (tokens + added > max_tokens) {
+            return i;
+        }
+        tokens += added;
+    }
+    return len;
+}
+
+idx_t OpenPromptTokenEstimator::Estimate(const char *str, idx_t len) const {
+    idx_t tokens;
+    Scan(str, len, NumericLimits<idx_t>::Maximum(), tokens);
+    return tokens;
+}
+
+idx_t OpenPromptTokenEstimator::TruncateLength(const char *str, idx_t len, idx_t max_tokens) const {
+    idx_t tokens;
+    return Scan(str, len, max_tokens, tokens);
+}
+
+vector<string> OpenPromptTokenEstimator::Chunk(const char *str, idx_t len, idx_t max_tokens,
+                                                idx_t overlap_tokens) const {
+    vector<string> chunks;
+    max_tokens = MaxValue<idx_t>(max_tokens, 1);
+    // The overlap is converted to characters, it only has to be roughly right
+    auto overlap_chars = static_cast<idx_t>(static_cast<double>(MinValue(overlap_tokens, max_tokens / 2)) *
+                                            chars_per_token);
+    idx_t start = 0;
+    idx_t previous_end = 0;
+    while (start < len) {
+        idx_t tokens;
+        auto end = start + Scan(str + start, len - start, max_tokens, tokens);
+        if (end < len) {
+            // Prefer to end at whitespace in the second half of the chunk
+            auto split = end;
+            while (split > start + (end - start) / 2 && !IsSpace(static_cast<unsigned char>(str[split - 1]))) {
+                split--;
+            }
+            if (split > start + (end - start) / 2) {
+                end = split;
+            }
+            if (end == start) {
+                // A single code point over the budget, take it anyway so that the split always progresses
+                end++;
+                while (end < len && (static_cast<unsigned char>(str[end]) & 0xC0) == 0x80) {
+                    end++;
+                }
+            }
+        }
+        if (end <= previous_end && start < previous_end) {
+            // The overlap left no room for new text, continue right after the previous chunk instead
+            start = previous_end;
+            continue;
+        }
+        chunks.emplace_back(str + start, end - start);
+        if (end >= len) {
+            break;
+        }
+        previous_end = end;
+        // The next chunk starts `overlap_chars` back, moved forward to the start of a word
+        auto next = end > start + overlap_chars ? end - overlap_chars : end;
+        while (next < end && next > start && !IsSpace(static_cast<unsigned char>(str[next - 1]))) {
+            next++;
+        }
+        start = next > start ? next : end;
+    }
+    return chunks;
+}
+
+OpenPromptOverflowMode ParseOverflowMode(const string &mode) {
+    auto lmode = StringUtil::Lower(mode);
+    if (lmode.empty() || lmode == "error") {
+        return OpenPromptOverflowMode::REJECT;
+    } else if (lmode == "truncate") {
+        return OpenPromptOverflowMode::TRUNCATE;
+    }
+    throw InvalidInputException("Unsupported openprompt_input_overflow \"%s\", expected error or truncate", mode);
+}
+
+struct OpenPromptTokensData : public FunctionData {
+    double chars_per_token = 4;
+
+    unique_ptr<FunctionData> Copy() const override {
+        return make_uniq<OpenPromptTokensData>(*this);
+    }
+    bool Equals(const FunctionData &other_p) const override {
+        return chars_per_token == other_p.Cast<OpenPromptTokensData>().chars_per_token;
+    }
+};
+
+static unique_ptr<FunctionData> OpenPromptTokensBind(ClientContext &context, ScalarFunction &bound_function,
+                                                     vector<unique_ptr<Expression>> &arguments) {
+    auto res = make_uniq<OpenPromptTokensData>();
+    res->chars_per_token = OpenPromptSettings::GetDouble(context, "openprompt_chars_per_token", 4);
+    return std::move(res);
+}
+
+static OpenPromptTokenEstimator GetEstimator(ExpressionState &state) {
+    auto &func_expr = state.expr.Cast<BoundFunctionExpression>();
+    return OpenPromptTokenEstimator(func_expr.bind_info->Cast<OpenPromptTokensData>().chars_per_token);
+}
+
+static void OpenPromptTokenCountFunction(DataChunk &args, ExpressionState &state, Vector &result) {
+    auto estimator = GetEstimator(state);
+    UnaryExecutor::Execute<string_t, int64_t>(args.data[0], result, args.size(), [&](string_t text) {
+        return static_cast<int64_t>(estimator.Estimate(text.GetData(), text.GetSize()));
+    });
+}
+
+//! Append the chunks of `text` to the list vector `result` and return its entry
+static list_entry_t AppendChunks(Vector &result, const OpenPromptTokenEstimator &estimator, string_t text,
+                                 int64_t max_tokens, int64_t overlap_tokens) {
+    if (max_tokens <= 0 || overlap_tokens < 0) {
+        throw InvalidInputException("open_prompt_chunk: max_tokens must be positive and overlap_tokens not negative");
+    }
+    auto chunks = estimator.Chunk(text.GetData(), text.GetSize(), static_cast<idx_t>(max_tokens),
+                                  static_cast<idx_t>(overlap_tokens));
+    auto offset = ListVector::GetListSize(result);
+    ListVector::Reserve(result, offset + chunks.size());
+    auto &child = ListVector::GetEntry(result);
+    auto child_data = FlatVector::GetData<string_t>(child);
+    for (idx_t i = 0; i < chunks.size(); i++) {
+        child_data[offset + i] = StringVector::AddString(child, chunks[i]);
+    }
+    ListVector::SetListSize(result, offset + chunks.size());
+    return list_entry_t(offset, chunks.size());
+}
+
+static void OpenPromptChunkFunction(DataChunk &args, ExpressionState &state, Vector &result) {
+    auto estimator = GetEstimator(state);
+    if (args.ColumnCount() == 2) {
+        BinaryExecutor::Execute<string_t, int64_t, list_entry_t>(
+            args.data[0], args.data[1], result, args.size(), [&](string_t text, int64_t max_tokens) {
+                return AppendChunks(result, estimator, text, max_tokens, 0);
+            });
+    } else {
+        TernaryExecutor::Execute<string_t, int64_t, int64_t, list_entry_t>(
+            args.data[0], args.data[1], args.data[2], result, args.size(),
+            [&](string_t text, int64_t max_tokens, int64_t overlap_tokens) {
+                return AppendChunks(result, estimator, text, max_tokens, overlap_tokens);
+            });
+    }
+}
+
+ScalarFunction GetOpenPromptTokenCountFunction() {
+    return ScalarFunction("open_prompt_token_count", {LogicalType::VARCHAR}, LogicalType::BIGINT,
+                          OpenPromptTokenCountFunction, OpenPromptTokensBind);
+}
+
+ScalarFunctionSet GetOpenPromptChunkFunction() {
+    ScalarFunctionSet open_prompt_chunk("open_prompt_chunk");
+    auto return_type = LogicalType::LIST(LogicalType::VARCHAR);
+    open_prompt_chunk.AddFunction(ScalarFunction({LogicalType::VARCHAR, LogicalType::BIGINT}, return_type,
+                                                 OpenPromptChunkFunction, OpenPromptTokensBind));
+    open_prompt_chunk.AddFunction(
+        ScalarFunction({LogicalType::VARCHAR, LogicalType::BIGINT, LogicalType::BIGINT}, return_type,
+                       OpenPromptChunkFunction, OpenPromptTokensBind));
+    return open_prompt_chunk;
+}
+
+} // namespace duckdb
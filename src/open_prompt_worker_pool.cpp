@@ -0,0 +1,146 @@
+#include "open_prompt_worker_pool.hpp"
+
+#include "duckdb/common/atomic.hpp"
+
+#include <algorithm>
+
+namespace duckdb {
+
+struct OpenPromptWorkerPool::Job {
+    Job(const std::function<void(idx_t)> &task_p, idx_t task_count_p, idx_t helper_slots_p)
+        : task(task_p), task_count(task_count_p), helper_slots(helper_slots_p) {
+    }
+
+    const std::function<void(idx_t)> &task;
+    idx_t task_count;
+    atomic<idx_t> next_task {0};
+    //! Pool threads that may still join, guarded by the pool lock
+    idx_t helper_slots;
+
+    mutex lock;
+    std::condition_variable finished;
+    idx_t finished_tasks = 0;
+};
+
+OpenPromptWorkerPool::~OpenPromptWorkerPool() {
+    {
+        lock_guard<mutex> guard(lock);
+        shutdown = true;
+    }
+    work_available.notify_all();
+    for (auto &thread : threads) {
+        thread.join();
+    }
+}
+
+shared_ptr<OpenPromptWorkerPool> OpenPromptWorkerPool::Get(ClientContext &context) {
+    auto &cache = ObjectCache::GetObjectCache(context);
+    return cache.GetOrCreate<OpenPromptWorkerPool>(ObjectType());
+}
+
+idx_t OpenPromptWorkerPool::ThreadCount() {
+    lock_guard<mutex> guard(lock);
+    return threads.size();
+}
+
+void OpenPromptWorkerPool::RunTasks(Job &job) {
+    while (true) {
+        idx_t task_idx = job.next_task++;
+        if (task_idx >= job.task_count) {
+            return;
+        }
+        job.task(task_idx);
+        bool done;
+        {
+            lock_guard<mutex> guard(job.lock);
+            done = ++job.finished_tasks == job.task_count;
+        }
+        if (done) {
+            job.finished.notify_all();
+        }
+    }
+}
+
+void OpenPromptWorkerPool::Run(idx_t task_count, idx_t max_concurrency, const std::function<void(idx_t)> &task) {
+    if (task_count == 0) {
+        return;
+    }
+    idx_t helper_count = MinValue<idx_t>(task_count, MaxValue<idx_t>(max_concurrency, 1)) - 1;
+    if (helper_count == 0) {
+        for (idx_t i = 0; i < task_count; i++) {
+            task(i);
+        }
+        return;
+    }
+
+    auto job = make_shared_ptr<Job>(task, task_count, helper_count);
+    {
+        lock_guard<mutex> guard(lock);
+        jobs.push_back(job);
+        // Idle threads may be claimed by other jobs first, the caller takes tasks as well so that the job always
+        // makes progress
+        while (idle_threads < helper_count && threads.size() < MAX_THREADS) {
+            threads.emplace_back([this]() { WorkerLoop(); });
+            idle_threads++;
+        }
+    }
+    work_available.notify_all();
+
+    RunTasks(*job);
+    {
+        std::unique_lock<mutex> guard(job->lock);
+        job->finished.wait(guard, [&]() { return job->finished_tasks == job->task_count; });
+    }
+    // The task is owned by the caller, the job must not be picked up once Run returned
+    lock_guard<mutex> guard(lock);
+    auto position = std::find(jobs.begin(), jobs.end(), job);
+    if (position != jobs.end()) {
+        jobs.erase(position);
+    }
+}
+
+void OpenPromptWorkerPool::Submit(std::function<void()> task) {
+    {
+        lock_guard<mutex> guard(lock);
+        tasks.push_back(std::move(task));
+        if (idle_threads < tasks.size() && threads.size() < MAX_THREADS) {
+            threads.emplace_back([this]() { WorkerLoop(); });
+            idle_threads++;
+        }
+    }
+    work_available.notify_one();
+}
+
+void OpenPromptWorkerPool::WorkerLoop() {
+    while (true) {
+        shared_ptr<Job> job;
+        std::function<void()> task;
+        {
+            std::unique_lock<mutex> guard(lock);
+            work_available.wait(guard, [&]() { return shutdown || !jobs.empty() || !tasks.empty(); });
+            if (shutdown) {
+                return;
+            }
+            // Jobs have a caller blocked on them, they go before submitted tasks
+            if (!jobs.empty()) {
+                job = jobs.front();
+                if (--job->helper_slots == 0 || job->next_task >= job->task_count) {
+                    jobs.pop_front();
+                }
+            } else {
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            idle_threads--;
+        }
+        if (job) {
+            RunTasks(*job);
+        } else {
+            task();
+        }
+        lock_guard<mutex> guard(lock);
+        idle_threads++;
+    }
+}
+
+} // namespace duckdb
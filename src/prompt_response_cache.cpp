@@ -0,0 +1,312 @@
+#include "prompt_response_cache.hpp"
+
+#include <openssl/sha.h>
+
+#include <chrono>
+#include <cstdio>
+#include <sstream>
+
+#ifdef _WIN32
+#include "duckdb/common/windows.hpp"
+#endif
+
+namespace duckdb {
+
+// Per entry overhead accounted on top of the value: the key, timestamp and bookkeeping
+static constexpr idx_t ENTRY_OVERHEAD = 96;
+
+static int64_t CurrentEpochSeconds() {
+    return std::chrono::duration_cast<std::chrono::seconds>(
+               std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+PromptResponseCache::PromptResponseCache(string path_p) : path(std::move(path_p)) {
+}
+
+shared_ptr<PromptResponseCache> PromptResponseCache::Get(ClientContext &context, const string &path) {
+    auto &cache = ObjectCache::GetObjectCache(context);
+    return cache.GetOrCreate<PromptResponseCache>(ObjectType() + ":" + path, path);
+}
+
+string PromptResponseCache::ComputeKey(const string &api_url, const string &request_body) {
+    static const char *HEX_DIGITS = "0123456789abcdef";
+    string input;
+    input.reserve(api_url.size() + request_body.size() + 1);
+    input += api_url;
+    input += '\n';
+    input += request_body;
+
+    unsigned char digest[SHA256_DIGEST_LENGTH];
+    SHA256(reinterpret_cast<const unsigned char *>(input.data()), input.size(), digest);
+    string key;
+    key.reserve(SHA256_DIGEST_LENGTH * 2);
+    for (idx_t i = 0; i < SHA256_DIGEST_LENGTH; i++) {
+        key += HEX_DIGITS[digest[i] >> 4];
+        key += HEX_DIGITS[digest[i] & 0xF];
+    }
+    return key;
+}
+
+void PromptResponseCache::Configure(idx_t ttl_seconds_p, idx_t max_bytes_p) {
+    lock_guard<mutex> guard(lock);
+    ttl_seconds = ttl_seconds_p;
+    max_bytes = max_bytes_p;
+}
+
+bool PromptResponseCache::IsExpired(const Entry &entry, int64_t now) const {
+    return ttl_seconds > 0 && now - entry.created > static_cast<int64_t>(ttl_seconds);
+}
+
+void PromptResponseCache::EraseLocked(unordered_map<string, Entry>::iterator entry) {
+    total_bytes -= entry->second.value.size() + ENTRY_OVERHEAD;
+    lru.erase(entry->second.lru_position);
+    entries.erase(entry);
+}
+
+void PromptResponseCache::EvictLocked() {
+    while (total_bytes > max_bytes && !lru.empty()) {
+        EraseLocked(entries.find(lru.back()));
+        evictions++;
+    }
+}
+
+// Replace `target` with `source`, an existing target is overwritten in one step
+static bool ReplaceFile(const string &source, const string &target) {
+#ifdef _WIN32
+    // rename fails on Windows when the target exists
+    return MoveFileExA(source.c_str(), target.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    return std::rename(source.c_str(), target.c_str()) == 0;
+#endif
+}
+
+bool PromptResponseCache::Find(const string &key, string &result) {
+    lock_guard<mutex> guard(lock);
+    LoadLocked();
+    auto entry = entries.find(key);
+    if (entry == entries.end()) {
+        misses++;
+        return false;
+    }
+    if (IsExpired(entry->second, CurrentEpochSeconds())) {
+        EraseLocked(entry);
+        expirations++;
+        misses++;
+        return false;
+    }
+    lru.splice(lru.begin(), lru, entry->second.lru_position);
+    result = entry->second.value;
+    hits++;
+    return true;
+}
+
+void PromptResponseCache::Insert(const string &key, const string &value) {
+    lock_guard<mutex> guard(lock);
+    LoadLocked();
+    auto existing = entries.find(key);
+    if (existing != entries.end()) {
+        EraseLocked(existing);
+    }
+    lru.push_front(key);
+    auto &entry = entries[key];
+    entry.value = value;
+    entry.created = CurrentEpochSeconds();
+    entry.lru_position = lru.begin();
+    total_bytes += value.size() + ENTRY_OVERHEAD;
+    EvictLocked();
+    if (memory_only) {
+        return;
+    }
+    // Inserts run on request workers, where an exception would end the process. A failed write, e.g. on a full
+    // disk, leaves the entry in memory only, and the next insert rewrites the whole log instead of appending to
+    // a log that may end in a partial record
+    try {
+        auto inserted = entries.find(key);
+        if (log_damaged) {
+            CompactLocked();
+        } else if (inserted != entries.end()) {
+            // Entries over the size limit are evicted right away and not logged
+            AppendLocked(key, inserted->second);
+        }
+        // Evicted and overwritten entries stay in the log until it is compacted
+        if (log_bytes > 2 * MaxValue<idx_t>(total_bytes, 1024 * 1024)) {
+            CompactLocked();
+        }
+    } catch (std::exception &) {
+        log_damaged = true;
+        write_failures++;
+    }
+}
+
+void PromptResponseCache::InsertSimilar(const string &key, uint64_t context, uint64_t fingerprint) {
+    lock_guard<mutex> guard(lock);
+    similarity_index.Insert(context, fingerprint, key);
+}
+
+bool PromptResponseCache::FindSimilar(uint64_t context, uint64_t fingerprint, idx_t max_distance, string &result) {
+    lock_guard<mutex> guard(lock);
+    LoadLocked();
+    auto now = CurrentEpochSeconds();
+    // Evicted and expired entries stay in the index until their slot is reused, so take the closest live one
+    for (auto &key : similarity_index.Find(context, fingerprint, max_distance)) {
+        auto entry = entries.find(key);
+        if (entry == entries.end() || IsExpired(entry->second, now)) {
+            continue;
+        }
+        lru.splice(lru.begin(), lru, entry->second.lru_position);
+        result = entry->second.value;
+        approximate_hits++;
+        return true;
+    }
+    return false;
+}
+
+idx_t PromptResponseCache::Clear() {
+    lock_guard<mutex> guard(lock);
+    LoadLocked();
+    auto removed = entries.size();
+    entries.clear();
+    lru.clear();
+    similarity_index.Clear();
+    total_bytes = 0;
+    OpenLogLocked(std::ios::binary | std::ios::trunc);
+    log_bytes = 0;
+    log_damaged = false;
+    memory_only = false;
+    return removed;
+}
+
+PromptResponseCacheStats PromptResponseCache::GetStats() {
+    lock_guard<mutex> guard(lock);
+    LoadLocked();
+    return {path, entries.size(), total_bytes, hits, misses, evictions, expirations, write_failures,
+            similarity_index.Size(), approximate_hits};
+}
+
+void PromptResponseCache::OpenLogLocked(std::ios::openmode mode) {
+    if (log.is_open()) {
+        log.close();
+    }
+    log.open(path, mode);
+    if (!log.is_open()) {
+        throw IOException("Could not open open_prompt response cache \"%s\"", path);
+    }
+}
+
+// Log records are "<key> <created> <length>\n<value>\n"
+void PromptResponseCache::AppendLocked(const string &key, const Entry &entry) {
+    if (!log.is_open()) {
+        throw IOException("open_prompt response cache \"%s\" is not open", path);
+    }
+    std::ostringstream header;
+    header << key << ' ' << entry.created << ' ' << entry.value.size() << '\n';
+    auto header_str = header.str();
+    log.write(header_str.data(), header_str.size());
+    log.write(entry.value.data(), entry.value.size());
+    log.put('\n');
+    log.flush();
+    if (!log) {
+        throw IOException("Could not write open_prompt response cache \"%s\"", path);
+    }
+    log_bytes += header_str.size() + entry.value.size() + 1;
+}
+
+void PromptResponseCache::LoadLocked() {
+    if (loaded) {
+        return;
+    }
+    entries.clear();
+    lru.clear();
+    total_bytes = 0;
+    log_bytes = 0;
+
+    bool truncated = false;
+    std::ifstream input(path, std::ios::binary);
+    if (input.is_open()) {
+        auto now = CurrentEpochSeconds();
+        string key;
+        int64_t created;
+        idx_t length;
+        std::streamoff valid_end = 0;
+        while (input >> key >> created >> length) {
+            if (input.get() != '\n') {
+                truncated = true;
+                break;
+            }
+            string value(length, '\0');
+            if (!input.read(&value[0], length) || input.get() != '\n') {
+                // A partially written record, e.g. after a crash
+                truncated = true;
+                break;
+            }
+            valid_end = input.tellg();
+            log_bytes += key.size() + value.size() + 24;
+            Entry entry;
+            entry.value = std::move(value);
+            entry.created = created;
+            if (IsExpired(entry, now)) {
+                continue;
+            }
+            auto existing = entries.find(key);
+            if (existing != entries.end()) {
+                EraseLocked(existing);
+            }
+            lru.push_front(key);
+            entry.lru_position = lru.begin();
+            total_bytes += entry.value.size() + ENTRY_OVERHEAD;
+            entries[key] = std::move(entry);
+        }
+        // Anything after the last complete record is garbage that would corrupt later appends
+        input.clear();
+        input.seekg(0, std::ios::end);
+        if (input.tellg() != valid_end) {
+            truncated = true;
+        }
+        input.close();
+    }
+    EvictLocked();
+    // A log that cannot be written, e.g. in a read-only directory, is not retried on every lookup. The entries read
+    // so far stay cached in memory and new ones are not logged
+    try {
+        if (truncated) {
+            CompactLocked();
+        } else {
+            OpenLogLocked(std::ios::binary | std::ios::app);
+        }
+    } catch (std::exception &) {
+        if (log.is_open()) {
+            log.close();
+        }
+        memory_only = true;
+        write_failures++;
+    }
+    loaded = true;
+}
+
+void PromptResponseCache::CompactLocked() {
+    auto tmp_path = path + ".tmp";
+    if (log.is_open()) {
+        log.close();
+    }
+    log.open(tmp_path, std::ios::binary | std::ios::trunc);
+    if (!log.is_open()) {
+        throw IOException("Could not open open_prompt response cache \"%s\"", tmp_path);
+    }
+    log_bytes = 0;
+    // Write the least recently used entries first so that a reload restores the same order
+    for (auto key = lru.rbegin(); key != lru.rend(); ++key) {
+        AppendLocked(*key, entries[*key]);
+    }
+    log.close();
+    if (!log) {
+        throw IOException("Could not write open_prompt response cache \"%s\"", tmp_path);
+    }
+    // The old log is replaced in one step, so a crash leaves either the old or the new one
+    if (!ReplaceFile(tmp_path, path)) {
+        throw IOException("Could not replace open_prompt response cache \"%s\"", path);
+    }
+    OpenLogLocked(std::ios::binary | std::ios::app);
+    log_damaged = false;
+}
+
+} // namespace duckdb
@@ -0,0 +1,144 @@
+#include "prompt_similarity_index.hpp"
+
+#include "duckdb/common/types/hash.hpp"
+
+#include <algorithm>
+#include <bitset>
+
+namespace duckdb {
+
+static bool IsWordByte(unsigned char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c >= 0x80;
+}
+
+uint64_t PromptSimilarityIndex::Fingerprint(const string &text) {
+    int64_t weights[64] = {};
+    auto add_feature = [&](hash_t feature) {
+        for (idx_t bit = 0; bit < 64; bit++) {
+            weights[bit] += (feature >> bit) & 1 ? 1 : -1;
+        }
+    };
+
+    string word;
+    hash_t previous = 0;
+    bool has_previous = false;
+    for (idx_t i = 0; i <= text.size(); i++) {
+        auto c = i < text.size() ? static_cast<unsigned char>(text[i]) : 0;
+        if (i < text.size() && IsWordByte(c)) {
+            word += static_cast<char>(c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c);
+            continue;
+        }
+        if (word.empty()) {
+            continue;
+        }
+        auto current = Hash(word.c_str(), word.size());
+        add_feature(current);
+        // Word pairs keep some of the word order, so that rephrased prompts are not near-duplicates
+        if (has_previous) {
+            add_feature(CombineHash(previous, current));
+        }
+        previous = current;
+        has_previous = true;
+        word.clear();
+    }
+
+    uint64_t fingerprint = 0;
+    for (idx_t bit = 0; bit < 64; bit++) {
+        if (weights[bit] > 0) {
+            fingerprint |= uint64_t(1) << bit;
+        }
+    }
+    return fingerprint;
+}
+
+idx_t PromptSimilarityIndex::Distance(uint64_t left, uint64_t right) {
+    // Compiles to a single POPCNT where the target supports it
+    return std::bitset<64>(left ^ right).count();
+}
+
+uint64_t PromptSimilarityIndex::BandValue(idx_t band, uint64_t fingerprint) {
+    return (fingerprint >> (band * BAND_BITS)) & ((uint64_t(1) << BAND_BITS) - 1);
+}
+
+uint64_t PromptSimilarityIndex::BucketKey(uint64_t context, idx_t band, uint64_t band_value) {
+    return CombineHash(context, Hash<uint64_t>(band << BAND_BITS | band_value));
+}
+
+void PromptSimilarityIndex::RemoveFromBuckets(idx_t slot) {
+    auto &entry = entries[slot];
+    for (idx_t band = 0; band < BANDS; band++) {
+        auto bucket = buckets.find(BucketKey(entry.context, band, BandValue(band, entry.fingerprint)));
+        if (bucket == buckets.end()) {
+            continue;
+        }
+        auto &slots = bucket->second;
+        auto position = std::find(slots.begin(), slots.end(), slot);
+        if (position != slots.end()) {
+            *position = slots.back();
+            slots.pop_back();
+        }
+        if (slots.empty()) {
+            buckets.erase(bucket);
+        }
+    }
+}
+
+void PromptSimilarityIndex::Insert(uint64_t context, uint64_t fingerprint, const string &key) {
+    idx_t slot;
+    if (entries.size() < CAPACITY) {
+        slot = entries.size();
+        entries.push_back(Entry {context, fingerprint, key});
+    } else {
+        slot = next;
+        RemoveFromBuckets(slot);
+        entries[slot] = Entry {context, fingerprint, key};
+    }
+    next = (slot + 1) % CAPACITY;
+    for (idx_t band = 0; band < BANDS; band++) {
+        buckets[BucketKey(context, band, BandValue(band, fingerprint))].push_back(slot);
+    }
+}
+
+vector<string> PromptSimilarityIndex::Find(uint64_t context, uint64_t fingerprint, idx_t max_distance) const {
+    vector<pair<idx_t, idx_t>> candidates;
+    // Up to BANDS - 1 bits apart some band matches exactly, beyond that some band is one bit off
+    idx_t flips = max_distance >= BANDS ? BAND_BITS : 0;
+    for (idx_t band = 0; band < BANDS; band++) {
+        auto band_value = BandValue(band, fingerprint);
+        for (idx_t flip = 0; flip <= flips; flip++) {
+            auto probe = flip == 0 ? band_value : band_value ^ (uint64_t(1) << (flip - 1));
+            auto bucket = buckets.find(BucketKey(context, band, probe));
+            if (bucket == buckets.end()) {
+                continue;
+            }
+            for (auto slot : bucket->second) {
+                auto &entry = entries[slot];
+                if (entry.context != context) {
+                    continue;
+                }
+                auto distance = Distance(entry.fingerprint, fingerprint);
+                if (distance <= max_distance) {
+                    candidates.emplace_back(distance, slot);
+                }
+            }
+        }
+    }
+    // A close fingerprint shares several bands and shows up once per band
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+    vector<string> keys;
+    keys.reserve(candidates.size());
+    for (auto &candidate : candidates) {
+        keys.push_back(entries[candidate.second].key);
+    }
+    return keys;
+}
+
+void PromptSimilarityIndex::Clear() {
+    entries.clear();
+    buckets.clear();
+    next = 0;
+}
+
+} // namespace duckdb